@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <nodelet/nodelet.h>
 
 #include <std_srvs/Empty.h>
@@ -53,6 +54,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap_ros/GetNodeData.h"
 #include "rtabmap_ros/GetMap.h"
 #include "rtabmap_ros/GetMap2.h"
+#include "rtabmap_ros/GetMapChunk.h"
 #include "rtabmap_ros/ListLabels.h"
 #include "rtabmap_ros/PublishMap.h"
 #include "rtabmap_ros/SetGoal.h"
@@ -68,9 +70,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap_ros/DetectMoreLoopClosures.h"
 #include "rtabmap_ros/GlobalBundleAdjustment.h"
 #include "rtabmap_ros/CleanupLocalGrids.h"
+#include "rtabmap_ros/ImuBuffer.h"
 
 #include "MapsManager.h"
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+
 #ifdef WITH_OCTOMAP_MSGS
 #include <octomap_msgs/GetOctomap.h>
 #endif
@@ -164,6 +171,7 @@ private:
 #endif
 	void imuAsyncCallback(const sensor_msgs::ImuConstPtr & tagDetections);
 	void republishNodeDataCallback(const std_msgs::Int32MultiArray::ConstPtr& msg);
+	void prefetchRepublishedNodes(const ros::TimerEvent &);
 	void interOdomCallback(const nav_msgs::OdometryConstPtr & msg);
 	void interOdomInfoCallback(const nav_msgs::OdometryConstPtr & msg1, const rtabmap_ros::OdomInfoConstPtr & msg2);
 
@@ -209,8 +217,36 @@ private:
 	bool setLogWarn(std_srvs::Empty::Request&, std_srvs::Empty::Response&);
 	bool setLogError(std_srvs::Empty::Request&, std_srvs::Empty::Response&);
 	bool getNodeDataCallback(rtabmap_ros::GetNodeData::Request& req, rtabmap_ros::GetNodeData::Response& res);
+	void loadNodesData(
+			const std::vector<int> & ids,
+			bool images,
+			bool scan,
+			bool userData,
+			bool grid,
+			bool words,
+			bool globalDescriptors,
+			std::vector<rtabmap_ros::NodeData> & nodes);
+	std::map<int, rtabmap::Signature> loadSignatures(
+			const std::set<int> & ids,
+			bool images,
+			bool scan,
+			bool userData,
+			bool grid,
+			bool words,
+			bool globalDescriptors,
+			std::list<int> * dataNotLoaded = 0);
+	void nodesDataToROS(
+			const std::vector<int> & ids,
+			const std::map<int, rtabmap::Signature> & signatures,
+			std::vector<rtabmap_ros::NodeData> & nodes) const;
 	bool getMapDataCallback(rtabmap_ros::GetMap::Request& req, rtabmap_ros::GetMap::Response& res);
 	bool getMapData2Callback(rtabmap_ros::GetMap2::Request& req, rtabmap_ros::GetMap2::Response& res);
+	bool getMapDataChunkCallback(rtabmap_ros::GetMapChunk::Request& req, rtabmap_ros::GetMapChunk::Response& res);
+	void mapDataChunk(
+			const rtabmap_ros::GetMapChunk::Request & req,
+			const std::vector<int> & ids,
+			rtabmap_ros::MapData & msg);
+	void publishMapDataChunk(const ros::TimerEvent &);
 	bool getMapCallback(nav_msgs::GetMap::Request  &req, nav_msgs::GetMap::Response &res);
 	bool getProbMapCallback(nav_msgs::GetMap::Request  &req, nav_msgs::GetMap::Response &res);
 	bool getProjMapCallback(nav_msgs::GetMap::Request  &req, nav_msgs::GetMap::Response &res);
@@ -225,6 +261,18 @@ private:
 	bool removeLabelCallback(rtabmap_ros::RemoveLabel::Request& req, rtabmap_ros::RemoveLabel::Response& res);
 	bool addLinkCallback(rtabmap_ros::AddLink::Request&, rtabmap_ros::AddLink::Response&);
 	bool getNodesInRadiusCallback(rtabmap_ros::GetNodesInRadius::Request&, rtabmap_ros::GetNodesInRadius::Response&);
+	cv::Mat getGridMapSnapshot(bool probabilistic, float & xMin, float & yMin, float & gridCellSize);
+	bool readMapData(const rtabmap_ros::GetMap2::Request & req, rtabmap_ros::MapData & msg);
+	void copyMapData(
+			const rtabmap_ros::GetMap2::Request * req,
+			bool withGraph,
+			std::map<int, rtabmap::Transform> * poses,
+			std::multimap<int, rtabmap::Link> * constraints,
+			std::map<int, rtabmap::Signature> * signatures,
+			std::list<int> * dataNotLoaded);
+	void publishReadSnapshot(bool labelsChanged = false);
+	void updateReadGrid(bool force = false);
+	bool callOnProcessingQueue(const boost::function<void()> & function);
 #ifdef WITH_OCTOMAP_MSGS
 	bool octomapBinaryCallback(octomap_msgs::GetOctomap::Request  &req, octomap_msgs::GetOctomap::Response &res);
 	bool octomapFullCallback(octomap_msgs::GetOctomap::Request  &req, octomap_msgs::GetOctomap::Response &res);
@@ -243,6 +291,17 @@ private:
 	void publishLocalPath(const ros::Time & stamp);
 	void publishGlobalPath(const ros::Time & stamp);
 	void republishMaps();
+	struct GraphDeltaState;
+	void fillMapGraph(
+			GraphDeltaState & state,
+			const std::map<int, rtabmap::Transform> & poses,
+			const std::multimap<int, rtabmap::Link> & links,
+			const rtabmap::Transform & mapToOdom,
+			rtabmap_ros::MapGraph & msg,
+			bool keyframe = false);
+	void graphSubscriberConnected(const ros::SingleSubscriberPublisher &, GraphDeltaState * state);
+	void mapUpdateLoop();
+	void clearMapUpdate();
 
 private:
 	rtabmap::Rtabmap rtabmap_;
@@ -287,10 +346,49 @@ private:
 	boost::mutex mapToOdomMutex_;
 
 	MapsManager mapsManager_;
+	boost::mutex mapsManagerMutex_;
+
+	// asynchronous map update
+	bool mapUpdateAsync_;
+	boost::thread* mapUpdateThread_;
+	bool mapUpdateThreadRunning_;
+	boost::mutex mapUpdateMutex_;
+	boost::condition_variable mapUpdateCondition_;
+	bool mapUpdatePending_;
+	std::map<int, rtabmap::Transform> mapUpdatePoses_;
+	std::map<int, rtabmap::Signature> mapUpdateSignatures_;
+	ros::Time mapUpdateStamp_;
+	int mapUpdateCoalesced_;
+	std::set<int> mapUpdateCachedIds_;
+	std::set<int> mapUpdateRequestedIds_;
 
 	ros::Publisher infoPub_;
 	ros::Publisher mapDataPub_;
 	ros::Publisher mapGraphPub_;
+
+	// streaming mode of get_map_data_chunk
+	ros::Publisher mapDataChunksPub_;
+	ros::Timer mapDataChunksTimer_;
+	rtabmap_ros::GetMapChunk::Request mapDataChunksRequest_;
+	std::list<int> mapDataChunksIds_; // nodes not published yet
+	rtabmap_ros::GetMapChunk::Request mapDataChunkPagesRequest_; // of the last cursor=0 call
+	std::vector<int> mapDataChunkPagesIds_; // nodes selected by mapDataChunkPagesRequest_
+
+	// delta mode of mapData and mapGraph
+	struct GraphDeltaState
+	{
+		GraphDeltaState() : sinceKeyframe(0), graphId(0), newSubscriber(true) {}
+		std::map<int, rtabmap::Transform> poses; // as received by subscribers
+		std::multimap<int, rtabmap::Link> links;
+		int sinceKeyframe;
+		unsigned int graphId; // of the last message
+		boost::atomic<bool> newSubscriber; // since the last message, set by the publisher's callbacks
+	};
+	bool mapGraphDelta_;
+	int mapGraphDeltaKeyframeInterval_;
+	double mapGraphDeltaTolerance_;
+	GraphDeltaState mapDataDeltaState_;
+	GraphDeltaState mapGraphDeltaState_;
 	ros::Publisher odomCachePub_;
 	ros::Publisher landmarksPub_;
 	ros::Publisher labelsPub_;
@@ -334,6 +432,7 @@ private:
 	ros::ServiceServer getNodeDataSrv_;
 	ros::ServiceServer getMapDataSrv_;
 	ros::ServiceServer getMapData2Srv_;
+	ros::ServiceServer getMapDataChunkSrv_;
 	ros::ServiceServer getProjMapSrv_;
 	ros::ServiceServer getMapSrv_;
 	ros::ServiceServer getProbMapSrv_;
@@ -373,7 +472,7 @@ private:
 	ros::Subscriber fiducialTransfromsSub_;
 	std::map<int, std::pair<geometry_msgs::PoseWithCovarianceStamped, float> > tags_; // id, <pose, size>
 	ros::Subscriber imuSub_;
-	std::map<double, rtabmap::Transform> imus_;
+	ImuBuffer imus_; // written by imuAsyncCallback(), read without lock by the data callbacks
 	std::string imuFrameId_;
 	ros::Subscriber republishNodeDataSub_;
 
@@ -395,6 +494,43 @@ private:
 	ros::Time previousStamp_;
 	std::set<int> nodesToRepublish_;
 	int maxNodesRepublished_;
+	// nodes requested on republish_node_data are read from the database
+	// between updates by a thread spinning republishPrefetchQueue_
+	ros::Timer republishPrefetchTimer_;
+	std::map<int, rtabmap::SensorData> republishPrefetched_; // data of nodesToRepublish_ already loaded, max_nodes_republished at most
+	boost::mutex republishMutex_; // nodesToRepublish_ and republishPrefetched_
+	boost::mutex dbReadMutex_; // memory's database read by the prefetch and read-only service threads, locked while it is closed or reset
+	ros::CallbackQueue republishPrefetchQueue_;
+	ros::AsyncSpinner * republishPrefetchSpinner_;
+	int nodeDataThreads_;
+
+	// Read-only services have their own callback queue and threads, they
+	// use the snapshot published by the processing queue after each update
+	// instead of rtabmap_.
+	struct ReadGrid
+	{
+		ReadGrid() : xMin(0.0f), yMin(0.0f), cellSize(0.05f) {}
+		cv::Mat map;
+		cv::Mat probMap;
+		float xMin;
+		float yMin;
+		float cellSize;
+	};
+	struct ReadSnapshot
+	{
+		std::map<int, rtabmap::Transform> poses; // local optimized graph
+		std::multimap<int, rtabmap::Link> constraints;
+		rtabmap::Transform lastLocalizationPose;
+		ReadGrid grid; // assembled by the last map update
+	};
+	boost::shared_ptr<const ReadSnapshot> getReadSnapshot();
+	boost::shared_ptr<const ReadSnapshot> readSnapshot_;
+	boost::shared_ptr<const std::map<int, std::string> > readLabels_;
+	int readGridSensor_;
+	boost::mutex readSnapshotMutex_;
+	ros::CallbackQueue readQueue_;
+	ros::AsyncSpinner * readSpinner_;
+	boost::atomic<bool> readSpinnerRunning_;
 };
 
 }
@@ -35,6 +35,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap_ros/Goal.h"
 #include "rtabmap/utilite/UEventsHandler.h"
 #include "rtabmap/core/Transform.h"
+#include "rtabmap/core/Link.h"
 
 #include <tf/transform_listener.h>
 
@@ -136,6 +137,11 @@ private:
 	message_filters::Subscriber<nav_msgs::Path> pathTopic_;
 	ros::Subscriber goalReachedTopic_;
 
+	// graph received on mapData topic (complete or delta)
+	std::map<int, rtabmap::Transform> graphPoses_;
+	std::multimap<int, rtabmap::Link> graphLinks_;
+	unsigned int graphId_;
+
 	typedef message_filters::sync_policies::ExactTime<
 			rtabmap_ros::Info,
 			rtabmap_ros::MapData> MyInfoMapSyncPolicy;
@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMUBUFFER_H_
+#define IMUBUFFER_H_
+
+#include <sensor_msgs/Imu.h>
+#include <rtabmap/core/IMU.h>
+#include <rtabmap/core/Transform.h>
+
+#include <boost/scoped_array.hpp>
+#include <boost/atomic.hpp>
+#include <vector>
+
+namespace rtabmap_ros {
+
+// Fixed-capacity ring buffer of IMU samples ordered by stamp. The samples
+// are stored contiguously, so no allocation is done when adding a sample,
+// and stamps are searched by dichotomy.
+//
+// push() must be called by a single writer thread. The read functions can be
+// called concurrently from other threads without lock (seqlock): a read
+// overlapping an overwrite of its samples is retried.
+class ImuBuffer
+{
+public:
+	struct Sample
+	{
+		double stamp;
+		double orientation[4]; // x,y,z,w
+		double angularVelocity[3];
+		double linearAcceleration[3];
+		double orientationCovariance[9];
+		double angularVelocityCovariance[9];
+		double linearAccelerationCovariance[9];
+		float localTransform[12]; // 3x4, see rtabmap::Transform::data()
+	};
+
+public:
+	ImuBuffer(size_t capacity = 1000);
+
+	// Samples older than the last accepted one are ignored (return false),
+	// even if it has since been taken. The oldest sample is dropped when the
+	// buffer is full.
+	bool push(const Sample & sample);
+	bool push(const sensor_msgs::Imu & msg, const rtabmap::Transform & localTransform);
+
+	void clear(); // also forgets the last accepted stamp
+	bool empty() const {return size() == 0;}
+	size_t size() const;
+	size_t capacity() const {return capacity_;}
+	double firstStamp() const; // 0 if empty
+	double lastStamp() const; // last accepted stamp, 0 if none since clear()
+
+	// Orientation at this stamp, interpolated (SLERP) between the two
+	// samples around it. Null if the stamp is out of the buffer.
+	rtabmap::Transform getOrientation(double stamp) const;
+
+	// Remove and return all the samples up to this stamp, including the
+	// first one just after it (for interpolation by the consumer).
+	std::vector<Sample> takeUntil(double stamp);
+
+	static rtabmap::IMU toIMU(const Sample & sample);
+
+private:
+	size_t lowerBound(size_t tail, size_t head, double stamp) const;
+
+private:
+	size_t capacity_;
+	boost::scoped_array<Sample> samples_;
+	// Indexes grow monotonically, the slot is index % capacity_.
+	boost::atomic<size_t> head_; // next index written
+	boost::atomic<size_t> tail_; // oldest index
+	boost::atomic<unsigned int> version_; // odd while a slot is overwritten
+	boost::atomic<double> lastStamp_; // kept when the samples are taken
+};
+
+}
+
+#endif /* IMUBUFFER_H_ */
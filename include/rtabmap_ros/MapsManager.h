@@ -35,6 +35,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pcl/point_types.h>
 #include <ros/time.h>
 #include <ros/publisher.h>
+#include <ros/single_subscriber_publisher.h>
+#include <boost/atomic.hpp>
+#include <unordered_map>
+#include <cstdint>
 
 namespace rtabmap {
 class OctoMap;
@@ -44,12 +48,50 @@ class OccupancyGrid;
 }  // namespace rtabmap
 
 class MapsManager {
+public:
+	// Voxel grid updated incrementally with the clouds added or removed. Each
+	// voxel gives the centroid and the average color of its points. Points
+	// farther than 2^20 cells from the origin are ignored.
+	class VoxelCloud
+	{
+	public:
+		VoxelCloud() : cellSize_(0.0f), modified_(false) {}
+		float cellSize() const {return cellSize_;}
+		void setCellSize(float cellSize); // clear the voxels if changed
+		void add(const pcl::PointCloud<pcl::PointXYZRGB> & cloud);
+		void remove(const pcl::PointCloud<pcl::PointXYZRGB> & cloud);
+		void clear();
+		bool modified() const {return modified_;}
+		void toCloud(pcl::PointCloud<pcl::PointXYZRGB> & output); // reset modified()
+		size_t size() const {return voxels_.size();}
+	private:
+		struct Voxel
+		{
+			Voxel() : x(0), y(0), z(0), r(0), g(0), b(0), count(0) {}
+			double x, y, z;
+			unsigned int r, g, b;
+			int count;
+		};
+		bool key(const pcl::PointXYZRGB & pt, std::uint64_t & k) const;
+		float cellSize_;
+		bool modified_;
+		std::unordered_map<std::uint64_t, Voxel> voxels_;
+	};
+
 public:
 	MapsManager();
 	virtual ~MapsManager();
 	void init(ros::NodeHandle & nh, ros::NodeHandle & pnh, const std::string & name, bool usePublicNamespace);
 	void clear();
 	bool hasSubscribers() const;
+	// Update the grid map on each update even if nobody is subscribed
+	// to the map topics (e.g., the grid is served by a service)
+	void setGridRequired(bool required) {gridRequired_ = required;}
+	bool isGridRequired() const {return gridRequired_;}
+	// Keep only the local grids of the nodes assembled in the maps (see
+	// getFilteredPoses()), the others are created again from the node data
+	// passed to updateMapCaches() if they are assembled later
+	void setGridCacheFiltered(bool filtered) {gridCacheFiltered_ = filtered;}
 	void backwardCompatibilityParameters(ros::NodeHandle & pnh, rtabmap::ParametersMap & parameters) const;
 	void setParameters(const rtabmap::ParametersMap & parameters);
 	void set2DMap(const cv::Mat & map, float xMin, float yMin, float cellSize, const std::map<int, rtabmap::Transform> & poses, const rtabmap::Memory * memory = 0);
@@ -64,6 +106,18 @@ public:
 			bool updateOctomap,
 			const std::map<int, rtabmap::Signature> & signatures = std::map<int, rtabmap::Signature>());
 
+	// Ids of the nodes already in the local grid cache
+	std::set<int> getCachedNodes() const;
+
+	// Load from memory the data required by updateMapCaches() for these nodes,
+	// so that the caches can be updated later without accessing memory. The
+	// maps are not accessed, gridFromDepth should be taken from
+	// getOccupancyGrid()->isGridFromDepth().
+	static std::map<int, rtabmap::Signature> loadNodesData(
+			const std::set<int> & ids,
+			const rtabmap::Memory * memory,
+			bool gridFromDepth);
+
 	void publishMaps(
 			const std::map<int, rtabmap::Transform> & poses,
 			const ros::Time & stamp,
@@ -81,8 +135,11 @@ public:
 
 	const rtabmap::OctoMap * getOctomap() const {return octomap_;}
 	const rtabmap::OccupancyGrid * getOccupancyGrid() const {return occupancyGrid_;}
+	bool isGridUpdated() const {return gridUpdated_;} // by the last updateMapCaches()
 
 private:
+	void gridMapSubscriberConnected(const ros::SingleSubscriberPublisher &);
+
 	// mapping stuff
 	bool cloudOutputVoxelized_;
 	bool cloudSubtractFiltering_;
@@ -92,12 +149,16 @@ private:
 	bool mapCacheCleanup_;
 	bool alwaysUpdateMap_;
 	bool scanEmptyRayTracing_;
+	int mapCacheThreads_;
+	class LocalGridWorkers;
+	LocalGridWorkers * localGridWorkers_; // threads creating the local grids, kept between updates
 
 	ros::Publisher cloudMapPub_;
 	ros::Publisher cloudGroundPub_;
 	ros::Publisher cloudObstaclesPub_;
 	ros::Publisher projMapPub_;
 	ros::Publisher gridMapPub_;
+	ros::Publisher gridMapUpdatesPub_;
 	ros::Publisher gridProbMapPub_;
 	ros::Publisher scanMapPub_;
 	ros::Publisher octoMapPubBin_;
@@ -117,6 +178,12 @@ private:
 	rtabmap::FlannIndex assembledObstacleIndex_;
 	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > groundClouds_;
 	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > obstacleClouds_;
+	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > assembledGroundSegments_; // transformed groundClouds_
+	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > assembledObstacleSegments_; // transformed obstacleClouds_
+	VoxelCloud assembledGroundVoxels_; // cloud_output_voxelized
+	VoxelCloud assembledObstacleVoxels_; // cloud_output_voxelized
+	std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> temporaryGroundSegments_; // nodes with id <= 0
+	std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> temporaryObstacleSegments_; // nodes with id <= 0
 
 	std::map<int, rtabmap::Transform> gridPoses_;
 	cv::Mat gridMap_;
@@ -125,10 +192,23 @@ private:
 
 	rtabmap::OccupancyGrid * occupancyGrid_;
 	bool gridUpdated_;
+	bool gridRequired_;
+	bool gridCacheFiltered_;
+	bool gridMapUpdates_;
+	int gridMapUpdatesKeyframe_;
+	int gridMapUpdatesSinceKeyframe_;
+	// last grid published on grid_map, used to compute grid_map_updates
+	cv::Mat gridMapPublished_;
+	float gridMapPublishedXMin_;
+	float gridMapPublishedYMin_;
+	float gridMapPublishedCellSize_;
+	boost::atomic<bool> gridMapNewSubscriber_; // set from the connection callback, the next grid_map is sent in full
 
 	rtabmap::OctoMap * octomap_;
 	int octomapTreeDepth_;
 	bool octomapUpdated_;
+	class OctomapClouds;
+	OctomapClouds * octomapClouds_; // octomap_* clouds updated from the changed octree keys
 
 	rtabmap::ParametersMap parameters_;
 
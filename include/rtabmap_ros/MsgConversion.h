@@ -82,6 +82,13 @@ rtabmap::SensorData rgbdImageFromROS(const rtabmap_ros::RGBDImageConstPtr & imag
 void compressedMatToBytes(const cv::Mat & compressed, std::vector<unsigned char> & bytes);
 cv::Mat compressedMatFromBytes(const std::vector<unsigned char> & bytes, bool copy = true);
 
+// Lossless RVL depth coding of 16 bits (mm) depth images, format "rvl" of
+// RGBDImage::depth_compressed. Float depth images are not supported, use png.
+std::vector<unsigned char> compressDepthRVL(const cv::Mat & depth);
+cv::Mat uncompressDepthRVL(const std::vector<unsigned char> & bytes);
+// Decode depth_compressed of RGBDImage ("png", "rvl")
+cv::Mat uncompressDepth(const sensor_msgs::CompressedImage & msg);
+
 void infoFromROS(const rtabmap_ros::Info & info, rtabmap::Statistics & stat);
 void infoToROS(const rtabmap::Statistics & stats, rtabmap_ros::Info & info);
 
@@ -135,7 +142,7 @@ rtabmap::StereoCameraModel stereoCameraModelFromROS(
 		const sensor_msgs::CameraInfo & leftCamInfo,
 		const sensor_msgs::CameraInfo & rightCamInfo,
 		const std::string & frameId,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform);
 
 void mapDataFromROS(
@@ -144,6 +151,18 @@ void mapDataFromROS(
 		std::multimap<int, rtabmap::Link> & links,
 		std::map<int, rtabmap::Signature> & signatures,
 		rtabmap::Transform & mapToOdom);
+// Like mapDataFromROS() but the graph of msg (complete or delta) updates
+// "poses" and "links", see mapGraphDeltaFromROS(). Returns false if the
+// graph has not been updated, "signatures" are then not set. With
+// withData=false, only the node info is set (see nodeInfoFromROS()).
+bool mapDataDeltaFromROS(
+		const rtabmap_ros::MapData & msg,
+		std::map<int, rtabmap::Transform> & poses,
+		std::multimap<int, rtabmap::Link> & links,
+		std::map<int, rtabmap::Signature> & signatures,
+		rtabmap::Transform & mapToOdom,
+		unsigned int & graphId,
+		bool withData = true);
 void mapDataToROS(
 		const std::map<int, rtabmap::Transform> & poses,
 		const std::multimap<int, rtabmap::Link> & links,
@@ -162,6 +181,35 @@ void mapGraphToROS(
 		const rtabmap::Transform & mapToOdom,
 		rtabmap_ros::MapGraph & msg);
 
+// Delta mode: fill msg with only the poses that moved more than "tolerance"
+// (meters/radians), the new poses and the new links compared to
+// "previousPoses" and "previousLinks" (what has been sent before), which are
+// then updated. A link with a new transform replaces the one with the same
+// nodes and type. The complete graph is set if "keyframe" is true or if some
+// links have been removed. Returns true if msg is a delta. graphId and
+// deltaBaseId of msg are not set.
+bool mapGraphDeltaToROS(
+		const std::map<int, rtabmap::Transform> & poses,
+		const std::multimap<int, rtabmap::Link> & links,
+		const rtabmap::Transform & mapToOdom,
+		float tolerance,
+		bool keyframe,
+		std::map<int, rtabmap::Transform> & previousPoses,
+		std::multimap<int, rtabmap::Link> & previousLinks,
+		rtabmap_ros::MapGraph & msg);
+// Update "poses" and "links" with msg (complete or delta). "graphId" is the
+// graphId of the last message applied (updated). Returns false if msg is a
+// delta and no complete graph has been received yet, or if a message has
+// been missed (the graph is then cleared until the next complete graph).
+// A "no graph" msg (delta with graphId=deltaBaseId=0) is ignored (false is
+// returned).
+bool mapGraphDeltaFromROS(
+		const rtabmap_ros::MapGraph & msg,
+		std::map<int, rtabmap::Transform> & poses,
+		std::multimap<int, rtabmap::Link> & links,
+		rtabmap::Transform & mapToOdom,
+		unsigned int & graphId);
+
 rtabmap::Signature nodeDataFromROS(const rtabmap_ros::NodeData & msg);
 void nodeDataToROS(const rtabmap::Signature & signature, rtabmap_ros::NodeData & msg);
 
@@ -180,7 +228,7 @@ rtabmap::Landmarks landmarksFromROS(
 		const std::string & frameId,
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		double defaultLinVariance,
 		double defaultAngVariance);
@@ -192,7 +240,7 @@ rtabmap::Transform getTransform(
 		const std::string & fromFrameId,
 		const std::string & toFrameId,
 		const ros::Time & stamp,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform);
 
 
@@ -203,9 +251,56 @@ rtabmap::Transform getTransform(
 		const std::string & fixedFrame,
 		const ros::Time & stampSource,
 		const ros::Time & stampTarget,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform);
 
+// Resolve the transforms needed to convert the messages of a same callback.
+// Identical (or inverse) lookups are done only once, the waits for the
+// requests added beforehand are done once per frame pair at their latest
+// stamp, and transforms made only of static transforms are kept between
+// callbacks.
+class TransformResolver
+{
+public:
+	TransformResolver(tf::Transformer & listener, double waitForTransform);
+
+	void addRequest(const std::string & fromFrameId, const std::string & toFrameId, const ros::Time & stamp);
+	void waitForRequests();
+
+	// see getTransform() functions above
+	rtabmap::Transform getTransform(
+			const std::string & fromFrameId,
+			const std::string & toFrameId,
+			const ros::Time & stamp);
+	rtabmap::Transform getTransform(
+			const std::string & sourceTargetFrame,
+			const std::string & fixedFrame,
+			const ros::Time & stampSource,
+			const ros::Time & stampTarget);
+
+private:
+	bool wait(const std::string & fromFrameId, const std::string & toFrameId, const ros::Time & stamp);
+
+private:
+	tf::Transformer & listener_;
+	double waitForTransform_;
+	std::map<std::pair<std::string, std::string>, ros::Time> requests_; // latest stamp
+	std::map<std::pair<std::string, std::string>, ros::Time> waited_; // latest stamp waited
+	std::map<std::pair<std::pair<std::string, std::string>, ros::Time>, rtabmap::Transform> transforms_;
+	std::map<std::pair<std::pair<std::string, std::string>, std::pair<ros::Time, ros::Time> >, rtabmap::Transform> motions_;
+};
+
+// Buffer for side-by-side images of multiple cameras. Buffers are reused once
+// the frames previously using them have been released.
+cv::Mat mosaicBuffer(int rows, int cols, int type);
+
+// Copy the images side by side in a mosaic buffer (in parallel), converted
+// to bgr8 if color is true (mono images are converted to mono8), to mono8
+// otherwise. Returns false if the converted images don't have the same type.
+bool imagesToMosaic(const std::vector<cv_bridge::CvImageConstPtr> & images, bool color, cv::Mat & mosaic);
+// Same as above but images are kept in their encoding (e.g., depth images).
+bool depthsToMosaic(const std::vector<cv_bridge::CvImageConstPtr> & images, cv::Mat & mosaic);
+
 bool convertRGBDMsgs(
 		const std::vector<cv_bridge::CvImageConstPtr> & imageMsgs,
 		const std::vector<cv_bridge::CvImageConstPtr> & depthMsgs,
@@ -218,7 +313,7 @@ bool convertRGBDMsgs(
 		cv::Mat & depth,
 		std::vector<rtabmap::CameraModel> & cameraModels,
 		std::vector<rtabmap::StereoCameraModel> & stereoCameraModels,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool alreadRectifiedImages,
 		const std::vector<std::vector<rtabmap_ros::KeyPoint> > & localKeyPointsMsgs = std::vector<std::vector<rtabmap_ros::KeyPoint> >(),
@@ -239,7 +334,7 @@ bool convertStereoMsg(
 		cv::Mat & left,
 		cv::Mat & right,
 		rtabmap::StereoCameraModel & stereoModel,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool alreadyRectified);
 
@@ -249,7 +344,7 @@ bool convertScanMsg(
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
 		rtabmap::LaserScan & scan,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool outputInFrameId = false);
 
@@ -259,7 +354,7 @@ bool convertScan3dMsg(
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
 		rtabmap::LaserScan & scan,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		int maxPoints = 0,
 		float maxRange = 0.0f);
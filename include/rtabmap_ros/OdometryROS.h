@@ -39,10 +39,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sensor_msgs/Imu.h>
 
 #include <rtabmap_ros/ResetPose.h>
+#include <rtabmap_ros/ImuBuffer.h>
 #include <rtabmap/core/SensorData.h>
 #include <rtabmap/core/Parameters.h>
 
 #include <boost/thread.hpp>
+#include <deque>
 
 namespace rtabmap {
 class Odometry;
@@ -81,6 +83,9 @@ protected:
 	virtual void flushCallbacks() = 0;
 	tf::TransformListener & tfListener() {return tfListener_;}
 	virtual void postProcessData(const rtabmap::SensorData & data, const std_msgs::Header & header) const {}
+	// Stop and join the async_process thread, to be called first by the
+	// destructors of subclasses, as the thread calls their postProcessData()
+	void stopAsyncProcessing();
 
 private:
 	void warningLoop(const std::string & subscribedTopicsMsg, bool approxSync);
@@ -91,6 +96,9 @@ private:
 	void callbackIMU(const sensor_msgs::ImuConstPtr& msg);
 	void reset(const rtabmap::Transform & pose = rtabmap::Transform::getIdentity());
 
+	void processDataImpl(rtabmap::SensorData & data, const std_msgs::Header & header);
+	void processingLoop();
+
 private:
 	rtabmap::Odometry * odometry_;
 	boost::thread * warningThread_;
@@ -144,8 +152,28 @@ private:
 	int odomStrategy_;
 	bool waitIMUToinit_;
 	bool imuProcessed_;
-	std::map<double, rtabmap::IMU> imus_;
+	ImuBuffer imus_;
 	std::pair<rtabmap::SensorData, std_msgs::Header > bufferedData_;
+
+	// asynchronous processing (async_process=true)
+	struct QueuedData
+	{
+		rtabmap::SensorData data;
+		std_msgs::Header header;
+		ros::WallTime received;
+	};
+	bool asyncProcess_;
+	int asyncQueueSize_;
+	bool asyncKeepLatest_;
+	boost::thread * processingThread_;
+	bool processingThreadRunning_;
+	boost::mutex queueMutex_;
+	boost::condition_variable queueCondition_;
+	std::deque<QueuedData> dataQueue_;
+	int droppedFrames_; // since last published odom info
+	int droppedFramesTotal_;
+	boost::mutex processMutex_; // odometry state
+	boost::mutex imuMutex_; // imus_ and bufferedData_
 };
 
 }
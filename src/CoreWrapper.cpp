@@ -39,6 +39,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cv_bridge/cv_bridge.h>
 #include <pcl_conversions/pcl_conversions.h>
 #include <pcl/io/io.h>
+#include <boost/thread/thread.hpp>
 
 #include <visualization_msgs/MarkerArray.h>
 
@@ -48,6 +49,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UStl.h>
 #include <rtabmap/utilite/UMath.h>
+#include <rtabmap/utilite/UException.h>
 
 #include <rtabmap/core/util2d.h>
 #include <rtabmap/core/util3d.h>
@@ -113,6 +115,14 @@ CoreWrapper::CoreWrapper() :
 		genDepthFillHolesError_(0.1),
 		scanCloudMaxPoints_(0),
 		mapToOdom_(rtabmap::Transform::getIdentity()),
+		mapUpdateAsync_(false),
+		mapUpdateThread_(0),
+		mapUpdateThreadRunning_(false),
+		mapUpdatePending_(false),
+		mapUpdateCoalesced_(0),
+		mapGraphDelta_(false),
+		mapGraphDeltaKeyframeInterval_(10),
+		mapGraphDeltaTolerance_(0.01),
 		transformThread_(0),
 		tfThreadRunning_(false),
 		stereoToDepth_(false),
@@ -126,7 +136,14 @@ CoreWrapper::CoreWrapper() :
 		twoDMapping_(Parameters::defaultRegForce3DoF()),
 		previousStamp_(0),
 		mbClient_(0),
-		maxNodesRepublished_(2)
+		maxNodesRepublished_(2),
+		republishPrefetchSpinner_(0),
+		nodeDataThreads_(1),
+		readSnapshot_(new ReadSnapshot),
+		readLabels_(new std::map<int, std::string>),
+		readGridSensor_(-1),
+		readSpinner_(0),
+		readSpinnerRunning_(false)
 {
 	char * rosHomePath = getenv("ROS_HOME");
 	std::string workingDir = rosHomePath?rosHomePath:UDirectory::homeDir()+"/.ros";
@@ -190,6 +207,15 @@ void CoreWrapper::onInit()
 	pnh.param("use_action_for_goal", useActionForGoal_, useActionForGoal_);
 	pnh.param("use_saved_map", useSavedMap_, useSavedMap_);
 	pnh.param("max_nodes_republished", maxNodesRepublished_, maxNodesRepublished_);
+	pnh.param("node_data_threads", nodeDataThreads_, nodeDataThreads_);
+	if(nodeDataThreads_ <= 0)
+	{
+		nodeDataThreads_ = std::max(1, (int)boost::thread::hardware_concurrency());
+	}
+	int readServicesThreads = 1;
+	pnh.param("read_services_threads", readServicesThreads, readServicesThreads);
+	// the read-only services serve the grid of the last map update
+	mapsManager_.setGridRequired(readServicesThreads > 0);
 	pnh.param("gen_scan",            genScan_, genScan_);
 	pnh.param("gen_scan_max_depth",  genScanMaxDepth_, genScanMaxDepth_);
 	pnh.param("gen_scan_min_depth",  genScanMinDepth_, genScanMinDepth_);
@@ -211,6 +237,10 @@ void CoreWrapper::onInit()
 	}
 	pnh.param("stereo_to_depth", stereoToDepth_, stereoToDepth_);
 	pnh.param("odom_sensor_sync", odomSensorSync_, odomSensorSync_);
+	pnh.param("map_update_async", mapUpdateAsync_, mapUpdateAsync_);
+	pnh.param("map_graph_delta", mapGraphDelta_, mapGraphDelta_);
+	pnh.param("map_graph_delta_keyframe_interval", mapGraphDeltaKeyframeInterval_, mapGraphDeltaKeyframeInterval_);
+	pnh.param("map_graph_delta_tolerance", mapGraphDeltaTolerance_, mapGraphDeltaTolerance_);
 	if(pnh.hasParam("flip_scan"))
 	{
 		NODELET_WARN("Parameter \"flip_scan\" doesn't exist anymore. Rtabmap now "
@@ -234,6 +264,15 @@ void CoreWrapper::onInit()
 	NODELET_INFO("rtabmap: tf_delay      = %f", tfDelay);
 	NODELET_INFO("rtabmap: tf_tolerance  = %f", tfTolerance);
 	NODELET_INFO("rtabmap: odom_sensor_sync   = %s", odomSensorSync_?"true":"false");
+	NODELET_INFO("rtabmap: map_update_async   = %s", mapUpdateAsync_?"true":"false");
+	NODELET_INFO("rtabmap: map_graph_delta    = %s", mapGraphDelta_?"true":"false");
+	NODELET_INFO("rtabmap: node_data_threads  = %d", nodeDataThreads_);
+	NODELET_INFO("rtabmap: read_services_threads = %d", readServicesThreads);
+	if(mapGraphDelta_)
+	{
+		NODELET_INFO("rtabmap: map_graph_delta_keyframe_interval = %d", mapGraphDeltaKeyframeInterval_);
+		NODELET_INFO("rtabmap: map_graph_delta_tolerance         = %f", mapGraphDeltaTolerance_);
+	}
 	bool subscribeStereo = false;
 	pnh.param("subscribe_stereo",      subscribeStereo, subscribeStereo);
 	if(subscribeStereo)
@@ -264,8 +303,11 @@ void CoreWrapper::onInit()
 	}
 
 	infoPub_ = nh.advertise<rtabmap_ros::Info>("info", 1);
-	mapDataPub_ = nh.advertise<rtabmap_ros::MapData>("mapData", 1);
-	mapGraphPub_ = nh.advertise<rtabmap_ros::MapGraph>("mapGraph", 1);
+	mapDataPub_ = nh.advertise<rtabmap_ros::MapData>("mapData", 1,
+			boost::bind(&CoreWrapper::graphSubscriberConnected, this, boost::placeholders::_1, &mapDataDeltaState_));
+	mapGraphPub_ = nh.advertise<rtabmap_ros::MapGraph>("mapGraph", 1,
+			boost::bind(&CoreWrapper::graphSubscriberConnected, this, boost::placeholders::_1, &mapGraphDeltaState_));
+	mapDataChunksPub_ = nh.advertise<rtabmap_ros::MapData>("mapDataChunks", 10);
 	odomCachePub_ = nh.advertise<rtabmap_ros::MapGraph>("mapOdomCache", 1);
 	landmarksPub_ = nh.advertise<geometry_msgs::PoseArray>("landmarks", 1);
 	labelsPub_ = nh.advertise<visualization_msgs::MarkerArray>("labels", 1);
@@ -686,22 +728,30 @@ void CoreWrapper::onInit()
 	setModeLocalizationSrv_ = nh.advertiseService("set_mode_localization", &CoreWrapper::setModeLocalizationCallback, this);
 	setModeMappingSrv_ = nh.advertiseService("set_mode_mapping", &CoreWrapper::setModeMappingCallback, this);
 	getNodeDataSrv_ = nh.advertiseService("get_node_data", &CoreWrapper::getNodeDataCallback, this);
-	getMapDataSrv_ = nh.advertiseService("get_map_data", &CoreWrapper::getMapDataCallback, this);
-	getMapData2Srv_ = nh.advertiseService("get_map_data2", &CoreWrapper::getMapData2Callback, this);
-	getMapSrv_ = nh.advertiseService("get_map", &CoreWrapper::getMapCallback, this);
-	getProbMapSrv_ = nh.advertiseService("get_prob_map", &CoreWrapper::getProbMapCallback, this);
-	getGridMapSrv_ = nh.advertiseService("get_grid_map", &CoreWrapper::getGridMapCallback, this);
-	getProjMapSrv_ = nh.advertiseService("get_proj_map", &CoreWrapper::getProjMapCallback, this);
+	getMapDataChunkSrv_ = nh.advertiseService("get_map_data_chunk", &CoreWrapper::getMapDataChunkCallback, this);
+	// read-only services, on their own callback queue if read_services_threads>0
+	ros::NodeHandle readNh(nh);
+	if(readServicesThreads > 0)
+	{
+		readNh.setCallbackQueue(&readQueue_);
+	}
+	getMapDataSrv_ = readNh.advertiseService("get_map_data", &CoreWrapper::getMapDataCallback, this);
+	getMapData2Srv_ = readNh.advertiseService("get_map_data2", &CoreWrapper::getMapData2Callback, this);
+	getMapSrv_ = readNh.advertiseService("get_map", &CoreWrapper::getMapCallback, this);
+	getProbMapSrv_ = readNh.advertiseService("get_prob_map", &CoreWrapper::getProbMapCallback, this);
+	getGridMapSrv_ = readNh.advertiseService("get_grid_map", &CoreWrapper::getGridMapCallback, this);
+	getProjMapSrv_ = readNh.advertiseService("get_proj_map", &CoreWrapper::getProjMapCallback, this);
 	publishMapDataSrv_ = nh.advertiseService("publish_map", &CoreWrapper::publishMapCallback, this);
+	// planning services set the current path of rtabmap_
 	getPlanSrv_ = nh.advertiseService("get_plan", &CoreWrapper::getPlanCallback, this);
 	getPlanNodesSrv_ = nh.advertiseService("get_plan_nodes", &CoreWrapper::getPlanNodesCallback, this);
 	setGoalSrv_ = nh.advertiseService("set_goal", &CoreWrapper::setGoalCallback, this);
 	cancelGoalSrv_ = nh.advertiseService("cancel_goal", &CoreWrapper::cancelGoalCallback, this);
 	setLabelSrv_ = nh.advertiseService("set_label", &CoreWrapper::setLabelCallback, this);
-	listLabelsSrv_ = nh.advertiseService("list_labels", &CoreWrapper::listLabelsCallback, this);
+	listLabelsSrv_ = readNh.advertiseService("list_labels", &CoreWrapper::listLabelsCallback, this);
 	removeLabelSrv_ = nh.advertiseService("remove_label", &CoreWrapper::removeLabelCallback, this);
 	addLinkSrv_ = nh.advertiseService("add_link", &CoreWrapper::addLinkCallback, this);
-	getNodesInRadiusSrv_ = nh.advertiseService("get_nodes_in_radius", &CoreWrapper::getNodesInRadiusCallback, this);
+	getNodesInRadiusSrv_ = readNh.advertiseService("get_nodes_in_radius", &CoreWrapper::getNodesInRadiusCallback, this);
 #ifdef WITH_OCTOMAP_MSGS
 #ifdef RTABMAP_OCTOMAP
 	octomapBinarySrv_ = nh.advertiseService("octomap_binary", &CoreWrapper::octomapBinaryCallback, this);
@@ -727,6 +777,12 @@ void CoreWrapper::onInit()
 				Parameters::kOptimizerIterations().c_str(), mapFrameId_.c_str());
 	}
 
+	if(mapUpdateAsync_)
+	{
+		mapUpdateThreadRunning_ = true;
+		mapUpdateThread_ = new boost::thread(boost::bind(&CoreWrapper::mapUpdateLoop, this));
+	}
+
 	setupCallbacks(nh, pnh, getName()); // do it at the end
 	if(!this->isDataSubscribed())
 	{
@@ -822,10 +878,52 @@ void CoreWrapper::onInit()
 #endif
 	imuSub_ = nh.subscribe("imu", 100, &CoreWrapper::imuAsyncCallback, this);
 	republishNodeDataSub_ = nh.subscribe("republish_node_data", 100, &CoreWrapper::republishNodeDataCallback, this);
+	if(maxNodesRepublished_>0)
+	{
+		// prefetching doesn't delay the processing queue
+		ros::NodeHandle prefetchNh(nh);
+		prefetchNh.setCallbackQueue(&republishPrefetchQueue_);
+		republishPrefetchTimer_ = prefetchNh.createTimer(ros::Duration(0.01), &CoreWrapper::prefetchRepublishedNodes, this, false, false);
+		republishPrefetchSpinner_ = new ros::AsyncSpinner(1, &republishPrefetchQueue_);
+		republishPrefetchSpinner_->start();
+	}
+
+	publishReadSnapshot(true);
+	if(readServicesThreads > 0)
+	{
+		// grid of the map loaded from the database, the next ones are
+		// assembled by the map updates
+		std::map<int, Transform> poses = rtabmap_.getLocalOptimizedPoses();
+		mapsManagerMutex_.lock();
+		if(!poses.empty())
+		{
+			mapsManager_.updateMapCaches(poses, rtabmap_.getMemory(), true, false);
+		}
+		updateReadGrid(true);
+		mapsManagerMutex_.unlock();
+
+		readSpinnerRunning_ = true;
+		readSpinner_ = new ros::AsyncSpinner(readServicesThreads, &readQueue_);
+		readSpinner_->start();
+	}
 }
 
 CoreWrapper::~CoreWrapper()
 {
+	if(readSpinner_)
+	{
+		readSpinnerRunning_ = false;
+		readSpinner_->stop();
+		delete readSpinner_;
+	}
+
+	if(republishPrefetchSpinner_)
+	{
+		republishPrefetchTimer_.stop();
+		republishPrefetchSpinner_->stop();
+		delete republishPrefetchSpinner_;
+	}
+
 	if(transformThread_)
 	{
 		tfThreadRunning_ = false;
@@ -833,6 +931,16 @@ CoreWrapper::~CoreWrapper()
 		delete transformThread_;
 	}
 
+	if(mapUpdateThread_)
+	{
+		mapUpdateMutex_.lock();
+		mapUpdateThreadRunning_ = false;
+		mapUpdateMutex_.unlock();
+		mapUpdateCondition_.notify_one();
+		mapUpdateThread_->join();
+		delete mapUpdateThread_;
+	}
+
 	this->saveParameters(configPath_);
 
 	printf("rtabmap: Saving database/long-term memory... (located at %s)\n", databasePath_.c_str());
@@ -840,7 +948,9 @@ CoreWrapper::~CoreWrapper()
 	{
 		// save the grid map
 		float xMin=0.0f, yMin=0.0f, gridCellSize = 0.05f;
+		mapsManagerMutex_.lock();
 		cv::Mat pixels = mapsManager_.getGridMap(xMin, yMin, gridCellSize);
+		mapsManagerMutex_.unlock();
 		if(!pixels.empty())
 		{
 			printf("rtabmap: 2D occupancy grid map saved.\n");
@@ -1899,7 +2009,7 @@ void CoreWrapper::process(
 		// IMU
 		if(!imus_.empty())
 		{
-			Transform t = Transform::getTransform(imus_, data.stamp());
+			Transform t = imus_.getOrientation(data.stamp());
 			if(!t.isNull())
 			{
 				// get local transform
@@ -2070,16 +2180,82 @@ void CoreWrapper::process(
 				}
 
 				// Update maps
-				filteredPoses = mapsManager_.updateMapCaches(
-						filteredPoses,
-						rtabmap_.getMemory(),
-						false,
-						false,
-						tmpSignature);
+				if(mapUpdateAsync_)
+				{
+					// Load data of the nodes not already in the
+					// maps cache, the memory can only be accessed from this thread
+					std::set<int> missingIds;
+					std::map<int, Transform> candidates;
+					bool gridFromDepth = false;
+					{
+						// the map update thread uses mapsManager_, released before loading the data
+						boost::mutex::scoped_lock lock(mapsManagerMutex_);
+						if(mapsManager_.hasSubscribers())
+						{
+							candidates = mapsManager_.getFilteredPoses(filteredPoses);
+							if(candidates.empty())
+							{
+								candidates = filteredPoses;
+							}
+						}
+						gridFromDepth = mapsManager_.getOccupancyGrid()->isGridFromDepth();
+					}
+					if(!candidates.empty())
+					{
+						boost::mutex::scoped_lock lock(mapUpdateMutex_);
+						for(std::map<int, Transform>::iterator iter=candidates.begin(); iter!=candidates.end(); ++iter)
+						{
+							if(iter->first > 0 &&
+							   mapUpdateCachedIds_.find(iter->first) == mapUpdateCachedIds_.end() &&
+							   mapUpdateRequestedIds_.find(iter->first) == mapUpdateRequestedIds_.end())
+							{
+								missingIds.insert(iter->first);
+							}
+						}
+					}
+					std::map<int, Signature> signatures = MapsManager::loadNodesData(missingIds, rtabmap_.getMemory(), gridFromDepth);
+					signatures.insert(tmpSignature.begin(), tmpSignature.end());
+
+					timeUpdateMaps = timer.ticks();
+
+					// Hand off the snapshot to map update thread, a
+					// pending snapshot not yet processed is replaced.
+					mapUpdateMutex_.lock();
+					if(mapUpdatePending_)
+					{
+						// keep data of nodes not processed yet
+						for(std::map<int, Signature>::iterator iter=mapUpdateSignatures_.begin(); iter!=mapUpdateSignatures_.end(); ++iter)
+						{
+							if(iter->first > 0)
+							{
+								signatures.insert(*iter);
+							}
+						}
+						++mapUpdateCoalesced_;
+					}
+					mapUpdatePoses_ = filteredPoses;
+					mapUpdateSignatures_.swap(signatures);
+					mapUpdateStamp_ = stamp;
+					mapUpdateRequestedIds_.insert(missingIds.begin(), missingIds.end());
+					mapUpdatePending_ = true;
+					mapUpdateMutex_.unlock();
+					mapUpdateCondition_.notify_one();
+				}
+				else
+				{
+					boost::mutex::scoped_lock lock(mapsManagerMutex_);
+					filteredPoses = mapsManager_.updateMapCaches(
+							filteredPoses,
+							rtabmap_.getMemory(),
+							false,
+							false,
+							tmpSignature);
 
-				timeUpdateMaps = timer.ticks();
+					timeUpdateMaps = timer.ticks();
 
-				mapsManager_.publishMaps(filteredPoses, stamp, mapFrameId_);
+					mapsManager_.publishMaps(filteredPoses, stamp, mapFrameId_);
+					updateReadGrid();
+				}
 
 				// update goal if planning is enabled
 				if(!currentMetricGoal_.isNull())
@@ -2169,6 +2345,8 @@ void CoreWrapper::process(
 					}
 				}
 
+				publishReadSnapshot();
+
 				timePublishMaps = timer.ticks();
 			}
 		}
@@ -2186,7 +2364,10 @@ void CoreWrapper::process(
 				timePublishMaps,
 				(int)rtabmap_.getLocalOptimizedPoses().size(),
 				rtabmap_.getWMSize()+rtabmap_.getSTMSize());
-		rtabmapROSStats_.insert(std::make_pair(std::string("RtabmapROS/HasSubscribers/"), mapsManager_.hasSubscribers()?1:0));
+		mapsManagerMutex_.lock();
+		bool mapsHaveSubscribers = mapsManager_.hasSubscribers();
+		mapsManagerMutex_.unlock();
+		rtabmapROSStats_.insert(std::make_pair(std::string("RtabmapROS/HasSubscribers/"), mapsHaveSubscribers?1:0));
 		rtabmapROSStats_.insert(std::make_pair(std::string("RtabmapROS/TimeMsgConversion/ms"), timeMsgConversion*1000.0f));
 		rtabmapROSStats_.insert(std::make_pair(std::string("RtabmapROS/TimeRtabmap/ms"), timeRtabmap*1000.0f));
 		rtabmapROSStats_.insert(std::make_pair(std::string("RtabmapROS/TimeUpdatingMaps/ms"), timeUpdateMaps*1000.0f));
@@ -2364,11 +2545,11 @@ void CoreWrapper::imuAsyncCallback(const sensor_msgs::ImuConstPtr & msg)
 		}
 		else
 		{
-			Transform orientation(0,0,0, msg->orientation.x, msg->orientation.y, msg->orientation.z, msg->orientation.w);
-			imus_.insert(std::make_pair(msg->header.stamp.toSec(), orientation));
-			if(imus_.size() > 1000)
+			// the local transform is looked up at the data stamp, see process()
+			if(!imus_.push(*msg, Transform::getIdentity()))
 			{
-				imus_.erase(imus_.begin());
+				NODELET_WARN_THROTTLE(1, "IMU msg received with stamp %f older than the last one (%f), it is ignored.", msg->header.stamp.toSec(), imus_.lastStamp());
+				return;
 			}
 			if(!imuFrameId_.empty() && imuFrameId_.compare(msg->header.frame_id) != 0)
 			{
@@ -2393,7 +2574,10 @@ void CoreWrapper::republishNodeDataCallback(const std_msgs::Int32MultiArray::Con
 {
 	if(maxNodesRepublished_>0)
 	{
+		republishMutex_.lock();
 		nodesToRepublish_.insert(msg->data.begin(), msg->data.end());
+		republishMutex_.unlock();
+		republishPrefetchTimer_.start();
 	}
 	else
 	{
@@ -2409,6 +2593,61 @@ void CoreWrapper::republishNodeDataCallback(const std_msgs::Int32MultiArray::Con
 	}
 }
 
+void CoreWrapper::prefetchRepublishedNodes(const ros::TimerEvent &)
+{
+	// Load some of the requested nodes between updates, so that
+	// publishStats() doesn't have to read them from the database.
+	// Called from the prefetch thread: only the database is read, which
+	// is thread-safe. Nodes not saved in it yet are set empty and
+	// publishStats() loads them from the memory.
+	std::list<int> ids;
+	{
+		boost::mutex::scoped_lock lock(republishMutex_);
+		for(std::set<int>::iterator iter=nodesToRepublish_.begin();
+			iter!=nodesToRepublish_.end() && (int)(republishPrefetched_.size()+ids.size())<maxNodesRepublished_;
+			++iter)
+		{
+			if(republishPrefetched_.find(*iter) == republishPrefetched_.end())
+			{
+				ids.push_back(*iter);
+			}
+		}
+	}
+	if(ids.empty())
+	{
+		republishPrefetchTimer_.stop();
+		return;
+	}
+
+	std::map<int, SensorData> loaded;
+	{
+		boost::mutex::scoped_lock lock(dbReadMutex_);
+		if(rtabmap_.getMemory() && rtabmap_.getMemory()->getDbDriver())
+		{
+			for(std::list<int>::iterator iter=ids.begin(); iter!=ids.end(); ++iter)
+			{
+				SensorData data;
+				rtabmap_.getMemory()->getDbDriver()->getNodeData(*iter, data, true, true, true, true);
+				loaded.insert(std::make_pair(*iter, data));
+			}
+		}
+	}
+
+	boost::mutex::scoped_lock lock(republishMutex_);
+	for(std::map<int, SensorData>::iterator iter=loaded.begin(); iter!=loaded.end(); ++iter)
+	{
+		// skip nodes removed or consumed in the meantime
+		if(nodesToRepublish_.find(iter->first) != nodesToRepublish_.end())
+		{
+			republishPrefetched_.insert(*iter);
+		}
+	}
+	if(loaded.empty())
+	{
+		republishPrefetchTimer_.stop();
+	}
+}
+
 void CoreWrapper::interOdomCallback(const nav_msgs::OdometryConstPtr & msg)
 {
 	if(!paused_)
@@ -2436,6 +2675,7 @@ void CoreWrapper::initialPoseCallback(const geometry_msgs::PoseWithCovarianceSta
 	}
 
 	rtabmap_.setInitialPose(intialPose);
+	publishReadSnapshot();
 }
 
 void CoreWrapper::goalCommonCallback(
@@ -2690,14 +2930,20 @@ bool CoreWrapper::updateRtabmapCallback(std_srvs::Empty::Request&, std_srvs::Emp
 		NODELET_INFO("2D mapping = %s", twoDMapping_?"true":"false");
 	}
 	rtabmap_.parseParameters(parameters_);
+	mapsManagerMutex_.lock();
 	mapsManager_.setParameters(parameters_);
+	clearMapUpdate();
+	mapsManagerMutex_.unlock();
+	publishReadSnapshot();
 	return true;
 }
 
 bool CoreWrapper::resetRtabmapCallback(std_srvs::Empty::Request&, std_srvs::Empty::Response&)
 {
 	NODELET_INFO("rtabmap: Reset");
+	dbReadMutex_.lock();
 	rtabmap_.resetMemory();
+	dbReadMutex_.unlock();
 	covariance_ = cv::Mat();
 	lastPose_.setIdentity();
 	lastPoseVelocity_.clear();
@@ -2706,7 +2952,10 @@ bool CoreWrapper::resetRtabmapCallback(std_srvs::Empty::Request&, std_srvs::Empt
 	lastPublishedMetricGoal_.setNull();
 	goalFrameId_.clear();
 	latestNodeWasReached_ = false;
+	mapsManagerMutex_.lock();
 	mapsManager_.clear();
+	clearMapUpdate();
+	mapsManagerMutex_.unlock();
 	previousStamp_ = ros::Time(0);
 	globalPose_.header.stamp = ros::Time(0);
 	gps_ = rtabmap::GPS();
@@ -2720,7 +2969,11 @@ bool CoreWrapper::resetRtabmapCallback(std_srvs::Empty::Request&, std_srvs::Empt
 	mapToOdomMutex_.lock();
 	mapToOdom_.setIdentity();
 	mapToOdomMutex_.unlock();
+	republishMutex_.lock();
 	nodesToRepublish_.clear();
+	republishPrefetched_.clear();
+	republishMutex_.unlock();
+	publishReadSnapshot(true);
 
 	return true;
 }
@@ -2779,14 +3032,18 @@ bool CoreWrapper::loadDatabaseCallback(rtabmap_ros::LoadDatabase::Request& req,
 	{
 		// save the grid map
 		float xMin=0.0f, yMin=0.0f, gridCellSize = 0.05f;
+		mapsManagerMutex_.lock();
 		cv::Mat pixels = mapsManager_.getGridMap(xMin, yMin, gridCellSize);
+		mapsManagerMutex_.unlock();
 		if(!pixels.empty())
 		{
 			printf("rtabmap: 2D occupancy grid map saved.\n");
 			rtabmap_.getMemory()->save2DMap(pixels, xMin, yMin, gridCellSize);
 		}
 	}
+	dbReadMutex_.lock();
 	rtabmap_.close();
+	dbReadMutex_.unlock();
 	NODELET_INFO("LoadDatabase: Saving current map (%s, %ld MB)... done!", databasePath_.c_str(), UFile::length(databasePath_)/(1024*1024));
 
 	covariance_ = cv::Mat();
@@ -2797,7 +3054,10 @@ bool CoreWrapper::loadDatabaseCallback(rtabmap_ros::LoadDatabase::Request& req,
 	lastPublishedMetricGoal_.setNull();
 	goalFrameId_.clear();
 	latestNodeWasReached_ = false;
+	mapsManagerMutex_.lock();
 	mapsManager_.clear();
+	clearMapUpdate();
+	mapsManagerMutex_.unlock();
 	previousStamp_ = ros::Time(0);
 	globalPose_.header.stamp = ros::Time(0);
 	gps_ = rtabmap::GPS();
@@ -2811,7 +3071,10 @@ bool CoreWrapper::loadDatabaseCallback(rtabmap_ros::LoadDatabase::Request& req,
 	mapToOdomMutex_.lock();
 	mapToOdom_.setIdentity();
 	mapToOdomMutex_.unlock();
+	republishMutex_.lock();
 	nodesToRepublish_.clear();
+	republishPrefetched_.clear();
+	republishMutex_.unlock();
 
 	// Open new database
 	databasePath_ = newDatabasePath;
@@ -2848,7 +3111,9 @@ bool CoreWrapper::loadDatabaseCallback(rtabmap_ros::LoadDatabase::Request& req,
 	}
 
 	NODELET_INFO("LoadDatabase: Loading database...");
+	dbReadMutex_.lock();
 	rtabmap_.init(parameters_, databasePath_);
+	dbReadMutex_.unlock();
 	NODELET_INFO("LoadDatabase: Loading database... done!");
 
 	if(rtabmap_.getMemory())
@@ -2860,7 +3125,10 @@ bool CoreWrapper::loadDatabaseCallback(rtabmap_ros::LoadDatabase::Request& req,
 			if(!map.empty())
 			{
 				NODELET_INFO("LoadDatabase: 2D occupancy grid map loaded (%dx%d).", map.cols, map.rows);
+				mapsManagerMutex_.lock();
 				mapsManager_.set2DMap(map, xMin, yMin, gridCellSize, rtabmap_.getLocalOptimizedPoses(), rtabmap_.getMemory());
+				clearMapUpdate();
+				mapsManagerMutex_.unlock();
 			}
 		}
 
@@ -2884,6 +3152,7 @@ bool CoreWrapper::loadDatabaseCallback(rtabmap_ros::LoadDatabase::Request& req,
 		{
 			NODELET_INFO("LoadDatabase: Localization mode (%s=false)", Parameters::kMemIncrementalMemory().c_str());
 		}
+		publishReadSnapshot(true);
 
 		return true;
 	}
@@ -2895,6 +3164,7 @@ bool CoreWrapper::triggerNewMapCallback(std_srvs::Empty::Request&, std_srvs::Emp
 {
 	NODELET_INFO("rtabmap: Trigger new map");
 	rtabmap_.triggerNewMap();
+	publishReadSnapshot();
 	return true;
 }
 
@@ -2905,14 +3175,18 @@ bool CoreWrapper::backupDatabaseCallback(std_srvs::Empty::Request&, std_srvs::Em
 	{
 		// save the grid map
 		float xMin=0.0f, yMin=0.0f, gridCellSize = 0.05f;
+		mapsManagerMutex_.lock();
 		cv::Mat pixels = mapsManager_.getGridMap(xMin, yMin, gridCellSize);
+		mapsManagerMutex_.unlock();
 		if(!pixels.empty())
 		{
 			printf("rtabmap: 2D occupancy grid map saved.\n");
 			rtabmap_.getMemory()->save2DMap(pixels, xMin, yMin, gridCellSize);
 		}
 	}
+	dbReadMutex_.lock();
 	rtabmap_.close();
+	dbReadMutex_.unlock();
 	NODELET_INFO("Backup: Saving memory... done!");
 
 	covariance_ = cv::Mat();
@@ -2928,23 +3202,109 @@ bool CoreWrapper::backupDatabaseCallback(std_srvs::Empty::Request&, std_srvs::Em
 	globalPose_.header.stamp = ros::Time(0);
 	gps_ = rtabmap::GPS();
 	tags_.clear();
+	republishMutex_.lock();
 	nodesToRepublish_.clear();
+	republishPrefetched_.clear();
+	republishMutex_.unlock();
 
 	NODELET_INFO("Backup: Saving \"%s\" to \"%s\"...", databasePath_.c_str(), (databasePath_+".back").c_str());
 	UFile::copy(databasePath_, databasePath_+".back");
 	NODELET_INFO("Backup: Saving \"%s\" to \"%s\"... done!", databasePath_.c_str(), (databasePath_+".back").c_str());
 
 	NODELET_INFO("Backup: Reloading memory...");
+	dbReadMutex_.lock();
 	rtabmap_.init(parameters_, databasePath_);
+	dbReadMutex_.unlock();
 	NODELET_INFO("Backup: Reloading memory... done!");
 
 	return true;
 }
 
+void CoreWrapper::mapUpdateLoop()
+{
+	NODELET_INFO("rtabmap: Map update thread started!");
+	while(1)
+	{
+		std::map<int, Transform> poses;
+		std::map<int, Signature> signatures;
+		ros::Time stamp;
+		int coalesced = 0;
+		{
+			boost::mutex::scoped_lock lock(mapUpdateMutex_);
+			while(mapUpdateThreadRunning_ && !mapUpdatePending_)
+			{
+				mapUpdateCondition_.wait(lock);
+			}
+			if(!mapUpdateThreadRunning_)
+			{
+				break;
+			}
+			poses.swap(mapUpdatePoses_);
+			signatures.swap(mapUpdateSignatures_);
+			stamp = mapUpdateStamp_;
+			coalesced = mapUpdateCoalesced_;
+			mapUpdateCoalesced_ = 0;
+			mapUpdatePending_ = false;
+		}
+
+		UTimer timer;
+		boost::mutex::scoped_lock lock(mapsManagerMutex_);
+		// memory is not accessed here, required data are already in signatures
+		poses = mapsManager_.updateMapCaches(
+				poses,
+				0,
+				false,
+				false,
+				signatures);
+		double timeUpdateMaps = timer.ticks();
+
+		mapsManager_.publishMaps(poses, stamp, mapFrameId_);
+		updateReadGrid();
+		double timePublishMaps = timer.ticks();
+
+		std::set<int> cachedIds = mapsManager_.getCachedNodes();
+		mapUpdateMutex_.lock();
+		mapUpdateCachedIds_.swap(cachedIds);
+		for(std::map<int, Signature>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+		{
+			mapUpdateRequestedIds_.erase(iter->first);
+		}
+		mapUpdateMutex_.unlock();
+
+		NODELET_INFO("rtabmap (async maps): Maps update=%fs pub=%fs (nodes=%d, skipped updates=%d)",
+				timeUpdateMaps,
+				timePublishMaps,
+				(int)poses.size(),
+				coalesced);
+	}
+	NODELET_INFO("rtabmap: Map update thread stopped!");
+}
+
+// mapsManagerMutex_ should be locked
+void CoreWrapper::clearMapUpdate()
+{
+	updateReadGrid(true);
+	if(mapUpdateAsync_)
+	{
+		std::set<int> cachedIds = mapsManager_.getCachedNodes();
+		boost::mutex::scoped_lock lock(mapUpdateMutex_);
+		mapUpdatePending_ = false;
+		mapUpdatePoses_.clear();
+		mapUpdateSignatures_.clear();
+		mapUpdateCoalesced_ = 0;
+		mapUpdateRequestedIds_.clear();
+		mapUpdateCachedIds_.swap(cachedIds);
+	}
+}
+
 void CoreWrapper::republishMaps()
 {
+	publishReadSnapshot();
+
 	ros::Time stamp = ros::Time::now();
+	mapsManagerMutex_.lock();
 	mapsManager_.publishMaps(rtabmap_.getLocalOptimizedPoses(), stamp, mapFrameId_);
+	mapsManagerMutex_.unlock();
 
 	if(mapDataPub_.getNumSubscribers())
 	{
@@ -2952,12 +3312,13 @@ void CoreWrapper::republishMaps()
 		msg->header.stamp = stamp;
 		msg->header.frame_id = mapFrameId_;
 
-		rtabmap_ros::mapDataToROS(
+		fillMapGraph(
+			mapDataDeltaState_,
 			rtabmap_.getLocalOptimizedPoses(),
 			rtabmap_.getLocalConstraints(),
-			std::map<int, Signature>(),
 			rtabmap_.getMapCorrection(),
-			*msg);
+			msg->graph,
+			true);
 
 		mapDataPub_.publish(msg);
 	}
@@ -2968,16 +3329,63 @@ void CoreWrapper::republishMaps()
 		msg->header.stamp = stamp;
 		msg->header.frame_id = mapFrameId_;
 
-		rtabmap_ros::mapGraphToROS(
-		rtabmap_.getLocalOptimizedPoses(),
-		rtabmap_.getLocalConstraints(),
-		rtabmap_.getMapCorrection(),
-		*msg);
+		fillMapGraph(
+			mapGraphDeltaState_,
+			rtabmap_.getLocalOptimizedPoses(),
+			rtabmap_.getLocalConstraints(),
+			rtabmap_.getMapCorrection(),
+			*msg,
+			true);
 
 		mapGraphPub_.publish(msg);
 	}
 }
 
+void CoreWrapper::fillMapGraph(
+		GraphDeltaState & state,
+		const std::map<int, Transform> & poses,
+		const std::multimap<int, Link> & links,
+		const Transform & mapToOdom,
+		rtabmap_ros::MapGraph & msg,
+		bool keyframe)
+{
+	msg.deltaBaseId = state.graphId;
+	msg.graphId = ++state.graphId;
+	if(!mapGraphDelta_)
+	{
+		rtabmap_ros::mapGraphToROS(poses, links, mapToOdom, msg);
+		return;
+	}
+
+	// send the complete graph periodically and when a new subscriber is connected
+	bool newSubscriber = state.newSubscriber.exchange(false);
+	keyframe = keyframe ||
+			newSubscriber ||
+			(mapGraphDeltaKeyframeInterval_ > 0 && state.sinceKeyframe >= mapGraphDeltaKeyframeInterval_);
+	if(rtabmap_ros::mapGraphDeltaToROS(
+			poses,
+			links,
+			mapToOdom,
+			mapGraphDeltaTolerance_,
+			keyframe,
+			state.poses,
+			state.links,
+			msg))
+	{
+		++state.sinceKeyframe;
+	}
+	else
+	{
+		state.sinceKeyframe = 0;
+	}
+}
+
+// Called for each subscriber connected, even if one left since the last update
+void CoreWrapper::graphSubscriberConnected(const ros::SingleSubscriberPublisher &, GraphDeltaState * state)
+{
+	state->newSubscriber = true;
+}
+
 bool CoreWrapper::detectMoreLoopClosuresCallback(rtabmap_ros::DetectMoreLoopClosures::Request& req, rtabmap_ros::DetectMoreLoopClosures::Response& res)
 {
 	NODELET_WARN("Detect more loop closures service called");
@@ -3058,7 +3466,9 @@ bool CoreWrapper::cleanupLocalGridsCallback(rtabmap_ros::CleanupLocalGrids::Requ
 	}
 	filterScans = req.filter_scans;
 	float xMin, yMin, gridCellSize;
+	mapsManagerMutex_.lock();
 	cv::Mat map = mapsManager_.getGridMap(xMin, yMin, gridCellSize);
+	mapsManagerMutex_.unlock();
 	if(map.empty())
 	{
 		NODELET_ERROR("Post-Processing: Cleanup local grids failed! There is no optimized map.");
@@ -3086,8 +3496,11 @@ bool CoreWrapper::cleanupLocalGridsCallback(rtabmap_ros::CleanupLocalGrids::Requ
 		if(res.modified > 0)
 		{
 			// We should update MapsManager's cache with the modifications
+			mapsManagerMutex_.lock();
 			mapsManager_.clear();
 			mapsManager_.set2DMap(map, xMin, yMin, gridCellSize, rtabmap_.getLocalOptimizedPoses(), rtabmap_.getMemory());
+			clearMapUpdate();
+			mapsManagerMutex_.unlock();
 
 			republishMaps();
 		}
@@ -3204,20 +3617,183 @@ bool CoreWrapper::getNodeDataCallback(rtabmap_ros::GetNodeData::Request& req, rt
 	{
 		req.ids.push_back(rtabmap_.getMemory()->getLastWorkingSignature()->id());
 	}
-	for(size_t i=0; i<req.ids.size(); ++i)
+	loadNodesData(req.ids, req.images, req.scan, req.user_data, req.grid, true, true, res.data);
+
+	return !res.data.empty();
+}
+
+// Convert signatures to NodeData, in parallel
+class NodesDataToROS : public cv::ParallelLoopBody
+{
+public:
+	NodesDataToROS(const std::vector<const Signature *> & signatures, std::vector<rtabmap_ros::NodeData> & nodes) :
+		signatures_(signatures),
+		nodes_(nodes)
+	{}
+	virtual void operator()(const cv::Range & range) const
+	{
+		for(int i=range.start; i<range.end; ++i)
+		{
+			rtabmap_ros::nodeDataToROS(*signatures_[i], nodes_[i]);
+		}
+	}
+private:
+	const std::vector<const Signature *> & signatures_;
+	std::vector<rtabmap_ros::NodeData> & nodes_;
+};
+
+void CoreWrapper::loadNodesData(
+		const std::vector<int> & ids,
+		bool images,
+		bool scan,
+		bool userData,
+		bool grid,
+		bool words,
+		bool globalDescriptors,
+		std::vector<rtabmap_ros::NodeData> & nodes)
+{
+	std::map<int, Signature> loaded = loadSignatures(
+			std::set<int>(ids.begin(), ids.end()),
+			images,
+			scan,
+			userData,
+			grid,
+			words,
+			globalDescriptors);
+	nodesDataToROS(ids, loaded, nodes);
+}
+
+// Should be called from the processing queue. Nodes in working memory are
+// copied from it, the others are loaded from the database in one pass.
+// If dataNotLoaded is set, the data of the nodes already saved in the
+// database are not loaded, their ids are added to it so that they can be
+// loaded later outside the processing queue (see readMapData()).
+std::map<int, Signature> CoreWrapper::loadSignatures(
+		const std::set<int> & ids,
+		bool images,
+		bool scan,
+		bool userData,
+		bool grid,
+		bool words,
+		bool globalDescriptors,
+		std::list<int> * dataNotLoaded)
+{
+	bool withData = images || scan || userData || grid;
+	std::map<int, Signature> loaded;
+	const Memory * memory = rtabmap_.getMemory();
+	std::list<int> databaseIds;
+	for(std::set<int>::const_iterator iter=ids.begin(); iter!=ids.end(); ++iter)
 	{
-		int id = req.ids[i];
-		Signature s = rtabmap_.getSignatureCopy(id, req.images, req.scan, req.user_data, req.grid, true, true);
+		const Signature * inMemory = memory && memory->getDbDriver()?memory->getSignature(*iter):0;
+		if(memory && memory->getDbDriver() && inMemory == 0)
+		{
+			databaseIds.push_back(*iter);
+		}
+		else if(dataNotLoaded && withData && inMemory && inMemory->isSaved())
+		{
+			// in working memory, the data may have been released
+			Signature s = rtabmap_.getSignatureCopy(*iter, false, false, false, false, words, globalDescriptors);
+			if(s.id()>0)
+			{
+				loaded.insert(std::make_pair(*iter, s));
+				dataNotLoaded->push_back(*iter);
+			}
+		}
+		else
+		{
+			Signature s = rtabmap_.getSignatureCopy(*iter, images, scan, userData, grid, words, globalDescriptors);
+			if(s.id()>0)
+			{
+				loaded.insert(std::make_pair(*iter, s));
+			}
+		}
+	}
 
-		if(s.id()>0)
+	if(!databaseIds.empty())
+	{
+		// Like Memory does for nodes not in its working memory (see
+		// Memory::getNodeWordsAndGlobalDescriptors()), signatures still
+		// in the database trash are taken from it, they are put back
+		// right away and copied from memory instead.
+		DBDriver * driver = const_cast<DBDriver*>(memory->getDbDriver());
+		std::list<Signature*> signatures;
+		std::set<int> loadedFromTrash;
+		driver->loadSignatures(databaseIds, signatures, &loadedFromTrash);
+		std::list<Signature*> fromDatabase;
+		for(std::list<Signature*>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
 		{
-			NodeData msg;
-			rtabmap_ros::nodeDataToROS(s, msg);
-			res.data.push_back(msg);
+			if(loadedFromTrash.find((*iter)->id()) != loadedFromTrash.end())
+			{
+				driver->asyncSave(*iter);
+			}
+			else
+			{
+				fromDatabase.push_back(*iter);
+			}
+		}
+		if(!fromDatabase.empty() && withData && dataNotLoaded == 0)
+		{
+			driver->loadNodeData(fromDatabase, images, scan, userData, grid);
+		}
+		for(std::list<Signature*>::iterator iter=fromDatabase.begin(); iter!=fromDatabase.end(); ++iter)
+		{
+			Signature & s = loaded.insert(std::make_pair((*iter)->id(), **iter)).first->second;
+			delete *iter;
+			if(dataNotLoaded && withData)
+			{
+				dataNotLoaded->push_back(s.id());
+			}
+			if(!words)
+			{
+				s.setWords(std::multimap<int, int>(), std::vector<cv::KeyPoint>(), std::vector<cv::Point3f>(), cv::Mat());
+			}
+			if(!globalDescriptors)
+			{
+				s.sensorData().setGlobalDescriptors(std::vector<GlobalDescriptor>());
+			}
+		}
+		for(std::set<int>::iterator iter=loadedFromTrash.begin(); iter!=loadedFromTrash.end(); ++iter)
+		{
+			Signature s = rtabmap_.getSignatureCopy(*iter, images, scan, userData, grid, words, globalDescriptors);
+			if(s.id()>0)
+			{
+				loaded.insert(std::make_pair(*iter, s));
+			}
 		}
 	}
+	return loaded;
+}
 
-	return !res.data.empty();
+// Convert the signatures in the requested order, ids not found or
+// requested more than once are skipped.
+void CoreWrapper::nodesDataToROS(
+		const std::vector<int> & ids,
+		const std::map<int, Signature> & loaded,
+		std::vector<rtabmap_ros::NodeData> & nodes) const
+{
+	std::vector<const Signature *> signatures;
+	signatures.reserve(loaded.size());
+	std::set<int> added;
+	for(size_t i=0; i<ids.size(); ++i)
+	{
+		std::map<int, Signature>::const_iterator iter = loaded.find(ids[i]);
+		if(iter != loaded.end() && added.insert(ids[i]).second)
+		{
+			signatures.push_back(&iter->second);
+		}
+	}
+
+	nodes.resize(signatures.size());
+	NodesDataToROS toROS(signatures, nodes);
+	if(nodeDataThreads_ > 1 && signatures.size() > 1)
+	{
+		// on OpenCV's thread pool, split in node_data_threads parts
+		cv::parallel_for_(cv::Range(0, signatures.size()), toROS, nodeDataThreads_);
+	}
+	else
+	{
+		toROS(cv::Range(0, signatures.size()));
+	}
 }
 
 bool CoreWrapper::getMapDataCallback(rtabmap_ros::GetMap::Request& req, rtabmap_ros::GetMap::Response& res)
@@ -3226,27 +3802,21 @@ bool CoreWrapper::getMapDataCallback(rtabmap_ros::GetMap::Request& req, rtabmap_
 			req.global?"true":"false",
 			req.optimized?"true":"false",
 			req.graphOnly?"true":"false");
-	std::map<int, Signature> signatures;
-	std::map<int, Transform> poses;
-	std::multimap<int, rtabmap::Link> constraints;
 
-	rtabmap_.getGraph(
-			poses,
-			constraints,
-			req.optimized,
-			req.global,
-			&signatures,
-			!req.graphOnly,
-			!req.graphOnly,
-			!req.graphOnly,
-			!req.graphOnly);
-
-	//RGB-D SLAM data
-	rtabmap_ros::mapDataToROS(poses,
-		constraints,
-		signatures,
-		mapToOdom_,
-		res.data);
+	rtabmap_ros::GetMap2::Request req2;
+	req2.global = req.global;
+	req2.optimized = req.optimized;
+	req2.with_images = !req.graphOnly;
+	req2.with_scans = !req.graphOnly;
+	req2.with_user_data = !req.graphOnly;
+	req2.with_grids = !req.graphOnly;
+	// like Rtabmap::getGraph()'s defaults
+	req2.with_words = true;
+	req2.with_global_descriptors = true;
+	if(!readMapData(req2, res.data))
+	{
+		return false;
+	}
 
 	res.data.header.stamp = ros::Time::now();
 	res.data.header.frame_id = mapFrameId_;
@@ -3263,40 +3833,331 @@ bool CoreWrapper::getMapData2Callback(rtabmap_ros::GetMap2::Request& req, rtabma
 			req.with_scans?"true":"false",
 			req.with_user_data?"true":"false",
 			req.with_grids?"true":"false");
+
+	if(!readMapData(req, res.data))
+	{
+		return false;
+	}
+
+	res.data.header.stamp = ros::Time::now();
+	res.data.header.frame_id = mapFrameId_;
+
+	return true;
+}
+
+// Called from a read-only service thread. The local optimized graph comes
+// from the read snapshot and the nodes saved in the database are loaded
+// through the database driver. Only the other graphs, the nodes not saved
+// yet and the words, which need rtabmap_'s memory, are copied in one call
+// on the processing queue. The data of the nodes are then loaded here from
+// the database in one pass.
+bool CoreWrapper::readMapData(const rtabmap_ros::GetMap2::Request & req, rtabmap_ros::MapData & msg)
+{
+	bool withData = req.with_images || req.with_scans || req.with_user_data || req.with_grids;
+	bool withWords = req.with_words || req.with_global_descriptors;
+	std::map<int, Transform> poses;
+	std::multimap<int, rtabmap::Link> constraints;
 	std::map<int, Signature> signatures;
+	std::list<int> dataNotLoaded;
+
+	bool withGraph = !req.optimized || req.global;
+	if(!withGraph)
+	{
+		boost::shared_ptr<const ReadSnapshot> snapshot = getReadSnapshot();
+		poses = snapshot->poses;
+		constraints = snapshot->constraints;
+
+		// the database driver doesn't give the words
+		if(!withWords)
+		{
+			readSnapshotMutex_.lock();
+			boost::shared_ptr<const std::map<int, std::string> > labels = readLabels_;
+			readSnapshotMutex_.unlock();
+
+			boost::mutex::scoped_lock lock(dbReadMutex_);
+			if(rtabmap_.getMemory() && rtabmap_.getMemory()->getDbDriver())
+			{
+				const DBDriver * driver = rtabmap_.getMemory()->getDbDriver();
+				for(std::map<int, Transform>::iterator iter=poses.lower_bound(1); iter!=poses.end(); ++iter)
+				{
+					Transform odomPose, groundTruth;
+					int mapId, weight;
+					std::string label;
+					double stamp;
+					std::vector<float> velocity;
+					GPS gps;
+					EnvSensors sensors;
+					if(driver->getNodeInfo(iter->first, odomPose, mapId, weight, label, stamp, groundTruth, velocity, gps, sensors))
+					{
+						// the label may have changed in memory
+						std::map<int, std::string>::const_iterator jter = labels->find(iter->first);
+						SensorData data;
+						data.setId(iter->first);
+						data.setGPS(gps);
+						signatures.insert(std::make_pair(iter->first,
+								Signature(iter->first, mapId, weight, stamp, jter!=labels->end()?jter->second:"", odomPose, groundTruth, data)));
+						if(withData)
+						{
+							dataNotLoaded.push_back(iter->first);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if(withGraph || signatures.size() < (size_t)std::distance(poses.lower_bound(1), poses.end()))
+	{
+		if(!callOnProcessingQueue(boost::bind(&CoreWrapper::copyMapData, this, &req, withGraph, &poses, &constraints, &signatures, &dataNotLoaded)))
+		{
+			NODELET_ERROR("rtabmap: shutting down, cannot get the map.");
+			return false;
+		}
+	}
+
+	if(!dataNotLoaded.empty())
+	{
+		bool loaded = false;
+		{
+			boost::mutex::scoped_lock lock(dbReadMutex_);
+			if(rtabmap_.getMemory() && rtabmap_.getMemory()->getDbDriver())
+			{
+				std::list<Signature*> toLoad;
+				for(std::list<int>::iterator iter=dataNotLoaded.begin(); iter!=dataNotLoaded.end(); ++iter)
+				{
+					toLoad.push_back(&signatures.at(*iter));
+				}
+				try
+				{
+					rtabmap_.getMemory()->getDbDriver()->loadNodeData(toLoad, req.with_images, req.with_scans, req.with_user_data, req.with_grids);
+					loaded = true;
+				}
+				catch(const UException & e)
+				{
+					// a node has been moved to the database trash in the meantime
+					NODELET_WARN("rtabmap: %s", e.what());
+				}
+			}
+		}
+		if(!loaded)
+		{
+			for(std::list<int>::iterator iter=dataNotLoaded.begin(); iter!=dataNotLoaded.end(); ++iter)
+			{
+				signatures.erase(*iter);
+			}
+			if(!callOnProcessingQueue(boost::bind(&CoreWrapper::copyMapData, this, &req, false, &poses, &constraints, &signatures, (std::list<int>*)0)))
+			{
+				NODELET_ERROR("rtabmap: shutting down, cannot get the map.");
+				return false;
+			}
+		}
+	}
+
+	mapToOdomMutex_.lock();
+	Transform mapToOdom = mapToOdom_;
+	mapToOdomMutex_.unlock();
+	rtabmap_ros::mapDataToROS(poses, constraints, std::map<int, Signature>(), mapToOdom, msg);
+	nodesDataToROS(uKeys(signatures), signatures, msg.nodes);
+	return true;
+}
+
+// Should be called from the processing queue, see readMapData(). The nodes
+// of the graph not already in signatures are added to it.
+void CoreWrapper::copyMapData(
+		const rtabmap_ros::GetMap2::Request * req,
+		bool withGraph,
+		std::map<int, Transform> * poses,
+		std::multimap<int, rtabmap::Link> * constraints,
+		std::map<int, Signature> * signatures,
+		std::list<int> * dataNotLoaded)
+{
+	if(withGraph)
+	{
+		rtabmap_.getGraph(*poses, *constraints, req->optimized, req->global);
+	}
+	std::set<int> ids;
+	for(std::map<int, Transform>::iterator iter=poses->lower_bound(1); iter!=poses->end(); ++iter)
+	{
+		if(signatures->find(iter->first) == signatures->end())
+		{
+			ids.insert(iter->first);
+		}
+	}
+	std::map<int, Signature> loaded = loadSignatures(
+			ids,
+			req->with_images,
+			req->with_scans,
+			req->with_user_data,
+			req->with_grids,
+			req->with_words,
+			req->with_global_descriptors,
+			dataNotLoaded);
+	signatures->insert(loaded.begin(), loaded.end());
+}
+
+// Delta with graphId=deltaBaseId=0, ignored by mapGraphDeltaFromROS()
+static void setNoGraph(rtabmap_ros::MapGraph & msg)
+{
+	msg.delta = true;
+	msg.graphId = 0;
+	msg.deltaBaseId = 0;
+	msg.mapToOdom.rotation.w = 1.0;
+}
+
+bool CoreWrapper::getMapDataChunkCallback(rtabmap_ros::GetMapChunk::Request& req, rtabmap_ros::GetMapChunk::Response& res)
+{
+	NODELET_INFO("rtabmap: Getting map chunk (global=%s optimized=%s ids=[%d,%d] page_size=%d cursor=%d stream=%s)...",
+			req.global?"true":"false",
+			req.optimized?"true":"false",
+			req.min_id,
+			req.max_id,
+			req.page_size,
+			req.cursor,
+			req.stream?"true":"false");
+
+	// The nodes are selected on the first page, the next pages use the same
+	// selection so that the graph is not recomputed and filtered on each page
+	const rtabmap_ros::GetMapChunk::Request & cached = mapDataChunkPagesRequest_;
+	bool sameSelection =
+			req.global == cached.global &&
+			req.optimized == cached.optimized &&
+			req.min_id == cached.min_id &&
+			req.max_id == cached.max_id &&
+			req.bbox_min.x == cached.bbox_min.x && req.bbox_min.y == cached.bbox_min.y && req.bbox_min.z == cached.bbox_min.z &&
+			req.bbox_max.x == cached.bbox_max.x && req.bbox_max.y == cached.bbox_max.y && req.bbox_max.z == cached.bbox_max.z;
+
+	// The graph is small, only the data of the nodes of the page are loaded
 	std::map<int, Transform> poses;
 	std::multimap<int, rtabmap::Link> constraints;
+	if(req.cursor == 0 || !sameSelection)
+	{
+		rtabmap_.getGraph(poses, constraints, req.optimized, req.global);
 
-	rtabmap_.getGraph(
-			poses,
-			constraints,
-			req.optimized,
-			req.global,
-			&signatures,
+		bool useBbox = req.bbox_min.x < req.bbox_max.x && req.bbox_min.y < req.bbox_max.y && req.bbox_min.z < req.bbox_max.z;
+		for(std::map<int, Transform>::iterator iter=poses.begin(); iter!=poses.end();)
+		{
+			if((req.min_id > 0 && iter->first < req.min_id) ||
+			   (req.max_id > 0 && iter->first > req.max_id) ||
+			   (useBbox && (
+					   iter->second.x() < req.bbox_min.x || iter->second.x() > req.bbox_max.x ||
+					   iter->second.y() < req.bbox_min.y || iter->second.y() > req.bbox_max.y ||
+					   iter->second.z() < req.bbox_min.z || iter->second.z() > req.bbox_max.z)))
+			{
+				poses.erase(iter++);
+			}
+			else
+			{
+				++iter;
+			}
+		}
+		for(std::multimap<int, rtabmap::Link>::iterator iter=constraints.begin(); iter!=constraints.end();)
+		{
+			if(poses.find(iter->second.from()) == poses.end() || poses.find(iter->second.to()) == poses.end())
+			{
+				constraints.erase(iter++);
+			}
+			else
+			{
+				++iter;
+			}
+		}
+		mapDataChunkPagesRequest_ = req;
+		mapDataChunkPagesIds_.clear();
+		mapDataChunkPagesIds_.reserve(poses.size());
+		for(std::map<int, Transform>::iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+		{
+			mapDataChunkPagesIds_.push_back(iter->first);
+		}
+	}
+	res.total_nodes = mapDataChunkPagesIds_.size();
+
+	std::vector<int> ids(
+			std::upper_bound(mapDataChunkPagesIds_.begin(), mapDataChunkPagesIds_.end(), req.cursor),
+			mapDataChunkPagesIds_.end());
+
+	if(req.cursor == 0)
+	{
+		rtabmap_ros::mapDataToROS(poses, constraints, std::map<int, Signature>(), mapToOdom_, res.data);
+	}
+	else
+	{
+		setNoGraph(res.data.graph);
+	}
+	res.data.header.stamp = ros::Time::now();
+	res.data.header.frame_id = mapFrameId_;
+	res.data.graph.header = res.data.header;
+	res.next_cursor = 0;
+
+	if(req.stream)
+	{
+		mapDataChunksRequest_ = req;
+		mapDataChunksIds_ = std::list<int>(ids.begin(), ids.end());
+		if(!mapDataChunksTimer_.isValid())
+		{
+			// one page per event, so that sensor callbacks are processed between pages
+			mapDataChunksTimer_ = getNodeHandle().createTimer(ros::Duration(0.01), &CoreWrapper::publishMapDataChunk, this);
+		}
+		mapDataChunksTimer_.start();
+		return true;
+	}
+
+	if(req.page_size > 0 && (int)ids.size() > req.page_size)
+	{
+		ids.resize(req.page_size);
+		res.next_cursor = ids.back();
+	}
+	mapDataChunk(req, ids, res.data);
+
+	return true;
+}
+
+void CoreWrapper::mapDataChunk(
+		const rtabmap_ros::GetMapChunk::Request & req,
+		const std::vector<int> & ids,
+		rtabmap_ros::MapData & msg)
+{
+	loadNodesData(ids,
 			req.with_images,
 			req.with_scans,
 			req.with_user_data,
 			req.with_grids,
 			req.with_words,
-			req.with_global_descriptors);
+			req.with_global_descriptors,
+			msg.nodes);
+}
 
-	//RGB-D SLAM data
-	rtabmap_ros::mapDataToROS(poses,
-		constraints,
-		signatures,
-		mapToOdom_,
-		res.data);
+void CoreWrapper::publishMapDataChunk(const ros::TimerEvent &)
+{
+	if(mapDataChunksIds_.empty())
+	{
+		mapDataChunksTimer_.stop();
+		return;
+	}
 
-	res.data.header.stamp = ros::Time::now();
-	res.data.header.frame_id = mapFrameId_;
+	std::vector<int> ids;
+	while(!mapDataChunksIds_.empty() &&
+		  (mapDataChunksRequest_.page_size <= 0 || (int)ids.size() < mapDataChunksRequest_.page_size))
+	{
+		ids.push_back(mapDataChunksIds_.front());
+		mapDataChunksIds_.pop_front();
+	}
 
-	return true;
+	rtabmap_ros::MapDataPtr msg(new rtabmap_ros::MapData);
+	msg->header.stamp = ros::Time::now();
+	msg->header.frame_id = mapFrameId_;
+	msg->graph.header = msg->header;
+	setNoGraph(msg->graph); // the graph is in the service response
+	mapDataChunk(mapDataChunksRequest_, ids, *msg);
+	mapDataChunksPub_.publish(msg);
+	NODELET_DEBUG("rtabmap: Published map chunk of %d nodes (%d remaining).", (int)msg->nodes.size(), (int)mapDataChunksIds_.size());
 }
 
 bool CoreWrapper::getProjMapCallback(nav_msgs::GetMap::Request  &req, nav_msgs::GetMap::Response &res)
 {
-	if(parameters_.find(Parameters::kGridSensor()) != parameters_.end() &&
-		uStr2Int(parameters_.at(Parameters::kGridSensor()))==0)
+	readSnapshotMutex_.lock();
+	int gridSensor = readGridSensor_;
+	readSnapshotMutex_.unlock();
+	if(gridSensor==0)
 	{
 		NODELET_WARN("/get_proj_map service is deprecated! Call /get_grid_map service "
 					"instead with <param name=\"%s\" type=\"string\" value=\"1\"/>. "
@@ -3319,13 +4180,8 @@ bool CoreWrapper::getGridMapCallback(nav_msgs::GetMap::Request  &req, nav_msgs::
 
 bool CoreWrapper::getMapCallback(nav_msgs::GetMap::Request  &req, nav_msgs::GetMap::Response &res)
 {
-	// Make sure grid map cache is up to date (in case there is no subscriber on map topics)
-	std::map<int, Transform> poses = rtabmap_.getLocalOptimizedPoses();
-	mapsManager_.updateMapCaches(poses, rtabmap_.getMemory(), true, false);
-
-	// create the grid map
 	float xMin=0.0f, yMin=0.0f, gridCellSize = 0.05f;
-	cv::Mat pixels = mapsManager_.getGridMap(xMin, yMin, gridCellSize);
+	cv::Mat pixels = getGridMapSnapshot(false, xMin, yMin, gridCellSize);
 
 	if(!pixels.empty())
 	{
@@ -3360,13 +4216,8 @@ bool CoreWrapper::getMapCallback(nav_msgs::GetMap::Request  &req, nav_msgs::GetM
 
 bool CoreWrapper::getProbMapCallback(nav_msgs::GetMap::Request  &req, nav_msgs::GetMap::Response &res)
 {
-	// Make sure grid map cache is up to date (in case there is no subscriber on map topics)
-	std::map<int, Transform> poses = rtabmap_.getLocalOptimizedPoses();
-	mapsManager_.updateMapCaches(poses, rtabmap_.getMemory(), true, false);
-
-	// create the grid map
 	float xMin=0.0f, yMin=0.0f, gridCellSize = 0.05f;
-	cv::Mat pixels = mapsManager_.getGridProbMap(xMin, yMin, gridCellSize);
+	cv::Mat pixels = getGridMapSnapshot(true, xMin, yMin, gridCellSize);
 
 	if(!pixels.empty())
 	{
@@ -3399,14 +4250,42 @@ bool CoreWrapper::getProbMapCallback(nav_msgs::GetMap::Request  &req, nav_msgs::
 	return false;
 }
 
+// Grid map of the current read snapshot, assembled by the last map update.
+// Without read-only service threads, the grid map cache is updated here.
+cv::Mat CoreWrapper::getGridMapSnapshot(bool probabilistic, float & xMin, float & yMin, float & gridCellSize)
+{
+	if(readSpinner_ == 0)
+	{
+		// Make sure grid map cache is up to date (in case there is no subscriber on map topics)
+		std::map<int, Transform> poses = rtabmap_.getLocalOptimizedPoses();
+		boost::mutex::scoped_lock lock(mapsManagerMutex_);
+		mapsManager_.updateMapCaches(poses, rtabmap_.getMemory(), true, false);
+		if(probabilistic)
+		{
+			return mapsManager_.getGridProbMap(xMin, yMin, gridCellSize);
+		}
+		return mapsManager_.getGridMap(xMin, yMin, gridCellSize);
+	}
+
+	boost::shared_ptr<const ReadSnapshot> snapshot = getReadSnapshot();
+	xMin = snapshot->grid.xMin;
+	yMin = snapshot->grid.yMin;
+	gridCellSize = snapshot->grid.cellSize;
+	return probabilistic?snapshot->grid.probMap:snapshot->grid.map;
+}
+
 bool CoreWrapper::publishMapCallback(rtabmap_ros::PublishMap::Request& req, rtabmap_ros::PublishMap::Response& res)
 {
 	NODELET_INFO("rtabmap: Publishing map...");
 
 	ros::Time now = ros::Time::now();
 
+	mapsManagerMutex_.lock();
+	bool mapsHaveSubscribers = mapsManager_.hasSubscribers();
+	mapsManagerMutex_.unlock();
+
 	if(mapDataPub_.getNumSubscribers() ||
-	   (!req.graphOnly && mapsManager_.hasSubscribers()) ||
+	   (!req.graphOnly && mapsHaveSubscribers) ||
 	   (req.graphOnly && (labelsPub_.getNumSubscribers() || mapGraphPub_.getNumSubscribers() || mapPathPub_.getNumSubscribers())))
 	{
 		std::map<int, Transform> poses;
@@ -3430,11 +4309,17 @@ bool CoreWrapper::publishMapCallback(rtabmap_ros::PublishMap::Request& req, rtab
 			msg->header.stamp = now;
 			msg->header.frame_id = mapFrameId_;
 
-			rtabmap_ros::mapDataToROS(poses,
-				constraints,
+			rtabmap_ros::mapDataToROS(std::map<int, Transform>(),
+				std::multimap<int, Link>(),
 				signatures,
 				mapToOdom_,
 				*msg);
+			fillMapGraph(mapDataDeltaState_,
+				poses,
+				constraints,
+				mapToOdom_,
+				msg->graph,
+				true);
 
 			mapDataPub_.publish(msg);
 		}
@@ -3445,10 +4330,12 @@ bool CoreWrapper::publishMapCallback(rtabmap_ros::PublishMap::Request& req, rtab
 			msg->header.stamp = now;
 			msg->header.frame_id = mapFrameId_;
 
-			rtabmap_ros::mapGraphToROS(poses,
+			fillMapGraph(mapGraphDeltaState_,
+				poses,
 				constraints,
 				mapToOdom_,
-				*msg);
+				*msg,
+				true);
 
 			mapGraphPub_.publish(msg);
 		}
@@ -3503,6 +4390,7 @@ bool CoreWrapper::publishMapCallback(rtabmap_ros::PublishMap::Request& req, rtab
 
 		if(!req.graphOnly)
 		{
+			boost::mutex::scoped_lock lock(mapsManagerMutex_);
 			if(mapsManager_.hasSubscribers())
 			{
 				std::map<int, Transform> filteredPoses(poses.lower_bound(1), poses.end());
@@ -3639,6 +4527,7 @@ bool CoreWrapper::publishMapCallback(rtabmap_ros::PublishMap::Request& req, rtab
 		if(!req.graphOnly)
 		{
 			// this will cleanup the cache if there are no subscribers
+			boost::mutex::scoped_lock lock(mapsManagerMutex_);
 			mapsManager_.publishMaps(std::map<int, Transform>(), now, mapFrameId_);
 		}
 	}
@@ -3874,18 +4763,19 @@ bool CoreWrapper::setLabelCallback(rtabmap_ros::SetLabel::Request& req, rtabmap_
 			NODELET_ERROR("Could not set label \"%s\" to last node", req.node_label.c_str());
 		}
 	}
+	publishReadSnapshot(true);
 	return true;
 }
 
 bool CoreWrapper::listLabelsCallback(rtabmap_ros::ListLabels::Request& req, rtabmap_ros::ListLabels::Response& res)
 {
-	if(rtabmap_.getMemory())
-	{
-		std::map<int, std::string> labels = rtabmap_.getMemory()->getAllLabels();
-		res.ids = uKeys(labels);
-		res.labels = uValues(labels);
-		NODELET_INFO("List labels service: %d labels found.", (int)res.labels.size());
-	}
+	readSnapshotMutex_.lock();
+	boost::shared_ptr<const std::map<int, std::string> > labels = readLabels_;
+	readSnapshotMutex_.unlock();
+
+	res.ids = uKeys(*labels);
+	res.labels = uValues(*labels);
+	NODELET_INFO("List labels service: %d labels found.", (int)res.labels.size());
 	return true;
 }
 
@@ -3905,6 +4795,7 @@ bool CoreWrapper::removeLabelCallback(rtabmap_ros::RemoveLabel::Request& req, rt
 		else
 		{
 			NODELET_INFO("Removed label \"%s\".", req.label.c_str());
+			publishReadSnapshot(true);
 		}
 	}
 	return true;
@@ -3926,13 +4817,30 @@ bool CoreWrapper::getNodesInRadiusCallback(rtabmap_ros::GetNodesInRadius::Reques
 	ROS_INFO("Get nodes in radius (%f): node_id=%d pose=(%f,%f,%f)", req.radius, req.node_id, req.x, req.y, req.z);
 	std::map<int, Transform> poses;
 	std::map<int, float> dists;
-	if(req.node_id != 0 || (req.x == 0.0f && req.y == 0.0f && req.z == 0.0f))
+	boost::shared_ptr<const ReadSnapshot> snapshot = getReadSnapshot();
+	Transform pose;
+	if(req.node_id > 0)
 	{
-		poses = rtabmap_.getNodesInRadius(req.node_id, req.radius, req.k, &dists);
+		// Like Rtabmap::getNodesInRadius(), only the nodes of the
+		// local optimized graph are searched, which is in the snapshot.
+		std::map<int, Transform>::const_iterator iter = snapshot->poses.find(req.node_id);
+		if(iter != snapshot->poses.end())
+		{
+			pose = iter->second;
+		}
 	}
-	else
+	else if(req.node_id == 0)
 	{
-		poses = rtabmap_.getNodesInRadius(Transform(req.x, req.y, req.z, 0,0,0), req.radius, req.k, &dists);
+		pose = req.x == 0.0f && req.y == 0.0f && req.z == 0.0f?snapshot->lastLocalizationPose:Transform(req.x, req.y, req.z, 0,0,0);
+	}
+
+	if(!pose.isNull())
+	{
+		dists = graph::findNearestNodes(pose, snapshot->poses, req.radius, 0, req.k);
+		for(std::map<int, float>::iterator iter=dists.begin(); iter!=dists.end(); ++iter)
+		{
+			poses.insert(*snapshot->poses.find(iter->first));
+		}
 	}
 
 	//Optimized graph
@@ -3954,6 +4862,119 @@ bool CoreWrapper::getNodesInRadiusCallback(rtabmap_ros::GetNodesInRadius::Reques
 	return true;
 }
 
+// Should be called from the processing queue after rtabmap_'s graph changed.
+// The read-only services keep using the previous snapshot until it is swapped.
+void CoreWrapper::publishReadSnapshot(bool labelsChanged)
+{
+	boost::shared_ptr<ReadSnapshot> snapshot(new ReadSnapshot);
+	snapshot->poses = rtabmap_.getLocalOptimizedPoses();
+	snapshot->constraints = rtabmap_.getLocalConstraints();
+	snapshot->lastLocalizationPose = rtabmap_.getLastLocalizationPose();
+
+	boost::shared_ptr<std::map<int, std::string> > labels;
+	if(labelsChanged)
+	{
+		labels.reset(new std::map<int, std::string>);
+		if(rtabmap_.getMemory())
+		{
+			*labels = rtabmap_.getMemory()->getAllLabels();
+		}
+	}
+	int gridSensor = -1;
+	if(parameters_.find(Parameters::kGridSensor()) != parameters_.end())
+	{
+		gridSensor = uStr2Int(parameters_.at(Parameters::kGridSensor()));
+	}
+
+	boost::mutex::scoped_lock lock(readSnapshotMutex_);
+	snapshot->grid = readSnapshot_->grid;
+	readSnapshot_ = snapshot;
+	if(labels.get())
+	{
+		readLabels_ = labels;
+	}
+	readGridSensor_ = gridSensor;
+}
+
+// mapsManagerMutex_ should be locked. Called after the map caches are
+// updated: if the grid map changed, it is copied in the read snapshot.
+void CoreWrapper::updateReadGrid(bool force)
+{
+	if(!mapsManager_.isGridRequired() || (!force && !mapsManager_.isGridUpdated()))
+	{
+		return;
+	}
+	ReadGrid grid;
+	grid.map = mapsManager_.getGridMap(grid.xMin, grid.yMin, grid.cellSize);
+	grid.probMap = mapsManager_.getGridProbMap(grid.xMin, grid.yMin, grid.cellSize);
+
+	// the map update thread doesn't change the graph, the other fields are kept
+	boost::mutex::scoped_lock lock(readSnapshotMutex_);
+	boost::shared_ptr<ReadSnapshot> snapshot(new ReadSnapshot(*readSnapshot_));
+	snapshot->grid = grid;
+	readSnapshot_ = snapshot;
+}
+
+boost::shared_ptr<const CoreWrapper::ReadSnapshot> CoreWrapper::getReadSnapshot()
+{
+	boost::mutex::scoped_lock lock(readSnapshotMutex_);
+	return readSnapshot_;
+}
+
+// Call done on the read callback queue
+class ProcessingQueueCall : public ros::CallbackInterface
+{
+public:
+	ProcessingQueueCall(const boost::function<void()> & function) :
+		function_(function),
+		done_(false)
+	{}
+	virtual CallResult call()
+	{
+		function_();
+		boost::mutex::scoped_lock lock(mutex_);
+		done_ = true;
+		condition_.notify_all();
+		return Success;
+	}
+	bool wait(const boost::atomic<bool> & running)
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		while(!done_ && running && ros::ok())
+		{
+			condition_.timed_wait(lock, boost::posix_time::milliseconds(100));
+		}
+		return done_;
+	}
+private:
+	boost::function<void()> function_;
+	bool done_;
+	boost::mutex mutex_;
+	boost::condition_variable condition_;
+};
+
+// Run a function accessing rtabmap_ from a read-only service, the read
+// thread waits until the processing queue has called it.
+bool CoreWrapper::callOnProcessingQueue(const boost::function<void()> & function)
+{
+	if(readSpinner_ == 0)
+	{
+		// read-only services are already on the processing queue
+		function();
+		return true;
+	}
+	boost::shared_ptr<ProcessingQueueCall> call(new ProcessingQueueCall(function));
+	getNodeHandle().getCallbackQueue()->addCallback(call, (uint64_t)call.get());
+	if(!call->wait(readSpinnerRunning_))
+	{
+		// The function refers to the caller's stack: remove it from
+		// the queue, this waits for the end of the call if it has started.
+		getNodeHandle().getCallbackQueue()->removeByID((uint64_t)call.get());
+		return false;
+	}
+	return true;
+}
+
 void CoreWrapper::publishStats(const ros::Time & stamp)
 {
 	UDEBUG("Publishing stats...");
@@ -3982,6 +5003,7 @@ void CoreWrapper::publishStats(const ros::Time & stamp)
 			signatures.insert(std::make_pair(stats.getLastSignatureData().id(), stats.getLastSignatureData()));
 		}
 
+		republishMutex_.lock();
 		if(nodesToRepublish_.size() && !rtabmap_.getLastLocalizationPose().isNull())
 		{
 			// Republish data from closest nodes of the current localization
@@ -4006,6 +5028,7 @@ void CoreWrapper::publishStats(const ros::Time & stamp)
 					{
 						if(ids.find(*iter) == ids.end())
 						{
+							republishPrefetched_.erase(*iter);
 							iter = nodesToRepublish_.erase(iter);
 						}
 						else
@@ -4019,7 +5042,20 @@ void CoreWrapper::publishStats(const ros::Time & stamp)
 				std::stringstream stream;
 				for(std::multimap<int, int>::iterator iter=missingIds.begin(); iter!=missingIds.end() && loaded<maxNodesRepublished_; ++iter)
 				{
-					signatures.insert(std::make_pair(iter->second, rtabmap_.getMemory()->getNodeData(iter->second, true, true, true, true)));
+					std::map<int, SensorData>::iterator jter = republishPrefetched_.find(iter->second);
+					if(jter != republishPrefetched_.end() && jter->second.isValid())
+					{
+						signatures.insert(std::make_pair(iter->second, Signature(jter->second)));
+					}
+					else
+					{
+						// not prefetched or not in the database yet
+						signatures.insert(std::make_pair(iter->second, rtabmap_.getMemory()->getNodeData(iter->second, true, true, true, true)));
+					}
+					if(jter != republishPrefetched_.end())
+					{
+						republishPrefetched_.erase(jter);
+					}
 					nodesToRepublish_.erase(iter->second);
 					++loaded;
 					stream << iter->second << " ";
@@ -4030,15 +5066,27 @@ void CoreWrapper::publishStats(const ros::Time & stamp)
 							stream.str().c_str(),
 							republishNodeDataSub_.getTopic().c_str(),
 							maxNodesRepublished_);
+					if(!nodesToRepublish_.empty())
+					{
+						// prefetch the next ones
+						republishPrefetchTimer_.start();
+					}
 				}
 			}
 		}
+		republishMutex_.unlock();
 		rtabmap_ros::mapDataToROS(
-			stats.poses(),
-			stats.constraints(),
+			std::map<int, Transform>(),
+			std::multimap<int, Link>(),
 			signatures,
 			stats.mapCorrection(),
 			*msg);
+		fillMapGraph(
+			mapDataDeltaState_,
+			stats.poses(),
+			stats.constraints(),
+			stats.mapCorrection(),
+			msg->graph);
 
 		mapDataPub_.publish(msg);
 	}
@@ -4049,7 +5097,8 @@ void CoreWrapper::publishStats(const ros::Time & stamp)
 		msg->header.stamp = stamp;
 		msg->header.frame_id = mapFrameId_;
 
-		rtabmap_ros::mapGraphToROS(
+		fillMapGraph(
+			mapGraphDeltaState_,
 			stats.poses(),
 			stats.constraints(),
 			stats.mapCorrection(),
@@ -4490,6 +5539,7 @@ bool CoreWrapper::octomapBinaryCallback(
 		poses = filterNodesToAssemble(poses, poses.rbegin()->second);
 	}
 
+	boost::mutex::scoped_lock lock(mapsManagerMutex_);
 	mapsManager_.updateMapCaches(poses, rtabmap_.getMemory(), false, true);
 
 	const rtabmap::OctoMap * octomap = mapsManager_.getOctomap();
@@ -4511,6 +5561,7 @@ bool CoreWrapper::octomapFullCallback(
 		poses = filterNodesToAssemble(poses, poses.rbegin()->second);
 	}
 
+	boost::mutex::scoped_lock lock(mapsManagerMutex_);
 	mapsManager_.updateMapCaches(poses, rtabmap_.getMemory(), false, true);
 
 	const rtabmap::OctoMap * octomap = mapsManager_.getOctomap();
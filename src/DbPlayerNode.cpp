@@ -50,7 +50,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/util3d.h>
 #include <rtabmap/core/DBReader.h>
 #include <rtabmap/core/OdometryEvent.h>
+#include <boost/thread.hpp>
 #include <cmath>
+#include <deque>
+#include <map>
 
 #ifndef _WIN32
 #include <sys/ioctl.h>
@@ -121,6 +124,374 @@ bool resumeCallback(std_srvs::Empty::Request&, std_srvs::Empty::Response&)
 	return true;
 }
 
+struct PlayerConfig
+{
+	std::string frameId;
+	std::string odomFrameId;
+	std::string cameraFrameId;
+	std::string scanFrameId;
+	double scanAngleMin;
+	double scanAngleMax;
+	double scanAngleIncrement;
+	double scanRangeMin;
+	double scanRangeMax;
+};
+
+// A frame read from the database
+struct Frame
+{
+	Frame() : seq(0) {}
+	int seq;
+	rtabmap::SensorData data;
+	rtabmap::CameraInfo cameraInfo;
+};
+
+// Messages of a frame, ready to be published
+struct Packet
+{
+	Packet() : seq(0), type(-1) {}
+	int seq;
+	rtabmap::OdometryEvent odom;
+	ros::Time time;
+	int type; // -1=image only, 0=rgb-d, 1=stereo
+	sensor_msgs::CameraInfo camInfoA; //rgb or left
+	sensor_msgs::CameraInfo camInfoB; //depth or right
+	sensor_msgs::ImagePtr image;
+	sensor_msgs::ImagePtr depth;
+	sensor_msgs::ImagePtr right;
+	sensor_msgs::LaserScanPtr scan;
+	sensor_msgs::PointCloud2Ptr scanCloud;
+	bool scan2d;
+	bool scanAngleIncrementSet;
+};
+
+// Decompress the data of the frame and create its messages
+void decodeFrame(const PlayerConfig & config, Frame & frame, Packet & packet)
+{
+	frame.data.uncompressData();
+
+	rtabmap::OdometryInfo odomInfo;
+	odomInfo.reg.covariance = frame.cameraInfo.odomCovariance;
+	packet.seq = frame.seq;
+	packet.odom = rtabmap::OdometryEvent(frame.data, frame.cameraInfo.odomPose, odomInfo);
+	const rtabmap::OdometryEvent & odom = packet.odom;
+	ros::Time time(odom.data().stamp());
+	packet.time = time;
+
+	sensor_msgs::CameraInfo & camInfoA = packet.camInfoA;
+	sensor_msgs::CameraInfo & camInfoB = packet.camInfoB;
+
+	camInfoA.K.assign(0);
+	camInfoA.K[0] = camInfoA.K[4] = camInfoA.K[8] = 1;
+	camInfoA.R.assign(0);
+	camInfoA.R[0] = camInfoA.R[4] = camInfoA.R[8] = 1;
+	camInfoA.P.assign(0);
+	camInfoA.P[10] = 1;
+
+	camInfoA.header.frame_id = config.cameraFrameId;
+	camInfoA.header.stamp = time;
+
+	camInfoB = camInfoA;
+
+	int type = -1;
+	if(!odom.data().depthRaw().empty() && (odom.data().depthRaw().type() == CV_32FC1 || odom.data().depthRaw().type() == CV_16UC1))
+	{
+		if(odom.data().cameraModels().size() > 1)
+		{
+			ROS_WARN("Multi-cameras detected in database but this node cannot send multi-images yet...");
+		}
+		else
+		{
+			//depth
+			if(odom.data().cameraModels().size())
+			{
+				camInfoA.D.resize(5,0);
+
+				camInfoA.P[0] = odom.data().cameraModels()[0].fx();
+				camInfoA.K[0] = odom.data().cameraModels()[0].fx();
+				camInfoA.P[5] = odom.data().cameraModels()[0].fy();
+				camInfoA.K[4] = odom.data().cameraModels()[0].fy();
+				camInfoA.P[2] = odom.data().cameraModels()[0].cx();
+				camInfoA.K[2] = odom.data().cameraModels()[0].cx();
+				camInfoA.P[6] = odom.data().cameraModels()[0].cy();
+				camInfoA.K[5] = odom.data().cameraModels()[0].cy();
+
+				camInfoB = camInfoA;
+			}
+
+			type=0;
+		}
+	}
+	else if(!odom.data().rightRaw().empty() && odom.data().rightRaw().type() == CV_8U)
+	{
+		if(odom.data().stereoCameraModels().size() > 1)
+		{
+			ROS_WARN("Multi-cameras detected in database but this node cannot send multi-images yet...");
+		}
+		else
+		{
+			//stereo
+			if(odom.data().stereoCameraModels()[0].isValidForProjection())
+			{
+				camInfoA.D.resize(8,0);
+
+				camInfoA.P[0] = odom.data().stereoCameraModels()[0].left().fx();
+				camInfoA.K[0] = odom.data().stereoCameraModels()[0].left().fx();
+				camInfoA.P[5] = odom.data().stereoCameraModels()[0].left().fy();
+				camInfoA.K[4] = odom.data().stereoCameraModels()[0].left().fy();
+				camInfoA.P[2] = odom.data().stereoCameraModels()[0].left().cx();
+				camInfoA.K[2] = odom.data().stereoCameraModels()[0].left().cx();
+				camInfoA.P[6] = odom.data().stereoCameraModels()[0].left().cy();
+				camInfoA.K[5] = odom.data().stereoCameraModels()[0].left().cy();
+
+				camInfoB = camInfoA;
+				camInfoB.P[3] = odom.data().stereoCameraModels()[0].right().Tx(); // Right_Tx = -baseline*fx
+			}
+
+			type=1;
+		}
+	}
+	packet.type = type;
+
+	camInfoA.height = odom.data().imageRaw().rows;
+	camInfoA.width = odom.data().imageRaw().cols;
+	camInfoB.height = odom.data().depthOrRightRaw().rows;
+	camInfoB.width = odom.data().depthOrRightRaw().cols;
+
+	if(!odom.data().imageRaw().empty())
+	{
+		cv_bridge::CvImage img;
+		if(odom.data().imageRaw().channels() == 1)
+		{
+			img.encoding = sensor_msgs::image_encodings::MONO8;
+		}
+		else
+		{
+			img.encoding = sensor_msgs::image_encodings::BGR8;
+		}
+		img.image = odom.data().imageRaw();
+		packet.image = img.toImageMsg();
+		packet.image->header.frame_id = config.cameraFrameId;
+		packet.image->header.stamp = time;
+	}
+
+	if(!odom.data().depthRaw().empty() && type==0)
+	{
+		cv_bridge::CvImage img;
+		if(odom.data().depthRaw().type() == CV_32FC1)
+		{
+			img.encoding = sensor_msgs::image_encodings::TYPE_32FC1;
+		}
+		else
+		{
+			img.encoding = sensor_msgs::image_encodings::TYPE_16UC1;
+		}
+		img.image = odom.data().depthRaw();
+		packet.depth = img.toImageMsg();
+		packet.depth->header.frame_id = config.cameraFrameId;
+		packet.depth->header.stamp = time;
+	}
+
+	if(!odom.data().rightRaw().empty() && type==1)
+	{
+		cv_bridge::CvImage img;
+		img.encoding = sensor_msgs::image_encodings::MONO8;
+		img.image = odom.data().rightRaw();
+		packet.right = img.toImageMsg();
+		packet.right->header.frame_id = config.cameraFrameId;
+		packet.right->header.stamp = time;
+	}
+
+	packet.scan2d = false;
+	packet.scanAngleIncrementSet = false;
+	if(!odom.data().laserScanRaw().isEmpty())
+	{
+		packet.scan2d = odom.data().laserScanRaw().is2d();
+		packet.scanAngleIncrementSet = odom.data().laserScanRaw().angleIncrement() > 0.0f;
+		if(packet.scan2d)
+		{
+			//inspired from pointcloud_to_laserscan package
+			packet.scan.reset(new sensor_msgs::LaserScan);
+			sensor_msgs::LaserScan & msg = *packet.scan;
+			msg.header.frame_id = config.scanFrameId;
+			msg.header.stamp = time;
+
+			msg.angle_min = config.scanAngleMin;
+			msg.angle_max = config.scanAngleMax;
+			msg.angle_increment = config.scanAngleIncrement;
+			msg.time_increment = 0.0;
+			msg.scan_time = 0;
+			msg.range_min = config.scanRangeMin;
+			msg.range_max = config.scanRangeMax;
+			if(odom.data().laserScanRaw().angleIncrement() > 0.0f)
+			{
+				msg.angle_min = odom.data().laserScanRaw().angleMin();
+				msg.angle_max = odom.data().laserScanRaw().angleMax();
+				msg.angle_increment = odom.data().laserScanRaw().angleIncrement();
+				msg.range_min = odom.data().laserScanRaw().rangeMin();
+				msg.range_max = odom.data().laserScanRaw().rangeMax();
+			}
+
+			uint32_t rangesSize = std::ceil((msg.angle_max - msg.angle_min) / msg.angle_increment);
+			msg.ranges.assign(rangesSize, 0.0);
+
+			const cv::Mat & scan = odom.data().laserScanRaw().data();
+			for (int i=0; i<scan.cols; ++i)
+			{
+				const float * ptr = scan.ptr<float>(0,i);
+				double range = hypot(ptr[0], ptr[1]);
+				if (range >= msg.range_min && range <=msg.range_max)
+				{
+					double angle = atan2(ptr[1], ptr[0]);
+					if (angle >= msg.angle_min && angle <= msg.angle_max)
+					{
+						int index = (angle - msg.angle_min) / msg.angle_increment;
+						if (index>=0 && index<rangesSize && (range < msg.ranges[index] || msg.ranges[index]==0))
+						{
+							msg.ranges[index] = range;
+						}
+					}
+				}
+			}
+		}
+		else
+		{
+			packet.scanCloud.reset(new sensor_msgs::PointCloud2);
+			pcl_conversions::moveFromPCL(*rtabmap::util3d::laserScanToPointCloud2(odom.data().laserScanRaw()), *packet.scanCloud);
+			packet.scanCloud->header.frame_id = config.scanFrameId;
+			packet.scanCloud->header.stamp = time;
+		}
+	}
+}
+
+// Playback pipeline: the reader thread reads frames ahead, the decoders
+// decompress them and create their messages, and the main thread publishes
+// them in order at their deadline.
+class PlayerPipeline
+{
+public:
+	PlayerPipeline(rtabmap::DBReader & reader, const PlayerConfig & config, int prefetch) :
+		reader_(reader),
+		config_(config),
+		prefetch_(prefetch),
+		inFlight_(0),
+		stopped_(false)
+	{}
+	~PlayerPipeline()
+	{
+		stop();
+	}
+
+	void start(int decodeThreads)
+	{
+		threads_.create_thread(boost::bind(&PlayerPipeline::readLoop, this));
+		for(int i=0; i<decodeThreads; ++i)
+		{
+			threads_.create_thread(boost::bind(&PlayerPipeline::decodeLoop, this));
+		}
+	}
+
+	void stop()
+	{
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			stopped_ = true;
+			condition_.notify_all();
+		}
+		threads_.join_all();
+	}
+
+	// Wait for the decoded frame seq, return false at the end of the database
+	bool take(int seq, Packet & packet)
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		std::map<int, boost::shared_ptr<Packet> >::iterator iter;
+		while(!stopped_ && (iter=decoded_.find(seq)) == decoded_.end())
+		{
+			condition_.wait(lock);
+		}
+		if(stopped_)
+		{
+			return false;
+		}
+		packet = *iter->second;
+		decoded_.erase(iter);
+		--inFlight_;
+		condition_.notify_all();
+		return packet.odom.data().id() != 0;
+	}
+
+private:
+	void readLoop()
+	{
+		for(int seq=0; ; ++seq)
+		{
+			{
+				boost::mutex::scoped_lock lock(mutex_);
+				while(!stopped_ && inFlight_ >= prefetch_)
+				{
+					condition_.wait(lock);
+				}
+				if(stopped_)
+				{
+					return;
+				}
+			}
+			boost::shared_ptr<Frame> frame(new Frame);
+			frame->seq = seq;
+			frame->data = reader_.takeImage(&frame->cameraInfo);
+
+			boost::mutex::scoped_lock lock(mutex_);
+			read_.push_back(frame);
+			++inFlight_;
+			condition_.notify_all();
+			if(frame->data.id() == 0)
+			{
+				// end of the database
+				return;
+			}
+		}
+	}
+
+	void decodeLoop()
+	{
+		while(true)
+		{
+			boost::shared_ptr<Frame> frame;
+			{
+				boost::mutex::scoped_lock lock(mutex_);
+				while(!stopped_ && read_.empty())
+				{
+					condition_.wait(lock);
+				}
+				if(stopped_)
+				{
+					return;
+				}
+				frame = read_.front();
+				read_.pop_front();
+			}
+			boost::shared_ptr<Packet> packet(new Packet);
+			decodeFrame(config_, *frame, *packet);
+
+			boost::mutex::scoped_lock lock(mutex_);
+			decoded_.insert(std::make_pair(packet->seq, packet));
+			condition_.notify_all();
+		}
+	}
+
+	rtabmap::DBReader & reader_;
+	PlayerConfig config_;
+	int prefetch_;
+	int inFlight_; // frames read but not published yet
+	bool stopped_;
+	boost::mutex mutex_;
+	boost::condition_variable condition_;
+	boost::thread_group threads_;
+	std::deque<boost::shared_ptr<Frame> > read_;
+	std::map<int, boost::shared_ptr<Packet> > decoded_; // by seq
+};
+
 int main(int argc, char** argv)
 {
 	ros::init(argc, argv, "data_player");
@@ -141,41 +512,53 @@ int main(int argc, char** argv)
 	ros::NodeHandle nh;
 	ros::NodeHandle pnh("~");
 
-	std::string frameId = "base_link";
-	std::string odomFrameId = "odom";
-	std::string cameraFrameId = "camera_optical_link";
-	std::string scanFrameId = "base_laser_link";
+	PlayerConfig config;
+	config.frameId = "base_link";
+	config.odomFrameId = "odom";
+	config.cameraFrameId = "camera_optical_link";
+	config.scanFrameId = "base_laser_link";
 	double rate = 1.0f;
 	std::string databasePath = "";
 	bool publishTf = true;
 	int startId = 0;
 	bool useDbStamps = true;
-
-	pnh.param("frame_id", frameId, frameId);
-	pnh.param("odom_frame_id", odomFrameId, odomFrameId);
-	pnh.param("camera_frame_id", cameraFrameId, cameraFrameId);
-	pnh.param("scan_frame_id", scanFrameId, scanFrameId);
-	pnh.param("rate", rate, rate); // Ratio of the database stamps
+	int prefetch = 10;
+	int decodeThreads = 2;
+
+	pnh.param("frame_id", config.frameId, config.frameId);
+	pnh.param("odom_frame_id", config.odomFrameId, config.odomFrameId);
+	pnh.param("camera_frame_id", config.cameraFrameId, config.cameraFrameId);
+	pnh.param("scan_frame_id", config.scanFrameId, config.scanFrameId);
+	pnh.param("rate", rate, rate); // Ratio of the database stamps, 0=as fast as possible
 	pnh.param("database", databasePath, databasePath);
 	pnh.param("publish_tf", publishTf, publishTf);
 	pnh.param("start_id", startId, startId);
+	pnh.param("prefetch", prefetch, prefetch); // frames read and decoded ahead
+	pnh.param("decode_threads", decodeThreads, decodeThreads);
 
 	// A general 360 lidar with 0.5 deg increment
-	double scanAngleMin, scanAngleMax, scanAngleIncrement, scanRangeMin, scanRangeMax;
-	pnh.param<double>("scan_angle_min", scanAngleMin, -M_PI);
-	pnh.param<double>("scan_angle_max", scanAngleMax, M_PI);
-	pnh.param<double>("scan_angle_increment", scanAngleIncrement, M_PI / 720.0);
-	pnh.param<double>("scan_range_min", scanRangeMin, 0.0);
-	pnh.param<double>("scan_range_max", scanRangeMax, 60);
-
-	ROS_INFO("frame_id = %s", frameId.c_str());
-	ROS_INFO("odom_frame_id = %s", odomFrameId.c_str());
-	ROS_INFO("camera_frame_id = %s", cameraFrameId.c_str());
-	ROS_INFO("scan_frame_id = %s", scanFrameId.c_str());
+	pnh.param<double>("scan_angle_min", config.scanAngleMin, -M_PI);
+	pnh.param<double>("scan_angle_max", config.scanAngleMax, M_PI);
+	pnh.param<double>("scan_angle_increment", config.scanAngleIncrement, M_PI / 720.0);
+	pnh.param<double>("scan_range_min", config.scanRangeMin, 0.0);
+	pnh.param<double>("scan_range_max", config.scanRangeMax, 60);
+
+	prefetch = std::max(1, prefetch);
+	decodeThreads = std::max(1, decodeThreads);
+	// If another node publishes the clock, deadlines are on the simulated time
+	bool simDeadlines = ros::Time::isSimTime() && !publishClock;
+
+	ROS_INFO("frame_id = %s", config.frameId.c_str());
+	ROS_INFO("odom_frame_id = %s", config.odomFrameId.c_str());
+	ROS_INFO("camera_frame_id = %s", config.cameraFrameId.c_str());
+	ROS_INFO("scan_frame_id = %s", config.scanFrameId.c_str());
 	ROS_INFO("rate = %f", rate);
 	ROS_INFO("publish_tf = %s", publishTf?"true":"false");
 	ROS_INFO("start_id = %d", startId);
+	ROS_INFO("prefetch = %d", prefetch);
+	ROS_INFO("decode_threads = %d", decodeThreads);
 	ROS_INFO("Publish clock (--clock): %s", publishClock?"true":"false");
+	ROS_INFO("Deadlines on: %s", rate<=0.0?"none (as fast as possible)":simDeadlines?"sim time":"wall time");
 
 	if(databasePath.empty())
 	{
@@ -189,7 +572,8 @@ int main(int argc, char** argv)
 	}
 	ROS_INFO("database = %s", databasePath.c_str());
 
-	rtabmap::DBReader reader(databasePath, -rate, false, false, false, startId);
+	// Frames are read as fast as possible, the rate is applied when publishing
+	rtabmap::DBReader reader(databasePath, 0.0f, false, false, false, startId);
 	if(!reader.init())
 	{
 		ROS_ERROR("Cannot open database \"%s\".", databasePath.c_str());
@@ -222,137 +606,112 @@ int main(int argc, char** argv)
 		clockPub = nh.advertise<rosgraph_msgs::Clock>("/clock", 1);
 	}
 
-	UTimer timer;
-	rtabmap::CameraInfo cameraInfo;
-	rtabmap::SensorData data = reader.takeImage(&cameraInfo);
-	rtabmap::OdometryInfo odomInfo;
-	odomInfo.reg.covariance = cameraInfo.odomCovariance;
-	rtabmap::OdometryEvent odom(data, cameraInfo.odomPose, odomInfo);
-	double acquisitionTime = timer.ticks();
-	while(ros::ok() && odom.data().id())
-	{
-		ROS_INFO("Reading sensor data %d...", odom.data().id());
-
-		ros::Time time(odom.data().stamp());
+	PlayerPipeline pipeline(reader, config, prefetch);
+	pipeline.start(decodeThreads);
 
-		if(publishClock)
-		{
-			rosgraph_msgs::Clock msg;
-			msg.clock = time;
-			clockPub.publish(msg);
-		}
-
-		sensor_msgs::CameraInfo camInfoA; //rgb or left
-		sensor_msgs::CameraInfo camInfoB; //depth or right
+	// Deadline of a frame = start + (stamp - first stamp) / rate
+	double firstStamp = 0.0;
+	ros::WallTime wallStart;
+	ros::Time simStart;
+	ros::WallDuration pausedDuration(0);
 
-		camInfoA.K.assign(0);
-		camInfoA.K[0] = camInfoA.K[4] = camInfoA.K[8] = 1;
-		camInfoA.R.assign(0);
-		camInfoA.R[0] = camInfoA.R[4] = camInfoA.R[8] = 1;
-		camInfoA.P.assign(0);
-		camInfoA.P[10] = 1;
+	// lateness stats (ms)
+	int frames = 0;
+	int lateFrames = 0;
+	double latenessSum = 0.0;
+	double latenessMax = 0.0;
+	ros::WallTime playStart = ros::WallTime::now();
 
-		camInfoA.header.frame_id = cameraFrameId;
-		camInfoA.header.stamp = time;
-
-		camInfoB = camInfoA;
+	Packet packet;
+	for(int seq=0; ros::ok() && pipeline.take(seq, packet); ++seq)
+	{
+		const rtabmap::OdometryEvent & odom = packet.odom;
+		const ros::Time & time = packet.time;
+		int type = packet.type;
 
-		int type = -1;
-		if(!odom.data().depthRaw().empty() && (odom.data().depthRaw().type() == CV_32FC1 || odom.data().depthRaw().type() == CV_16UC1))
+		if(rate > 0.0)
 		{
-			if(odom.data().cameraModels().size() > 1)
+			if(seq == 0)
+			{
+				firstStamp = odom.data().stamp();
+				wallStart = ros::WallTime::now();
+				simStart = simDeadlines?ros::Time::now():ros::Time(0);
+			}
+			double offset = (odom.data().stamp() - firstStamp) / rate;
+			double lateness;
+			if(simDeadlines)
 			{
-				ROS_WARN("Multi-cameras detected in database but this node cannot send multi-images yet...");
+				ros::Time deadline = simStart + ros::Duration(offset);
+				ros::Time::sleepUntil(deadline);
+				lateness = (ros::Time::now() - deadline).toSec()*1000.0;
 			}
 			else
 			{
-				//depth
-				if(odom.data().cameraModels().size())
+				ros::WallTime deadline = wallStart + pausedDuration + ros::WallDuration(offset);
+				ros::WallTime now = ros::WallTime::now();
+				if(deadline > now)
 				{
-					camInfoA.D.resize(5,0);
-
-					camInfoA.P[0] = odom.data().cameraModels()[0].fx();
-					camInfoA.K[0] = odom.data().cameraModels()[0].fx();
-					camInfoA.P[5] = odom.data().cameraModels()[0].fy();
-					camInfoA.K[4] = odom.data().cameraModels()[0].fy();
-					camInfoA.P[2] = odom.data().cameraModels()[0].cx();
-					camInfoA.K[2] = odom.data().cameraModels()[0].cx();
-					camInfoA.P[6] = odom.data().cameraModels()[0].cy();
-					camInfoA.K[5] = odom.data().cameraModels()[0].cy();
-
-					camInfoB = camInfoA;
+					(deadline - now).sleep();
 				}
-
-				type=0;
-
-				if(rgbPub.getTopic().empty()) rgbPub = it.advertise("rgb/image", 1);
-				if(depthPub.getTopic().empty()) depthPub = it.advertise("depth_registered/image", 1);
-				if(rgbCamInfoPub.getTopic().empty()) rgbCamInfoPub = nh.advertise<sensor_msgs::CameraInfo>("rgb/camera_info", 1);
-				if(depthCamInfoPub.getTopic().empty()) depthCamInfoPub = nh.advertise<sensor_msgs::CameraInfo>("depth_registered/camera_info", 1);
+				lateness = (ros::WallTime::now() - deadline).toSec()*1000.0;
 			}
-		}
-		else if(!odom.data().rightRaw().empty() && odom.data().rightRaw().type() == CV_8U)
-		{
-			if(odom.data().stereoCameraModels().size() > 1)
+			latenessSum += lateness;
+			latenessMax = std::max(latenessMax, lateness);
+			if(lateness > 10.0)
 			{
-				ROS_WARN("Multi-cameras detected in database but this node cannot send multi-images yet...");
+				++lateFrames;
 			}
-			else
-			{
-				//stereo
-				if(odom.data().stereoCameraModels()[0].isValidForProjection())
-				{
-					camInfoA.D.resize(8,0);
-
-					camInfoA.P[0] = odom.data().stereoCameraModels()[0].left().fx();
-					camInfoA.K[0] = odom.data().stereoCameraModels()[0].left().fx();
-					camInfoA.P[5] = odom.data().stereoCameraModels()[0].left().fy();
-					camInfoA.K[4] = odom.data().stereoCameraModels()[0].left().fy();
-					camInfoA.P[2] = odom.data().stereoCameraModels()[0].left().cx();
-					camInfoA.K[2] = odom.data().stereoCameraModels()[0].left().cx();
-					camInfoA.P[6] = odom.data().stereoCameraModels()[0].left().cy();
-					camInfoA.K[5] = odom.data().stereoCameraModels()[0].left().cy();
-
-					camInfoB = camInfoA;
-					camInfoB.P[3] = odom.data().stereoCameraModels()[0].right().Tx(); // Right_Tx = -baseline*fx
-				}
-
-				type=1;
+			ROS_INFO("Reading sensor data %d... (late %.1f ms)", odom.data().id(), lateness);
+		}
+		else
+		{
+			ROS_INFO("Reading sensor data %d...", odom.data().id());
+		}
+		++frames;
 
-				if(leftPub.getTopic().empty()) leftPub = it.advertise("left/image", 1);
-				if(rightPub.getTopic().empty()) rightPub = it.advertise("right/image", 1);
-				if(leftCamInfoPub.getTopic().empty()) leftCamInfoPub = nh.advertise<sensor_msgs::CameraInfo>("left/camera_info", 1);
-				if(rightCamInfoPub.getTopic().empty()) rightCamInfoPub = nh.advertise<sensor_msgs::CameraInfo>("right/camera_info", 1);
-			}
+		if(publishClock)
+		{
+			rosgraph_msgs::Clock msg;
+			msg.clock = time;
+			clockPub.publish(msg);
+		}
 
+		if(type == 0)
+		{
+			if(rgbPub.getTopic().empty()) rgbPub = it.advertise("rgb/image", 1);
+			if(depthPub.getTopic().empty()) depthPub = it.advertise("depth_registered/image", 1);
+			if(rgbCamInfoPub.getTopic().empty()) rgbCamInfoPub = nh.advertise<sensor_msgs::CameraInfo>("rgb/camera_info", 1);
+			if(depthCamInfoPub.getTopic().empty()) depthCamInfoPub = nh.advertise<sensor_msgs::CameraInfo>("depth_registered/camera_info", 1);
 		}
-		else
+		else if(type == 1)
+		{
+			if(leftPub.getTopic().empty()) leftPub = it.advertise("left/image", 1);
+			if(rightPub.getTopic().empty()) rightPub = it.advertise("right/image", 1);
+			if(leftCamInfoPub.getTopic().empty()) leftCamInfoPub = nh.advertise<sensor_msgs::CameraInfo>("left/camera_info", 1);
+			if(rightCamInfoPub.getTopic().empty()) rightCamInfoPub = nh.advertise<sensor_msgs::CameraInfo>("right/camera_info", 1);
+		}
+		else if(odom.data().depthRaw().empty() && odom.data().rightRaw().empty())
 		{
 			if(imagePub.getTopic().empty()) imagePub = it.advertise("image", 1);
 		}
 
-		camInfoA.height = odom.data().imageRaw().rows;
-		camInfoA.width = odom.data().imageRaw().cols;
-		camInfoB.height = odom.data().depthOrRightRaw().rows;
-		camInfoB.width = odom.data().depthOrRightRaw().cols;
-
 		if(!odom.data().laserScanRaw().isEmpty())
 		{
-			if(scanPub.getTopic().empty() && odom.data().laserScanRaw().is2d())
+			if(scanPub.getTopic().empty() && packet.scan2d)
 			{
 				scanPub = nh.advertise<sensor_msgs::LaserScan>("scan", 1);
-				if(odom.data().laserScanRaw().angleIncrement() > 0.0f)
+				if(packet.scanAngleIncrementSet)
 				{
 					ROS_INFO("Scan will be published.");
 				}
 				else
 				{
 					ROS_INFO("Scan will be published with those parameters:");
-					ROS_INFO("  scan_angle_min=%f", scanAngleMin);
-					ROS_INFO("  scan_angle_max=%f", scanAngleMax);
-					ROS_INFO("  scan_angle_increment=%f", scanAngleIncrement);
-					ROS_INFO("  scan_range_min=%f", scanRangeMin);
-					ROS_INFO("  scan_range_max=%f", scanRangeMax);
+					ROS_INFO("  scan_angle_min=%f", config.scanAngleMin);
+					ROS_INFO("  scan_angle_max=%f", config.scanAngleMax);
+					ROS_INFO("  scan_angle_increment=%f", config.scanAngleIncrement);
+					ROS_INFO("  scan_range_min=%f", config.scanRangeMin);
+					ROS_INFO("  scan_range_max=%f", config.scanRangeMax);
 				}
 			}
 			else if(scanCloudPub.getTopic().empty())
@@ -397,8 +756,8 @@ int main(int argc, char** argv)
 			if(!localTransform.isNull())
 			{
 				geometry_msgs::TransformStamped baseToCamera;
-				baseToCamera.child_frame_id = cameraFrameId;
-				baseToCamera.header.frame_id = frameId;
+				baseToCamera.child_frame_id = config.cameraFrameId;
+				baseToCamera.header.frame_id = config.frameId;
 				baseToCamera.header.stamp = time;
 				rtabmap_ros::transformToGeometryMsg(localTransform, baseToCamera.transform);
 				tfBroadcaster.sendTransform(baseToCamera);
@@ -407,8 +766,8 @@ int main(int argc, char** argv)
 			if(!odom.pose().isNull())
 			{
 				geometry_msgs::TransformStamped odomToBase;
-				odomToBase.child_frame_id = frameId;
-				odomToBase.header.frame_id = odomFrameId;
+				odomToBase.child_frame_id = config.frameId;
+				odomToBase.header.frame_id = config.odomFrameId;
 				odomToBase.header.stamp = time;
 				rtabmap_ros::transformToGeometryMsg(odom.pose(), odomToBase.transform);
 				tfBroadcaster.sendTransform(odomToBase);
@@ -417,8 +776,8 @@ int main(int argc, char** argv)
 			if(!scanPub.getTopic().empty() || !scanCloudPub.getTopic().empty())
 			{
 				geometry_msgs::TransformStamped baseToLaserScan;
-				baseToLaserScan.child_frame_id = scanFrameId;
-				baseToLaserScan.header.frame_id = frameId;
+				baseToLaserScan.child_frame_id = config.scanFrameId;
+				baseToLaserScan.header.frame_id = config.frameId;
 				baseToLaserScan.header.stamp = time;
 				rtabmap_ros::transformToGeometryMsg(odom.data().laserScanCompressed().localTransform(), baseToLaserScan.transform);
 				tfBroadcaster.sendTransform(baseToLaserScan);
@@ -431,8 +790,8 @@ int main(int argc, char** argv)
 			if(odometryPub.getNumSubscribers())
 			{
 				nav_msgs::Odometry odomMsg;
-				odomMsg.child_frame_id = frameId;
-				odomMsg.header.frame_id = odomFrameId;
+				odomMsg.child_frame_id = config.frameId;
+				odomMsg.header.frame_id = config.odomFrameId;
 				odomMsg.header.stamp = time;
 				rtabmap_ros::transformToPoseMsg(odom.pose(), odomMsg.pose.pose);
 				UASSERT(odomMsg.pose.covariance.size() == 36 &&
@@ -452,7 +811,7 @@ int main(int argc, char** argv)
 			geometry_msgs::PoseWithCovarianceStamped msg;
 			rtabmap_ros::transformToPoseMsg(odom.data().globalPose(), msg.pose.pose);
 			memcpy(msg.pose.covariance.data(), odom.data().globalPoseCovariance().data, 36*sizeof(double));
-			msg.header.frame_id = frameId;
+			msg.header.frame_id = config.frameId;
 			msg.header.stamp = time;
 			globalPosePub.publish(msg);
 		}
@@ -465,7 +824,7 @@ int main(int argc, char** argv)
 			msg.altitude = odom.data().gps().altitude();
 			msg.position_covariance_type = sensor_msgs::NavSatFix::COVARIANCE_TYPE_DIAGONAL_KNOWN;
 			msg.position_covariance.at(0) = msg.position_covariance.at(4) = msg.position_covariance.at(8)= odom.data().gps().error()* odom.data().gps().error();
-			msg.header.frame_id = frameId;
+			msg.header.frame_id = config.frameId;
 			msg.header.stamp.fromSec(odom.data().gps().stamp());
 			gpsFixPub.publish(msg);
 		}
@@ -474,143 +833,58 @@ int main(int argc, char** argv)
 		{
 			if(rgbCamInfoPub.getNumSubscribers() && type == 0)
 			{
-				rgbCamInfoPub.publish(camInfoA);
+				rgbCamInfoPub.publish(packet.camInfoA);
 			}
 			if(leftCamInfoPub.getNumSubscribers() && type == 1)
 			{
-				leftCamInfoPub.publish(camInfoA);
+				leftCamInfoPub.publish(packet.camInfoA);
 			}
 			if(depthCamInfoPub.getNumSubscribers() && type == 0)
 			{
-				depthCamInfoPub.publish(camInfoB);
+				depthCamInfoPub.publish(packet.camInfoB);
 			}
 			if(rightCamInfoPub.getNumSubscribers() && type == 1)
 			{
-				rightCamInfoPub.publish(camInfoB);
+				rightCamInfoPub.publish(packet.camInfoB);
 			}
 		}
 
-		if(imagePub.getNumSubscribers() || rgbPub.getNumSubscribers() || leftPub.getNumSubscribers())
+		if(packet.image.get() && (imagePub.getNumSubscribers() || rgbPub.getNumSubscribers() || leftPub.getNumSubscribers()))
 		{
-			cv_bridge::CvImage img;
-			if(odom.data().imageRaw().channels() == 1)
-			{
-				img.encoding = sensor_msgs::image_encodings::MONO8;
-			}
-			else
-			{
-				img.encoding = sensor_msgs::image_encodings::BGR8;
-			}
-			img.image = odom.data().imageRaw();
-			sensor_msgs::ImagePtr imageRosMsg = img.toImageMsg();
-			imageRosMsg->header.frame_id = cameraFrameId;
-			imageRosMsg->header.stamp = time;
-
 			if(imagePub.getNumSubscribers())
 			{
-				imagePub.publish(imageRosMsg);
+				imagePub.publish(packet.image);
 			}
 			if(rgbPub.getNumSubscribers() && type == 0)
 			{
-				rgbPub.publish(imageRosMsg);
+				rgbPub.publish(packet.image);
 			}
 			if(leftPub.getNumSubscribers() && type == 1)
 			{
-				leftPub.publish(imageRosMsg);
-				leftCamInfoPub.publish(camInfoA);
+				leftPub.publish(packet.image);
+				leftCamInfoPub.publish(packet.camInfoA);
 			}
 		}
 
-		if(depthPub.getNumSubscribers() && !odom.data().depthRaw().empty() && type==0)
+		if(depthPub.getNumSubscribers() && packet.depth.get())
 		{
-			cv_bridge::CvImage img;
-			if(odom.data().depthRaw().type() == CV_32FC1)
-			{
-				img.encoding = sensor_msgs::image_encodings::TYPE_32FC1;
-			}
-			else
-			{
-				img.encoding = sensor_msgs::image_encodings::TYPE_16UC1;
-			}
-			img.image = odom.data().depthRaw();
-			sensor_msgs::ImagePtr imageRosMsg = img.toImageMsg();
-			imageRosMsg->header.frame_id = cameraFrameId;
-			imageRosMsg->header.stamp = time;
-
-			depthPub.publish(imageRosMsg);
-			depthCamInfoPub.publish(camInfoB);
+			depthPub.publish(packet.depth);
+			depthCamInfoPub.publish(packet.camInfoB);
 		}
 
-		if(rightPub.getNumSubscribers() && !odom.data().rightRaw().empty() && type==1)
+		if(rightPub.getNumSubscribers() && packet.right.get())
 		{
-			cv_bridge::CvImage img;
-			img.encoding = sensor_msgs::image_encodings::MONO8;
-			img.image = odom.data().rightRaw();
-			sensor_msgs::ImagePtr imageRosMsg = img.toImageMsg();
-			imageRosMsg->header.frame_id = cameraFrameId;
-			imageRosMsg->header.stamp = time;
-
-			rightPub.publish(imageRosMsg);
-			rightCamInfoPub.publish(camInfoB);
+			rightPub.publish(packet.right);
+			rightCamInfoPub.publish(packet.camInfoB);
 		}
 
-		if(!odom.data().laserScanRaw().isEmpty())
+		if(packet.scan.get() && scanPub.getNumSubscribers())
 		{
-			if(scanPub.getNumSubscribers() && odom.data().laserScanRaw().is2d())
-			{
-				//inspired from pointcloud_to_laserscan package
-				sensor_msgs::LaserScan msg;
-				msg.header.frame_id = scanFrameId;
-				msg.header.stamp = time;
-
-				msg.angle_min = scanAngleMin;
-				msg.angle_max = scanAngleMax;
-				msg.angle_increment = scanAngleIncrement;
-				msg.time_increment = 0.0;
-				msg.scan_time = 0;
-				msg.range_min = scanRangeMin;
-				msg.range_max = scanRangeMax;
-				if(odom.data().laserScanRaw().angleIncrement() > 0.0f)
-				{
-					msg.angle_min = odom.data().laserScanRaw().angleMin();
-					msg.angle_max = odom.data().laserScanRaw().angleMax();
-					msg.angle_increment = odom.data().laserScanRaw().angleIncrement();
-					msg.range_min = odom.data().laserScanRaw().rangeMin();
-					msg.range_max = odom.data().laserScanRaw().rangeMax();
-				}
-
-				uint32_t rangesSize = std::ceil((msg.angle_max - msg.angle_min) / msg.angle_increment);
-				msg.ranges.assign(rangesSize, 0.0);
-
-				const cv::Mat & scan = odom.data().laserScanRaw().data();
-				for (int i=0; i<scan.cols; ++i)
-				{
-					const float * ptr = scan.ptr<float>(0,i);
-					double range = hypot(ptr[0], ptr[1]);
-					if (range >= msg.range_min && range <=msg.range_max)
-					{
-						double angle = atan2(ptr[1], ptr[0]);
-						if (angle >= msg.angle_min && angle <= msg.angle_max)
-						{
-							int index = (angle - msg.angle_min) / msg.angle_increment;
-							if (index>=0 && index<rangesSize && (range < msg.ranges[index] || msg.ranges[index]==0))
-							{
-								msg.ranges[index] = range;
-							}
-						}
-					}
-				}
-
-				scanPub.publish(msg);
-			}
-			else if(scanCloudPub.getNumSubscribers())
-			{
-				sensor_msgs::PointCloud2 msg;
-				pcl_conversions::moveFromPCL(*rtabmap::util3d::laserScanToPointCloud2(odom.data().laserScanRaw()), msg);
-				msg.header.frame_id = scanFrameId;
-				msg.header.stamp = time;
-				scanCloudPub.publish(msg);
-			}
+			scanPub.publish(packet.scan);
+		}
+		else if(packet.scanCloud.get() && scanCloudPub.getNumSubscribers())
+		{
+			scanCloudPub.publish(packet.scanCloud);
 		}
 
 		if(odom.data().userDataRaw().type() == CV_8SC1 &&
@@ -644,6 +918,7 @@ int main(int argc, char** argv)
 
 		ros::spinOnce();
 
+		ros::WallTime pauseStart = ros::WallTime::now();
 		while(ros::ok())
 		{
 #ifndef _WIN32
@@ -668,15 +943,27 @@ int main(int argc, char** argv)
 			uSleep(100);
 			ros::spinOnce();
 		}
+		if(!simDeadlines)
+		{
+			// don't count the pause in the deadlines of the next frames
+			pausedDuration += ros::WallTime::now() - pauseStart;
+		}
 
-		timer.restart();
-		cameraInfo = rtabmap::CameraInfo();
-		data = reader.takeImage(&cameraInfo);
-		odomInfo.reg.covariance = cameraInfo.odomCovariance;
-		odom = rtabmap::OdometryEvent(data, cameraInfo.odomPose, odomInfo);
-		acquisitionTime = timer.ticks();
+		if(frames % 100 == 0 && rate > 0.0)
+		{
+			ROS_INFO("Lateness over %d frames: mean=%.2f ms max=%.2f ms, %d frames late by more than 10 ms",
+					frames, latenessSum/frames, latenessMax, lateFrames);
+		}
 	}
+	pipeline.stop();
 
+	double playTime = (ros::WallTime::now() - playStart).toSec();
+	ROS_INFO("Played %d frames in %f s (%.1f Hz)", frames, playTime, playTime>0.0?frames/playTime:0.0);
+	if(frames && rate > 0.0)
+	{
+		ROS_INFO("Lateness: mean=%.2f ms max=%.2f ms, %d frames late by more than 10 ms",
+				latenessSum/frames, latenessMax, lateFrames);
+	}
 
 	return 0;
 }
@@ -63,6 +63,9 @@ ros::ServiceClient getMapSrv;
 
 // This is used to keep in cache the old data of the map
 std::map<int, rtabmap::SensorData> localData;
+std::map<int, rtabmap::Transform> graphPoses; // complete graph, mapData may only contain a delta
+std::multimap<int, rtabmap::Link> graphLinks;
+unsigned int graphId = 0;
 
 // In this example, we use rtabmap for our loop closure detector
 rtabmap::Rtabmap loopClosureDetector;
@@ -88,10 +91,12 @@ void mapDataCallback(const rtabmap_ros::MapDataConstPtr & mapDataMsg, const rtab
 	}
 
 	rtabmap::Transform mapToOdom;
-	std::map<int, rtabmap::Transform> poses;
-	std::multimap<int, rtabmap::Link> links;
 	std::map<int, rtabmap::Signature> signatures;
-	rtabmap_ros::mapDataFromROS(*mapDataMsg, poses, links, signatures, mapToOdom);
+	if(!rtabmap_ros::mapDataDeltaFromROS(*mapDataMsg, graphPoses, graphLinks, signatures, mapToOdom, graphId))
+	{
+		ROS_WARN("Waiting for a complete graph...");
+		return;
+	}
 
 	if(!signatures.empty() &&
 		signatures.rbegin()->second.sensorData().isValid() &&
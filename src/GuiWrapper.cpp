@@ -74,7 +74,8 @@ GuiWrapper::GuiWrapper(int & argc, char** argv) :
 		maxOdomUpdateRate_(10),
 		cameraNodeName_(""),
 		lastOdomInfoUpdateTime_(0),
-		rtabmapNodeName_("rtabmap")
+		rtabmapNodeName_("rtabmap"),
+		graphId_(0)
 {
 	ros::NodeHandle nh;
 	ros::NodeHandle pnh("~");
@@ -196,19 +197,20 @@ void GuiWrapper::infoMapCallback(
 
 	// MapData
 	rtabmap::Transform mapToOdom;
-	std::map<int, rtabmap::Transform> poses;
 	std::map<int, Signature> signatures;
-	std::multimap<int, rtabmap::Link> links;
-
-	rtabmap_ros::mapDataFromROS(*mapMsg, poses, links, signatures, mapToOdom);
+	if(!rtabmap_ros::mapDataDeltaFromROS(*mapMsg, graphPoses_, graphLinks_, signatures, mapToOdom, graphId_))
+	{
+		ROS_DEBUG("rtabmapviz: Waiting for a complete graph on mapData topic...");
+		return;
+	}
 
 	stat.setMapCorrection(mapToOdom);
-	stat.setPoses(poses);
+	stat.setPoses(graphPoses_);
 	if(signatures.size())
 	{
 		stat.setLastSignatureData(signatures.rbegin()->second);
 	}
-	stat.setConstraints(links);
+	stat.setConstraints(graphLinks_);
 
 	this->post(new RtabmapEvent(stat));
 }
@@ -246,6 +248,11 @@ void GuiWrapper::processRequestedMap(const rtabmap_ros::MapData & map)
 	std::multimap<int, rtabmap::Link> constraints;
 	Transform mapToOdom;
 
+	if(map.graph.delta)
+	{
+		ROS_ERROR("rtabmapviz: The requested map is not a complete graph (delta), ignoring it.");
+		return;
+	}
 	rtabmap_ros::mapDataFromROS(map, poses, constraints, signatures, mapToOdom);
 
 	RtabmapEvent3DMap e(signatures,
@@ -0,0 +1,265 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap_ros/ImuBuffer.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <Eigen/Geometry>
+#include <boost/thread/thread.hpp>
+#include <cstring>
+
+namespace rtabmap_ros {
+
+ImuBuffer::ImuBuffer(size_t capacity) :
+	capacity_(capacity),
+	samples_(new Sample[capacity]),
+	head_(0),
+	tail_(0),
+	version_(0),
+	lastStamp_(0.0)
+{
+	UASSERT(capacity_ > 1);
+}
+
+bool ImuBuffer::push(const Sample & sample)
+{
+	double lastStamp = lastStamp_.load(boost::memory_order_relaxed);
+	if(lastStamp > 0.0 && sample.stamp <= lastStamp)
+	{
+		return false;
+	}
+	size_t head = head_.load(boost::memory_order_relaxed);
+	size_t tail = tail_.load(boost::memory_order_acquire);
+
+	unsigned int version = version_.load(boost::memory_order_relaxed);
+	version_.store(version+1, boost::memory_order_relaxed);
+	boost::atomic_thread_fence(boost::memory_order_release);
+
+	// drop the oldest sample if full, unless already removed by a reader
+	while(head - tail >= capacity_ && !tail_.compare_exchange_weak(tail, tail+1)) {}
+	samples_[head % capacity_] = sample;
+	head_.store(head+1, boost::memory_order_release);
+	lastStamp_.store(sample.stamp, boost::memory_order_relaxed);
+
+	version_.store(version+2, boost::memory_order_release);
+	return true;
+}
+
+bool ImuBuffer::push(const sensor_msgs::Imu & msg, const rtabmap::Transform & localTransform)
+{
+	UASSERT(!localTransform.isNull());
+	Sample sample;
+	sample.stamp = msg.header.stamp.toSec();
+	sample.orientation[0] = msg.orientation.x;
+	sample.orientation[1] = msg.orientation.y;
+	sample.orientation[2] = msg.orientation.z;
+	sample.orientation[3] = msg.orientation.w;
+	sample.angularVelocity[0] = msg.angular_velocity.x;
+	sample.angularVelocity[1] = msg.angular_velocity.y;
+	sample.angularVelocity[2] = msg.angular_velocity.z;
+	sample.linearAcceleration[0] = msg.linear_acceleration.x;
+	sample.linearAcceleration[1] = msg.linear_acceleration.y;
+	sample.linearAcceleration[2] = msg.linear_acceleration.z;
+	memcpy(sample.orientationCovariance, msg.orientation_covariance.data(), 9*sizeof(double));
+	memcpy(sample.angularVelocityCovariance, msg.angular_velocity_covariance.data(), 9*sizeof(double));
+	memcpy(sample.linearAccelerationCovariance, msg.linear_acceleration_covariance.data(), 9*sizeof(double));
+	memcpy(sample.localTransform, localTransform.data(), 12*sizeof(float));
+	return push(sample);
+}
+
+void ImuBuffer::clear()
+{
+	size_t head = head_.load(boost::memory_order_acquire);
+	size_t tail = tail_.load(boost::memory_order_relaxed);
+	while(tail < head && !tail_.compare_exchange_weak(tail, head)) {}
+	lastStamp_.store(0.0, boost::memory_order_relaxed);
+}
+
+size_t ImuBuffer::size() const
+{
+	size_t tail = tail_.load(boost::memory_order_acquire);
+	size_t head = head_.load(boost::memory_order_acquire);
+	return head > tail?head - tail:0;
+}
+
+double ImuBuffer::firstStamp() const
+{
+	while(true)
+	{
+		unsigned int version = version_.load(boost::memory_order_acquire);
+		if(version & 1)
+		{
+			boost::this_thread::yield();
+			continue;
+		}
+		size_t tail = tail_.load(boost::memory_order_acquire);
+		size_t head = head_.load(boost::memory_order_acquire);
+		double stamp = head > tail?samples_[tail % capacity_].stamp:0.0;
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		if(version_.load(boost::memory_order_relaxed) == version)
+		{
+			return stamp;
+		}
+	}
+}
+
+double ImuBuffer::lastStamp() const
+{
+	return lastStamp_.load(boost::memory_order_relaxed);
+}
+
+size_t ImuBuffer::lowerBound(size_t tail, size_t head, double stamp) const
+{
+	// first index in [tail, head) with a stamp >= stamp, head if none
+	while(tail < head)
+	{
+		size_t mid = tail + (head - tail) / 2;
+		if(samples_[mid % capacity_].stamp < stamp)
+		{
+			tail = mid + 1;
+		}
+		else
+		{
+			head = mid;
+		}
+	}
+	return tail;
+}
+
+rtabmap::Transform ImuBuffer::getOrientation(double stamp) const
+{
+	Sample a, b;
+	bool found;
+	while(true)
+	{
+		unsigned int version = version_.load(boost::memory_order_acquire);
+		if(version & 1)
+		{
+			boost::this_thread::yield();
+			continue;
+		}
+		size_t tail = tail_.load(boost::memory_order_acquire);
+		size_t head = head_.load(boost::memory_order_acquire);
+		found = false;
+		if(head > tail)
+		{
+			size_t i = lowerBound(tail, head, stamp);
+			if(i < head)
+			{
+				b = samples_[i % capacity_];
+				if(b.stamp == stamp)
+				{
+					a = b;
+					found = true;
+				}
+				else if(i > tail)
+				{
+					a = samples_[(i-1) % capacity_];
+					found = true;
+				}
+			}
+		}
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		if(version_.load(boost::memory_order_relaxed) == version)
+		{
+			break;
+		}
+	}
+
+	if(!found)
+	{
+		return rtabmap::Transform();
+	}
+
+	Eigen::Quaterniond qa(a.orientation[3], a.orientation[0], a.orientation[1], a.orientation[2]);
+	Eigen::Quaterniond qb(b.orientation[3], b.orientation[0], b.orientation[1], b.orientation[2]);
+	Eigen::Quaterniond q = qa;
+	if(b.stamp > a.stamp)
+	{
+		q = qa.slerp((stamp - a.stamp) / (b.stamp - a.stamp), qb);
+	}
+	q.normalize();
+	return rtabmap::Transform(0,0,0, q.x(), q.y(), q.z(), q.w());
+}
+
+std::vector<ImuBuffer::Sample> ImuBuffer::takeUntil(double stamp)
+{
+	std::vector<Sample> samples;
+	samples.reserve(size()+1);
+	size_t end;
+	while(true)
+	{
+		unsigned int version = version_.load(boost::memory_order_acquire);
+		if(version & 1)
+		{
+			boost::this_thread::yield();
+			continue;
+		}
+		size_t tail = tail_.load(boost::memory_order_acquire);
+		size_t head = head_.load(boost::memory_order_acquire);
+		samples.clear();
+		end = tail;
+		if(head > tail)
+		{
+			end = lowerBound(tail, head, stamp);
+			if(end < head)
+			{
+				++end;
+			}
+			for(size_t i=tail; i<end; ++i)
+			{
+				samples.push_back(samples_[i % capacity_]);
+			}
+		}
+		boost::atomic_thread_fence(boost::memory_order_acquire);
+		if(version_.load(boost::memory_order_relaxed) == version)
+		{
+			break;
+		}
+	}
+
+	size_t tail = tail_.load(boost::memory_order_relaxed);
+	while(tail < end && !tail_.compare_exchange_weak(tail, end)) {}
+	return samples;
+}
+
+rtabmap::IMU ImuBuffer::toIMU(const Sample & sample)
+{
+	const float * t = sample.localTransform;
+	return rtabmap::IMU(
+			cv::Vec4d(sample.orientation[0], sample.orientation[1], sample.orientation[2], sample.orientation[3]),
+			cv::Mat(3,3,CV_64FC1,(void*)sample.orientationCovariance).clone(),
+			cv::Vec3d(sample.angularVelocity[0], sample.angularVelocity[1], sample.angularVelocity[2]),
+			cv::Mat(3,3,CV_64FC1,(void*)sample.angularVelocityCovariance).clone(),
+			cv::Vec3d(sample.linearAcceleration[0], sample.linearAcceleration[1], sample.linearAcceleration[2]),
+			cv::Mat(3,3,CV_64FC1,(void*)sample.linearAccelerationCovariance).clone(),
+			rtabmap::Transform(
+					t[0], t[1], t[2], t[3],
+					t[4], t[5], t[6], t[7],
+					t[8], t[9], t[10], t[11]));
+}
+
+}
@@ -40,10 +40,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UStl.h>
 #include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UDirectory.h>
 #include <pcl_ros/transforms.h>
 #include <pcl_conversions/pcl_conversions.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <std_srvs/Empty.h>
+#include <ros/serialization.h>
+#include <fstream>
+#include <list>
 
 #ifdef WITH_OCTOMAP_MSGS
 #ifdef RTABMAP_OCTOMAP
@@ -55,11 +59,217 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 using namespace rtabmap;
 
+// Node data received on mapData, kept in memory up to a maximum size. The
+// least recently used nodes are serialized to disk and reloaded on demand.
+// Only the raw node data is bounded: the local grids and the clouds of
+// MapsManager are kept for all nodes of the map (see processMapData()).
+class NodeCache
+{
+public:
+	NodeCache() :
+		maxBytes_(0),
+		bytes_(0),
+		directoryCreated_(false)
+	{}
+	~NodeCache()
+	{
+		clear();
+		if(directoryCreated_)
+		{
+			// empty now, remove() also removes empty directories
+			UFile::erase(directory_);
+		}
+	}
+
+	// maxBytes=0 means no limit (nothing is saved to disk)
+	void init(size_t maxBytes, const std::string & directory)
+	{
+		clear();
+		maxBytes_ = maxBytes;
+		directory_ = directory;
+		if(maxBytes_ && !UDirectory::exists(directory_))
+		{
+			directoryCreated_ = UDirectory::makeDir(directory_);
+			if(!directoryCreated_)
+			{
+				ROS_ERROR("Cannot create node cache directory \"%s\", node cache size is not limited.", directory_.c_str());
+				maxBytes_ = 0;
+			}
+		}
+	}
+
+	void add(const rtabmap_ros::NodeData & msg)
+	{
+		erase(msg.id);
+		Entry & entry = memory_[msg.id];
+		entry.msg = msg;
+		entry.bytes = ros::serialization::serializationLength(msg);
+		lru_.push_front(msg.id);
+		entry.lruIter = lru_.begin();
+		bytes_ += entry.bytes;
+		evict();
+	}
+
+	bool contains(int id) const
+	{
+		return memory_.find(id) != memory_.end() || disk_.find(id) != disk_.end();
+	}
+
+	// Return false if the node is not in the cache
+	bool get(int id, rtabmap_ros::NodeData & msg)
+	{
+		std::map<int, Entry>::iterator iter = memory_.find(id);
+		if(iter != memory_.end())
+		{
+			lru_.splice(lru_.begin(), lru_, iter->second.lruIter);
+			msg = iter->second.msg;
+			return true;
+		}
+		if(disk_.find(id) == disk_.end())
+		{
+			return false;
+		}
+		if(!load(id, msg))
+		{
+			// corrupted file, forget the node
+			disk_.erase(id);
+			UFile::erase(filePath(id));
+			return false;
+		}
+		// The file is kept, it doesn't need to be written again when evicted.
+		Entry & entry = memory_[id];
+		entry.msg = msg;
+		entry.bytes = ros::serialization::serializationLength(msg);
+		lru_.push_front(id);
+		entry.lruIter = lru_.begin();
+		bytes_ += entry.bytes;
+		evict();
+		return true;
+	}
+
+	void clear()
+	{
+		for(std::set<int>::iterator iter=disk_.begin(); iter!=disk_.end(); ++iter)
+		{
+			UFile::erase(filePath(*iter));
+		}
+		disk_.clear();
+		memory_.clear();
+		lru_.clear();
+		bytes_ = 0;
+	}
+
+	bool empty() const {return memory_.empty() && disk_.empty();}
+	size_t memoryUsed() const {return bytes_;}
+	size_t nodesInMemory() const {return memory_.size();}
+	size_t nodesOnDisk() const {return disk_.size();}
+
+private:
+	struct Entry
+	{
+		rtabmap_ros::NodeData msg;
+		size_t bytes;
+		std::list<int>::iterator lruIter;
+	};
+
+	std::string filePath(int id) const
+	{
+		return directory_ + "/" + uNumber2Str(id) + ".bin";
+	}
+
+	void erase(int id)
+	{
+		std::map<int, Entry>::iterator iter = memory_.find(id);
+		if(iter != memory_.end())
+		{
+			bytes_ -= iter->second.bytes;
+			lru_.erase(iter->second.lruIter);
+			memory_.erase(iter);
+		}
+		if(disk_.erase(id))
+		{
+			UFile::erase(filePath(id));
+		}
+	}
+
+	// Move the least recently used nodes to disk until the node data fit in maxBytes_.
+	void evict()
+	{
+		while(maxBytes_ && bytes_ > maxBytes_ && lru_.size() > 1)
+		{
+			int id = lru_.back();
+			std::map<int, Entry>::iterator iter = memory_.find(id);
+			if(disk_.find(id) == disk_.end())
+			{
+				if(!save(iter->second.msg))
+				{
+					ROS_ERROR("Cannot save node %d to \"%s\", node cache size is not limited anymore.", id, directory_.c_str());
+					maxBytes_ = 0;
+					return;
+				}
+				disk_.insert(id);
+			}
+			bytes_ -= iter->second.bytes;
+			lru_.pop_back();
+			memory_.erase(iter);
+		}
+	}
+
+	bool save(const rtabmap_ros::NodeData & msg) const
+	{
+		uint32_t size = ros::serialization::serializationLength(msg);
+		std::vector<uint8_t> buffer(size);
+		ros::serialization::OStream stream(buffer.data(), size);
+		ros::serialization::serialize(stream, msg);
+		std::ofstream file(filePath(msg.id).c_str(), std::ios::binary);
+		file.write((const char *)buffer.data(), size);
+		return file.good();
+	}
+
+	bool load(int id, rtabmap_ros::NodeData & msg) const
+	{
+		std::ifstream file(filePath(id).c_str(), std::ios::binary | std::ios::ate);
+		if(!file.good())
+		{
+			ROS_ERROR("Cannot open \"%s\"", filePath(id).c_str());
+			return false;
+		}
+		std::vector<uint8_t> buffer(file.tellg());
+		file.seekg(0);
+		file.read((char *)buffer.data(), buffer.size());
+		if(file.gcount() != (std::streamsize)buffer.size())
+		{
+			ROS_ERROR("Cannot read \"%s\" (%d/%d bytes)", filePath(id).c_str(), (int)file.gcount(), (int)buffer.size());
+			return false;
+		}
+		try
+		{
+			ros::serialization::IStream stream(buffer.data(), buffer.size());
+			ros::serialization::deserialize(stream, msg);
+		}
+		catch(const ros::serialization::StreamOverrunException & e)
+		{
+			ROS_ERROR("Cannot deserialize node %d from \"%s\": %s", id, filePath(id).c_str(), e.what());
+			return false;
+		}
+		return true;
+	}
+
+	size_t maxBytes_;
+	size_t bytes_;
+	std::string directory_;
+	bool directoryCreated_; // removed on destruction
+	std::map<int, Entry> memory_;
+	std::list<int> lru_; // most recently used first
+	std::set<int> disk_;
+};
+
 class MapAssembler
 {
 
 public:
 	MapAssembler(int & argc, char** argv) :
+		graphId_(0),
 		localGridsRegenerated_(false)
 	{
 		ros::NodeHandle pnh("~");
@@ -69,6 +279,17 @@ public:
 		pnh.param("config_path", configPath, configPath);
 		pnh.param("regenerate_local_grids", localGridsRegenerated_, localGridsRegenerated_);
 
+		// Maximum memory used by the received node data, the least
+		// recently used nodes are moved to node_cache_path (0=no limit).
+		// The default path includes the node name, as the cache is cleared on start.
+		int nodeCacheSizeMB = 0;
+		char * rosHomePath = getenv("ROS_HOME");
+		std::string nodeCachePath = (rosHomePath?rosHomePath:UDirectory::homeDir()+"/.ros") + "/map_assembler_cache" + uReplaceChar(ros::this_node::getName(), '/', '_');
+		pnh.param("node_cache_size_mb", nodeCacheSizeMB, nodeCacheSizeMB);
+		pnh.param("node_cache_path", nodeCachePath, nodeCachePath);
+		nodeCachePath = uReplaceChar(nodeCachePath, '~', UDirectory::homeDir());
+		nodeCache_.init(nodeCacheSizeMB>0?size_t(nodeCacheSizeMB)*1024*1024:0, nodeCachePath);
+
 		//parameters
 		rtabmap::ParametersMap parameters;
 		uInsert(parameters, rtabmap::Parameters::getDefaultParameters("Grid"));
@@ -175,9 +396,20 @@ public:
 		}
 
 		ROS_INFO("%s: regenerate_local_grids          = %s", ros::this_node::getName().c_str(), localGridsRegenerated_?"true":"false");
+		ROS_INFO("%s: node_cache_size_mb              = %d", ros::this_node::getName().c_str(), nodeCacheSizeMB);
+		ROS_INFO("%s: node_cache_path                 = %s", ros::this_node::getName().c_str(), nodeCachePath.c_str());
 		mapsManager_.init(nh, pnh, ros::this_node::getName(), false);
 		mapsManager_.backwardCompatibilityParameters(pnh, parameters);
 		mapsManager_.setParameters(parameters);
+		if(nodeCacheSizeMB > 0)
+		{
+			// the local grids of nodes not assembled can be created again from the node cache
+			mapsManager_.setGridCacheFiltered(true);
+			ROS_INFO("%s: node_cache_size_mb bounds only the received node data: the local "
+					"grids of the nodes not assembled (see map_filter_radius) are reloaded from it "
+					"when needed, the local grids and clouds of the assembled nodes are not bounded.",
+					ros::this_node::getName().c_str());
+		}
 
 		std::list<std::string> splitName = uSplit(nh.resolveName("mapData"), '/');
 		std::string rtabmapNs;
@@ -251,44 +483,46 @@ public:
 	{
 		UTimer timer;
 
-		std::map<int, Transform> poses;
-		std::multimap<int, Link> constraints;
 		Transform mapOdom;
-		rtabmap_ros::mapGraphFromROS(msg.graph, poses, constraints, mapOdom);
+		bool graphReceived = rtabmap_ros::mapGraphDeltaFromROS(msg.graph, graphPoses_, graphLinks_, mapOdom, graphId_);
+		std::map<int, Transform> poses = graphPoses_;
 		for(unsigned int i=0; i<msg.nodes.size(); ++i)
 		{
 			if(msg.nodes[i].image.size() ||
 			   msg.nodes[i].depth.size() ||
 			   msg.nodes[i].laserScan.size())
 			{
-				Signature data = rtabmap_ros::nodeDataFromROS(msg.nodes[i]);
-				if(localGridsRegenerated_)
-				{
-					data.sensorData().setOccupancyGrid(cv::Mat(), cv::Mat(), cv::Mat(), 0, cv::Point3f());
-				}
-				uInsert(nodes_, std::make_pair(msg.nodes[i].id, data));
+				nodeCache_.add(msg.nodes[i]);
 			}
 		}
 
-		// create a tmp signature with latest sensory data
-		if(poses.size() && nodes_.find(poses.rbegin()->first) != nodes_.end())
+		if(!graphReceived)
+		{
+			ROS_DEBUG("map_assembler: Waiting for a complete graph before updating the maps...");
+			return;
+		}
+
+		// create a tmp node with latest sensory data (see loadNodes())
+		if(poses.size() && nodeCache_.contains(poses.rbegin()->first))
 		{
-			Signature tmpS = nodes_.at(poses.rbegin()->first);
-			SensorData tmpData = tmpS.sensorData();
-			tmpData.setId(0);
-			uInsert(nodes_, std::make_pair(0, Signature(0, -1, 0, tmpS.getStamp(), "", tmpS.getPose(), Transform(), tmpData)));
 			poses.insert(std::make_pair(0, poses.rbegin()->second));
 		}
 
-		// Update maps
-		if(!nodes_.empty())
+		// Update maps. The local grids and clouds of the assembled nodes are
+		// kept by mapsManager_ whatever node_cache_size_mb: they are needed to
+		// move the clouds of the nodes after a graph optimization, and with
+		// cloud_subtract_filtering they depend on the clouds added before, so
+		// they cannot be regenerated from the node data. With a bounded node
+		// cache, the local grids of the other nodes are reloaded by loadNodes().
+		if(!nodeCache_.empty())
 		{
+			// Node data is needed only if the maps are updated (there are subscribers)
 			poses = mapsManager_.updateMapCaches(
 					poses,
 					0,
 					false,
 					false,
-					nodes_);
+					mapsManager_.hasSubscribers()?loadNodes(poses):std::map<int, Signature>());
 		}
 		double updateTime = timer.ticks();
 
@@ -298,12 +532,57 @@ public:
 		mapsManager_.publishMaps(poses, msg.header.stamp, msg.header.frame_id);
 
 		ROS_INFO("map_assembler: Updating = %fs, Publishing data = %fs (subscribers=%s)", updateTime, timer.ticks(), mapsManager_.hasSubscribers()?"true":"false");
+		ROS_DEBUG("map_assembler: node cache: %d in memory (%ld MB), %d on disk",
+				(int)nodeCache_.nodesInMemory(), (long)(nodeCache_.memoryUsed()/(1024*1024)), (int)nodeCache_.nodesOnDisk());
+	}
+
+	Signature getNode(int id)
+	{
+		rtabmap_ros::NodeData msg;
+		if(!nodeCache_.get(id, msg))
+		{
+			return Signature();
+		}
+		Signature data = rtabmap_ros::nodeDataFromROS(msg);
+		if(localGridsRegenerated_)
+		{
+			data.sensorData().setOccupancyGrid(cv::Mat(), cv::Mat(), cv::Mat(), 0, cv::Point3f());
+		}
+		return data;
+	}
+
+	// Data of the nodes not already in the maps cache, only those are used by updateMapCaches()
+	std::map<int, Signature> loadNodes(const std::map<int, Transform> & poses)
+	{
+		std::map<int, Transform> filteredPoses = mapsManager_.getFilteredPoses(poses);
+		const std::map<int, Transform> & required = filteredPoses.empty()?poses:filteredPoses;
+		std::set<int> cachedIds = mapsManager_.getCachedNodes();
+		std::map<int, Signature> nodes;
+		for(std::map<int, Transform>::const_iterator iter=required.lower_bound(1); iter!=required.end(); ++iter)
+		{
+			if(cachedIds.find(iter->first) == cachedIds.end() && nodeCache_.contains(iter->first))
+			{
+				nodes.insert(std::make_pair(iter->first, getNode(iter->first)));
+			}
+		}
+		if(poses.find(0) != poses.end() && poses.size() > 1)
+		{
+			// tmp signature with latest sensory data, always updated
+			int latestId = poses.rbegin()->first;
+			Signature tmpS = nodes.find(latestId) != nodes.end()?nodes.at(latestId):getNode(latestId);
+			SensorData tmpData = tmpS.sensorData();
+			tmpData.setId(0);
+			nodes.insert(std::make_pair(0, Signature(0, -1, 0, tmpS.getStamp(), "", tmpS.getPose(), Transform(), tmpData)));
+		}
+		return nodes;
 	}
 
 	bool reset(std_srvs::Empty::Request&, std_srvs::Empty::Response&)
 	{
 		ROS_INFO("map_assembler: reset!");
 		mapsManager_.clear();
+		graphPoses_.clear();
+		graphLinks_.clear();
 		return true;
 	}
 
@@ -317,7 +596,7 @@ public:
 		res.map.header.frame_id = mapFrameId_;
 		res.map.header.stamp = ros::Time::now();
 
-		mapsManager_.updateMapCaches(optimizedPoses_, 0, false, true, nodes_);
+		mapsManager_.updateMapCaches(optimizedPoses_, 0, false, true, loadNodes(optimizedPoses_));
 
 		const rtabmap::OctoMap * octomap = mapsManager_.getOctomap();
 		bool success = octomap->octree()->size() && octomap_msgs::binaryMapToMsg(*octomap->octree(), res.map);
@@ -332,7 +611,7 @@ public:
 		res.map.header.frame_id = mapFrameId_;
 		res.map.header.stamp = ros::Time::now();
 
-		mapsManager_.updateMapCaches(optimizedPoses_, 0, false, true, nodes_);
+		mapsManager_.updateMapCaches(optimizedPoses_, 0, false, true, loadNodes(optimizedPoses_));
 
 		const rtabmap::OctoMap * octomap = mapsManager_.getOctomap();
 		bool success = octomap->octree()->size() && octomap_msgs::fullMapToMsg(*octomap->octree(), res.map);
@@ -343,8 +622,11 @@ public:
 
 private:
 	MapsManager mapsManager_;
-	std::map<int, Signature> nodes_;
+	NodeCache nodeCache_;
 	std::map<int, Transform> optimizedPoses_;
+	std::map<int, Transform> graphPoses_; // complete graph (delta mode)
+	std::multimap<int, Link> graphLinks_;
+	unsigned int graphId_;
 	std::string mapFrameId_;
 
 	ros::Subscriber mapDataTopic_;
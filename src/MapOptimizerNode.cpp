@@ -53,6 +53,7 @@ public:
 		globalOptimization_(true),
 		optimizeFromLastNode_(false),
 		mapToOdom_(rtabmap::Transform::getIdentity()),
+		graphId_(0),
 		transformThread_(0)
 	{
 		ros::NodeHandle nh;
@@ -142,12 +143,21 @@ public:
 		// Assuming that nodes/constraints are all linked together
 		UASSERT(msg->graph.posesId.size() == msg->graph.poses.size());
 
+		// the graph may be sent as delta (map_graph_delta)
+		Transform mapToOdom;
+		std::map<int, Signature> nodes;
+		if(!rtabmap_ros::mapDataDeltaFromROS(*msg, graphPoses_, graphLinks_, nodes, mapToOdom, graphId_, false))
+		{
+			ROS_DEBUG("map_optimizer: Waiting for a complete graph...");
+			return;
+		}
+
 		bool dataChanged = false;
 
 		std::multimap<int, Link> newConstraints;
-		for(unsigned int i=0; i<msg->graph.links.size(); ++i)
+		for(std::multimap<int, Link>::iterator jter=graphLinks_.begin(); jter!=graphLinks_.end(); ++jter)
 		{
-			Link link = rtabmap_ros::linkFromROS(msg->graph.links[i]);
+			const Link & link = jter->second;
 			newConstraints.insert(std::make_pair(link.from(), link));
 
 			bool edgeAlreadyAdded = false;
@@ -174,11 +184,11 @@ public:
 
 		std::map<int, Signature> newNodeInfos;
 		// add new odometry poses
-		for(unsigned int i=0; i<msg->nodes.size(); ++i)
+		for(std::map<int, Signature>::iterator iter=nodes.begin(); iter!=nodes.end(); ++iter)
 		{
-			int id = msg->nodes[i].id;
-			Transform pose = rtabmap_ros::transformFromPoseMsg(msg->nodes[i].pose);
-			Signature s = rtabmap_ros::nodeInfoFromROS(msg->nodes[i]);
+			int id = iter->first;
+			const Signature & s = iter->second;
+			const Transform & pose = s.getPose();
 			newNodeInfos.insert(std::make_pair(id, s));
 
 			std::pair<std::map<int, Signature>::iterator, bool> p = cachedNodeInfos_.insert(std::make_pair(id, s));
@@ -206,16 +216,16 @@ public:
 		else
 		{
 			constraints = newConstraints;
-			for(unsigned int i=0; i<msg->graph.posesId.size(); ++i)
+			for(std::map<int, Transform>::iterator jter=graphPoses_.begin(); jter!=graphPoses_.end(); ++jter)
 			{
-				std::map<int, Signature>::iterator iter = cachedNodeInfos_.find(msg->graph.posesId[i]);
+				std::map<int, Signature>::iterator iter = cachedNodeInfos_.find(jter->first);
 				if(iter != cachedNodeInfos_.end())
 				{
 					nodeInfos.insert(*iter);
 				}
 				else
 				{
-					ROS_ERROR("Odometry pose of node %d not found in cache!", msg->graph.posesId[i]);
+					ROS_ERROR("Odometry pose of node %d not found in cache!", jter->first);
 					return;
 				}
 			}
@@ -330,6 +340,9 @@ private:
 
 	std::multimap<int, Link> cachedConstraints_;
 	std::map<int, Signature> cachedNodeInfos_;
+	std::map<int, Transform> graphPoses_; // last graph received
+	std::multimap<int, Link> graphLinks_;
+	unsigned int graphId_;
 
 	tf2_ros::TransformBroadcaster tfBroadcaster_;
 	boost::thread* transformThread_;
@@ -42,20 +42,314 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pcl/search/kdtree.h>
 
 #include <nav_msgs/OccupancyGrid.h>
+#include <map_msgs/OccupancyGridUpdate.h>
 #include <ros/ros.h>
 
 #include <pcl_conversions/pcl_conversions.h>
 
+#include <boost/thread.hpp>
+
 #ifdef WITH_OCTOMAP_MSGS
 #ifdef RTABMAP_OCTOMAP
 #include <octomap_msgs/conversions.h>
 #include <octomap/ColorOcTree.h>
 #include <rtabmap/core/OctoMap.h>
+#include <unordered_set>
 #endif
 #endif
 
 using namespace rtabmap;
 
+#ifdef WITH_OCTOMAP_MSGS
+#ifdef RTABMAP_OCTOMAP
+// Obstacle, ground, empty and frontier clouds of the octomap. After a first
+// full extraction, only the cells around the keys changed in the octree
+// and the cells of the points integrated since the last update are
+// re-evaluated. The extraction is done again from scratch if the octomap
+// has been cleared, re-generated (e.g., after a graph optimization) or pruned.
+class MapsManager::OctomapClouds
+{
+public:
+	enum CloudType {kObstacles=0, kGround, kEmpty, kFrontier, kCloudTypes};
+
+	OctomapClouds() :
+		octree_(0),
+		treeDepth_(0),
+		numLeafs_(0)
+	{
+		resetModified();
+	}
+
+	// Stop tracking changes, the next update() will extract all the clouds
+	void clear()
+	{
+		if(octree_)
+		{
+			octree_->enableChangeDetection(false);
+			octree_->resetChangeDetection();
+			octree_ = 0;
+		}
+		numLeafs_ = 0;
+		cells_.clear();
+		touchedKeys_.clear();
+		addedNodes_.clear();
+		for(int i=0; i<kCloudTypes; ++i)
+		{
+			clouds_[i].clear();
+			keys_[i].clear();
+			modified_[i] = true;
+		}
+	}
+
+	// Points integrated in the octree: the occupancy type, color and point
+	// of an occupied cell can change without being reported by the change
+	// detection (which only records new nodes and occupancy changes).
+	void touch(const cv::Mat & points, const Transform & pose)
+	{
+		if(octree_ == 0)
+		{
+			// not tracking changes, the next update() will extract all the clouds
+			return;
+		}
+		UASSERT(points.empty() || (points.type() == CV_32FC(points.channels()) && points.channels() >= 3));
+		octomap::OcTreeKey key;
+		for(int i=0; i<points.rows; ++i)
+		{
+			for(int j=0; j<points.cols; ++j)
+			{
+				const float * ptr = points.ptr<float>(i, j);
+				cv::Point3f pt = util3d::transformPoint(cv::Point3f(ptr[0], ptr[1], ptr[2]), pose);
+				if(octree_->coordToKeyChecked(pt.x, pt.y, pt.z, key))
+				{
+					touchedKeys_.insert(key);
+				}
+			}
+		}
+	}
+
+	// The octomap is owned by MapsManager, its octree is modified only to
+	// enable and reset the change detection.
+	void update(OctoMap & octomap, unsigned int treeDepth)
+	{
+		// OctoMap only gives a const access to its octree
+		RtabmapColorOcTree * octree = const_cast<RtabmapColorOcTree*>(octomap.octree());
+		if(treeDepth == 0 || treeDepth > octree->getTreeDepth())
+		{
+			treeDepth = octree->getTreeDepth();
+		}
+
+		// Nodes re-added or removed: the octree has been re-generated.
+		size_t numLeafs = octree->getNumLeafNodes();
+		bool regenerated = octree != octree_ || treeDepth != treeDepth_;
+		if(!regenerated)
+		{
+			// Pruning is not reported by the change detection. Each new node
+			// adds exactly one leaf, while a pruned node removes 7 leaves and
+			// an expanded pruned node adds 7. Any other count means that the
+			// octree has been pruned or expanded: a pruned cell is extracted
+			// as a single point.
+			size_t newLeafs = 0;
+			for(octomap::KeyBoolMap::const_iterator iter=octree->changedKeysBegin(); iter!=octree->changedKeysEnd(); ++iter)
+			{
+				newLeafs += iter->second?1:0;
+			}
+			regenerated = numLeafs != numLeafs_ + newLeafs;
+		}
+		for(std::map<int, Transform>::const_iterator iter=addedNodes_.begin(); !regenerated && iter!=addedNodes_.end(); ++iter)
+		{
+			std::map<int, Transform>::const_iterator jter = octomap.addedNodes().find(iter->first);
+			regenerated = jter == octomap.addedNodes().end() || !(jter->second == iter->second);
+		}
+
+		UTimer timer;
+		if(regenerated)
+		{
+			clear();
+			octree_ = octree;
+			treeDepth_ = treeDepth;
+			octree_->enableChangeDetection(true);
+			for(RtabmapColorOcTree::iterator it = octree->begin(treeDepth_); it != octree->end(); ++it)
+			{
+				updateCell(octree->adjustKeyAtDepth(it.getKey(), treeDepth_));
+			}
+			ROS_DEBUG("Octomap clouds extracted (%d cells, %fs)", (int)cells_.size(), timer.ticks());
+		}
+		else if(octree->numChangesDetected() || !touchedKeys_.empty())
+		{
+			// Changed cells and their neighbors (for frontiers)
+			octomap::key_type step = 1 << (octree->getTreeDepth() - treeDepth_);
+			std::unordered_set<octomap::OcTreeKey, octomap::OcTreeKey::KeyHash> keys;
+			for(octomap::KeyBoolMap::const_iterator iter=octree->changedKeysBegin(); iter!=octree->changedKeysEnd(); ++iter)
+			{
+				octomap::OcTreeKey key = octree->adjustKeyAtDepth(iter->first, treeDepth_);
+				keys.insert(key);
+				for(int i=0; i<3; ++i)
+				{
+					octomap::OcTreeKey neighbor = key;
+					neighbor[i] += step;
+					keys.insert(neighbor);
+					neighbor[i] = key[i] - step;
+					keys.insert(neighbor);
+				}
+			}
+			// Cells of the integrated points
+			for(std::unordered_set<octomap::OcTreeKey, octomap::OcTreeKey::KeyHash>::iterator iter=touchedKeys_.begin(); iter!=touchedKeys_.end(); ++iter)
+			{
+				keys.insert(octree->adjustKeyAtDepth(*iter, treeDepth_));
+			}
+			for(std::unordered_set<octomap::OcTreeKey, octomap::OcTreeKey::KeyHash>::iterator iter=keys.begin(); iter!=keys.end(); ++iter)
+			{
+				updateCell(*iter);
+			}
+			ROS_DEBUG("Octomap clouds updated (%d changed keys, %d touched keys, %d cells, %fs)",
+					(int)octree->numChangesDetected(), (int)touchedKeys_.size(), (int)cells_.size(), timer.ticks());
+		}
+		octree_->resetChangeDetection();
+		touchedKeys_.clear();
+		numLeafs_ = numLeafs;
+		addedNodes_ = octomap.addedNodes();
+	}
+
+	const pcl::PointCloud<pcl::PointXYZRGB> & cloud(CloudType type) const {return clouds_[type];}
+	bool modified(CloudType type) const {return modified_[type];}
+	void resetModified()
+	{
+		for(int i=0; i<kCloudTypes; ++i)
+		{
+			modified_[i] = false;
+		}
+	}
+
+private:
+	struct Cell
+	{
+		Cell() {for(int i=0; i<kCloudTypes; ++i) index[i] = -1;}
+		int index[kCloudTypes]; // index in the clouds, -1 if not in the cloud
+	};
+
+	bool hasUnknownNeighbor(const octomap::OcTreeKey & key) const
+	{
+		octomap::key_type step = 1 << (octree_->getTreeDepth() - treeDepth_);
+		for(int i=0; i<3; ++i)
+		{
+			octomap::OcTreeKey neighbor = key;
+			neighbor[i] += step;
+			if(octree_->search(neighbor, treeDepth_) == 0)
+			{
+				return true;
+			}
+			neighbor[i] = key[i] - step;
+			if(octree_->search(neighbor, treeDepth_) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void updateCell(const octomap::OcTreeKey & key)
+	{
+		const RtabmapColorOcTreeNode * node = octree_->search(key, treeDepth_);
+		std::unordered_map<octomap::OcTreeKey, Cell, octomap::OcTreeKey::KeyHash>::iterator iter = cells_.find(key);
+		if(node == 0 && iter == cells_.end())
+		{
+			return;
+		}
+		if(iter == cells_.end())
+		{
+			iter = cells_.insert(std::make_pair(key, Cell())).first;
+		}
+
+		pcl::PointXYZRGB pt;
+		bool types[kCloudTypes] = {false};
+		if(node)
+		{
+			octomap::point3d center = octree_->keyToCoord(key, treeDepth_);
+			if(octree_->isNodeOccupied(node))
+			{
+				if(treeDepth_ == octree_->getTreeDepth())
+				{
+					// original point
+					center = node->getPointRef();
+				}
+				types[node->getOccupancyType() == RtabmapColorOcTreeNode::kTypeGround?kGround:kObstacles] = true;
+			}
+			else
+			{
+				types[kEmpty] = true;
+				types[kFrontier] = hasUnknownNeighbor(key);
+			}
+			pt.x = center.x();
+			pt.y = center.y();
+			pt.z = center.z();
+			pt.r = node->getColor().r;
+			pt.g = node->getColor().g;
+			pt.b = node->getColor().b;
+			pt.a = 255;
+		}
+
+		bool empty = true;
+		for(int i=0; i<kCloudTypes; ++i)
+		{
+			setPoint((CloudType)i, key, iter->second, types[i]?&pt:0);
+			empty = empty && iter->second.index[i] < 0;
+		}
+		if(empty)
+		{
+			cells_.erase(iter);
+		}
+	}
+
+	// Add, update or remove (pt=0) the point of a cell
+	void setPoint(CloudType type, const octomap::OcTreeKey & key, Cell & cell, const pcl::PointXYZRGB * pt)
+	{
+		int & index = cell.index[type];
+		pcl::PointCloud<pcl::PointXYZRGB> & cloud = clouds_[type];
+		if(pt)
+		{
+			if(index < 0)
+			{
+				index = cloud.size();
+				cloud.push_back(*pt);
+				keys_[type].push_back(key);
+				modified_[type] = true;
+			}
+			else if(cloud.at(index).x != pt->x || cloud.at(index).y != pt->y || cloud.at(index).z != pt->z || cloud.at(index).rgba != pt->rgba)
+			{
+				cloud.at(index) = *pt;
+				modified_[type] = true;
+			}
+		}
+		else if(index >= 0)
+		{
+			// move the last point in the removed point slot
+			int last = (int)cloud.size()-1;
+			if(index != last)
+			{
+				cloud.at(index) = cloud.at(last);
+				keys_[type][index] = keys_[type][last];
+				cells_.at(keys_[type][index]).index[type] = index;
+			}
+			cloud.resize(last);
+			keys_[type].pop_back();
+			index = -1;
+			modified_[type] = true;
+		}
+	}
+
+	RtabmapColorOcTree * octree_;
+	unsigned int treeDepth_;
+	size_t numLeafs_; // number of leaf nodes in the octree on the last update
+	std::map<int, Transform> addedNodes_;
+	std::unordered_map<octomap::OcTreeKey, Cell, octomap::OcTreeKey::KeyHash> cells_;
+	std::unordered_set<octomap::OcTreeKey, octomap::OcTreeKey::KeyHash> touchedKeys_; // keys of the points integrated since the last update
+	pcl::PointCloud<pcl::PointXYZRGB> clouds_[kCloudTypes];
+	std::vector<octomap::OcTreeKey> keys_[kCloudTypes]; // cell of each point
+	bool modified_[kCloudTypes];
+};
+#endif
+#endif
+
 MapsManager::MapsManager() :
 		cloudOutputVoxelized_(true),
 		cloudSubtractFiltering_(false),
@@ -65,10 +359,21 @@ MapsManager::MapsManager() :
 		mapCacheCleanup_(true),
 		alwaysUpdateMap_(false),
 		scanEmptyRayTracing_(true),
+		mapCacheThreads_(1),
+		localGridWorkers_(0),
 		assembledObstacles_(new pcl::PointCloud<pcl::PointXYZRGB>),
 		assembledGround_(new pcl::PointCloud<pcl::PointXYZRGB>),
 		occupancyGrid_(new OccupancyGrid),
 		gridUpdated_(true),
+		gridRequired_(false),
+		gridCacheFiltered_(false),
+		gridMapUpdates_(false),
+		gridMapUpdatesKeyframe_(10),
+		gridMapUpdatesSinceKeyframe_(0),
+		gridMapPublishedXMin_(0.0f),
+		gridMapPublishedYMin_(0.0f),
+		gridMapPublishedCellSize_(0.0f),
+		gridMapNewSubscriber_(true),
 #ifdef WITH_OCTOMAP_MSGS
 #ifdef RTABMAP_OCTOMAP
 		octomap_(new OctoMap),
@@ -76,8 +381,14 @@ MapsManager::MapsManager() :
 #endif
 		octomapTreeDepth_(16),
 		octomapUpdated_(true),
+		octomapClouds_(0),
 		latching_(true)
 {
+#ifdef WITH_OCTOMAP_MSGS
+#ifdef RTABMAP_OCTOMAP
+	octomapClouds_ = new OctomapClouds;
+#endif
+#endif
 }
 
 void MapsManager::init(ros::NodeHandle & nh, ros::NodeHandle & pnh, const std::string & name, bool usePublicNamespace)
@@ -110,6 +421,11 @@ void MapsManager::init(ros::NodeHandle & nh, ros::NodeHandle & pnh, const std::s
 		}
 	}
 	pnh.param("map_empty_ray_tracing", scanEmptyRayTracing_, scanEmptyRayTracing_);
+	pnh.param("map_cache_threads", mapCacheThreads_, mapCacheThreads_);
+	if(mapCacheThreads_ <= 0)
+	{
+		mapCacheThreads_ = std::max(1, (int)boost::thread::hardware_concurrency());
+	}
 
 	if(pnh.hasParam("scan_output_voxelized"))
 	{
@@ -129,6 +445,7 @@ void MapsManager::init(ros::NodeHandle & nh, ros::NodeHandle & pnh, const std::s
 	ROS_INFO("%s(maps): map_cleanup                = %s", name.c_str(), mapCacheCleanup_?"true":"false");
 	ROS_INFO("%s(maps): map_always_update          = %s", name.c_str(), alwaysUpdateMap_?"true":"false");
 	ROS_INFO("%s(maps): map_empty_ray_tracing      = %s", name.c_str(), scanEmptyRayTracing_?"true":"false");
+	ROS_INFO("%s(maps): map_cache_threads          = %d", name.c_str(), mapCacheThreads_);
 	ROS_INFO("%s(maps): cloud_output_voxelized     = %s", name.c_str(), cloudOutputVoxelized_?"true":"false");
 	ROS_INFO("%s(maps): cloud_subtract_filtering   = %s", name.c_str(), cloudSubtractFiltering_?"true":"false");
 	ROS_INFO("%s(maps): cloud_subtract_filtering_min_neighbors = %d", name.c_str(), cloudSubtractFilteringMinNeighbors_);
@@ -155,6 +472,20 @@ void MapsManager::init(ros::NodeHandle & nh, ros::NodeHandle & pnh, const std::s
 	// connect
 	pnh.param("latch", latching_, latching_);
 
+	// If true, when the grid origin and size don't change, only the
+	// cells changed since the last published grid_map are published
+	// on grid_map_updates (if it has subscribers). grid_prob_map
+	// doesn't have updates, it is always published in full.
+	pnh.param("grid_map_updates", gridMapUpdates_, gridMapUpdates_);
+	ROS_INFO("%s(maps): grid_map_updates           = %s", name.c_str(), gridMapUpdates_?"true":"false");
+	// The full grid_map is still published every N updates (0=never), for
+	// subscribers of grid_map not listening to grid_map_updates.
+	pnh.param("grid_map_updates_keyframe", gridMapUpdatesKeyframe_, gridMapUpdatesKeyframe_);
+	if(gridMapUpdates_)
+	{
+		ROS_INFO("%s(maps): grid_map_updates_keyframe  = %d", name.c_str(), gridMapUpdatesKeyframe_);
+	}
+
 	// mapping topics
 	ros::NodeHandle * nht;
 	if(usePublicNamespace)
@@ -166,8 +497,13 @@ void MapsManager::init(ros::NodeHandle & nh, ros::NodeHandle & pnh, const std::s
 		nht = &pnh;
 	}
 	latched_.clear();
-	gridMapPub_ = nht->advertise<nav_msgs::OccupancyGrid>("grid_map", 1, latching_);
+	gridMapPub_ = nht->advertise<nav_msgs::OccupancyGrid>("grid_map", 1,
+			boost::bind(&MapsManager::gridMapSubscriberConnected, this, boost::placeholders::_1),
+			ros::SubscriberStatusCallback(),
+			ros::VoidConstPtr(),
+			latching_);
 	latched_.insert(std::make_pair((void*)&gridMapPub_, false));
+	gridMapUpdatesPub_ = nht->advertise<map_msgs::OccupancyGridUpdate>("grid_map_updates", 1);
 	gridProbMapPub_ = nht->advertise<nav_msgs::OccupancyGrid>("grid_prob_map", 1, latching_);
 	latched_.insert(std::make_pair((void*)&gridProbMapPub_, false));
 	cloudMapPub_ = nht->advertise<sensor_msgs::PointCloud2>("cloud_map", 1, latching_);
@@ -208,10 +544,13 @@ void MapsManager::init(ros::NodeHandle & nh, ros::NodeHandle & pnh, const std::s
 MapsManager::~MapsManager() {
 	clear();
 
+	delete localGridWorkers_;
+
 	delete occupancyGrid_;
 
 #ifdef WITH_OCTOMAP_MSGS
 #ifdef RTABMAP_OCTOMAP
+	delete octomapClouds_;
 	if(octomap_)
 	{
 		delete octomap_;
@@ -321,9 +660,14 @@ void MapsManager::setParameters(const rtabmap::ParametersMap & parameters)
 {
 	parameters_ = parameters;
 	occupancyGrid_->parseParameters(parameters_);
+	if(localGridWorkers_)
+	{
+		localGridWorkers_->setParameters(parameters_);
+	}
 
 #ifdef WITH_OCTOMAP_MSGS
 #ifdef RTABMAP_OCTOMAP
+	octomapClouds_->clear();
 	if(octomap_)
 	{
 		delete octomap_;
@@ -394,9 +738,16 @@ void MapsManager::clear()
 	assembledObstacleIndex_.release();
 	groundClouds_.clear();
 	obstacleClouds_.clear();
+	assembledGroundSegments_.clear();
+	assembledObstacleSegments_.clear();
+	assembledGroundVoxels_.clear();
+	assembledObstacleVoxels_.clear();
+	temporaryGroundSegments_.clear();
+	temporaryObstacleSegments_.clear();
 	occupancyGrid_->clear();
 #ifdef WITH_OCTOMAP_MSGS
 #ifdef RTABMAP_OCTOMAP
+	octomapClouds_->clear();
 	octomap_->clear();
 #endif
 #endif
@@ -404,11 +755,18 @@ void MapsManager::clear()
 	{
 		iter->second = false;
 	}
+	gridMapPublished_ = cv::Mat();
+}
+
+void MapsManager::gridMapSubscriberConnected(const ros::SingleSubscriberPublisher &)
+{
+	gridMapNewSubscriber_ = true;
 }
 
 bool MapsManager::hasSubscribers() const
 {
-	return  cloudMapPub_.getNumSubscribers() != 0 ||
+	return  gridRequired_ ||
+			cloudMapPub_.getNumSubscribers() != 0 ||
 			cloudObstaclesPub_.getNumSubscribers() != 0 ||
 			cloudGroundPub_.getNumSubscribers() != 0 ||
 			projMapPub_.getNumSubscribers() != 0 ||
@@ -436,6 +794,203 @@ std::map<int, Transform> MapsManager::getFilteredPoses(const std::map<int, Trans
 	return std::map<int, Transform>();
 }
 
+std::set<int> MapsManager::getCachedNodes() const
+{
+	std::set<int> ids;
+	for(std::map<int, std::pair<std::pair<cv::Mat, cv::Mat>, cv::Mat> >::const_iterator iter=gridMaps_.begin(); iter!=gridMaps_.end(); ++iter)
+	{
+		ids.insert(ids.end(), iter->first);
+	}
+	return ids;
+}
+
+std::map<int, rtabmap::Signature> MapsManager::loadNodesData(
+		const std::set<int> & ids,
+		const rtabmap::Memory * memory,
+		bool gridFromDepth)
+{
+	std::map<int, rtabmap::Signature> signatures;
+	if(memory)
+	{
+		bool occupancySavedInDB = uStrNumCmp(memory->getDatabaseVersion(), "0.11.10")>=0?true:false;
+		for(std::set<int>::const_iterator iter=ids.begin(); iter!=ids.end(); ++iter)
+		{
+			if(*iter > 0)
+			{
+				SensorData data = memory->getNodeData(*iter, gridFromDepth && !occupancySavedInDB, !gridFromDepth && !occupancySavedInDB, false, true);
+				if(occupancySavedInDB && data.gridCellSize() == 0.0f)
+				{
+					// old nodes without occupancy grid, load raw data to regenerate it (see updateMapCaches())
+					data = memory->getNodeData(*iter, gridFromDepth, !gridFromDepth, false, false);
+				}
+				signatures.insert(std::make_pair(*iter, Signature(data)));
+			}
+		}
+	}
+	return signatures;
+}
+
+struct LocalGridJob
+{
+	int id;
+	Transform pose;
+	SensorData data;
+	cv::Mat ground;
+	cv::Mat obstacles;
+	cv::Mat emptyCells;
+	cv::Point3f viewPoint;
+};
+
+// Decompress data and create the local grid of the job
+static void createLocalGrid(const OccupancyGrid * occupancyGrid, LocalGridJob & job)
+{
+	cv::Mat rgb, depth;
+	LaserScan scan;
+	bool generateGrid = job.data.gridCellSize() == 0.0f;
+	job.data.uncompressData(
+			occupancyGrid->isGridFromDepth() && generateGrid?&rgb:0,
+			occupancyGrid->isGridFromDepth() && generateGrid?&depth:0,
+			!occupancyGrid->isGridFromDepth() && generateGrid?&scan:0,
+			0,
+			generateGrid?0:&job.ground,
+			generateGrid?0:&job.obstacles,
+			generateGrid?0:&job.emptyCells);
+	if(generateGrid)
+	{
+		Signature tmp(job.data);
+		tmp.setPose(job.pose);
+		occupancyGrid->createLocalMap(tmp, job.ground, job.obstacles, job.emptyCells, job.viewPoint);
+	}
+	else
+	{
+		job.viewPoint = job.data.gridViewPoint();
+	}
+	// raw data not needed anymore
+	job.data = SensorData();
+}
+
+// Threads created on the first update needing them and kept alive until
+// MapsManager is destroyed. process() hands them the jobs of an update and
+// returns when all local grids are created. Each thread creates the local
+// grids with its own OccupancyGrid set with the parameters of MapsManager.
+class MapsManager::LocalGridWorkers
+{
+public:
+	LocalGridWorkers(int threads, const ParametersMap & parameters) :
+		running_(true),
+		parameters_(parameters),
+		parametersVersion_(0),
+		jobs_(0),
+		nextJob_(0),
+		pendingJobs_(0)
+	{
+		for(int i=0; i<threads; ++i)
+		{
+			threads_.create_thread(boost::bind(&LocalGridWorkers::mainLoop, this));
+		}
+	}
+	~LocalGridWorkers()
+	{
+		{
+			boost::mutex::scoped_lock lock(mutex_);
+			running_ = false;
+		}
+		jobsCondition_.notify_all();
+		threads_.join_all();
+	}
+
+	int size() const {return (int)threads_.size();}
+
+	// The threads update their OccupancyGrid before their next job
+	void setParameters(const ParametersMap & parameters)
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		parameters_ = parameters;
+		++parametersVersion_;
+	}
+
+	void process(std::vector<LocalGridJob> & jobs)
+	{
+		boost::mutex::scoped_lock lock(mutex_);
+		jobs_ = &jobs;
+		nextJob_ = 0;
+		pendingJobs_ = (int)jobs.size();
+		jobsCondition_.notify_all();
+		while(pendingJobs_ > 0)
+		{
+			doneCondition_.wait(lock);
+		}
+		jobs_ = 0;
+	}
+
+private:
+	void mainLoop()
+	{
+		OccupancyGrid occupancyGrid;
+		int version = -1;
+		boost::mutex::scoped_lock lock(mutex_);
+		while(true)
+		{
+			while(running_ && (jobs_ == 0 || nextJob_ >= (int)jobs_->size()))
+			{
+				jobsCondition_.wait(lock);
+			}
+			if(!running_)
+			{
+				return;
+			}
+			LocalGridJob & job = jobs_->at(nextJob_++);
+			ParametersMap parameters;
+			if(version != parametersVersion_)
+			{
+				parameters = parameters_;
+				version = parametersVersion_;
+			}
+			lock.unlock();
+			if(!parameters.empty())
+			{
+				occupancyGrid.parseParameters(parameters);
+			}
+			createLocalGrid(&occupancyGrid, job);
+			lock.lock();
+			if(--pendingJobs_ == 0)
+			{
+				doneCondition_.notify_all();
+			}
+		}
+	}
+
+private:
+	boost::thread_group threads_;
+	boost::mutex mutex_;
+	boost::condition_variable jobsCondition_;
+	boost::condition_variable doneCondition_;
+	bool running_;
+	ParametersMap parameters_;
+	int parametersVersion_;
+	std::vector<LocalGridJob> * jobs_;
+	int nextJob_;
+	int pendingJobs_;
+};
+
+static void warnOccupancyGridRegenerated(int id)
+{
+	static bool warningShown = false;
+	if(!warningShown)
+	{
+		warningShown = true;
+		UWARN("Occupancy grid for location %d should be added to global map (e..g, a ROS node is subscribed to "
+				"any occupancy grid output) but it cannot be found "
+				"in memory. For convenience, the occupancy "
+				"grid is regenerated. Make sure parameter \"%s\" is true to "
+				"avoid this warning for the next locations added to map. For older "
+				"locations already in database without an occupancy grid map, you can use the "
+				"\"rtabmap-databaseViewer\" to regenerate the missing occupancy grid maps and "
+				"save them back in the database for next sessions. This warning is only shown once.",
+				id, Parameters::kRGBDCreateOccupancyGrid().c_str());
+	}
+}
+
 std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 		const std::map<int, rtabmap::Transform> & posesIn,
 		const rtabmap::Memory * memory,
@@ -457,7 +1012,8 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 				octoMapEmptySpace_.getNumSubscribers() != 0 ||
 				octoMapProj_.getNumSubscribers() != 0;
 
-		updateGrid = projMapPub_.getNumSubscribers() != 0 ||
+		updateGrid = gridRequired_ ||
+				projMapPub_.getNumSubscribers() != 0 ||
 				gridMapPub_.getNumSubscribers() != 0 ||
 				gridProbMapPub_.getNumSubscribers() != 0;
 
@@ -481,12 +1037,6 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 
 	UDEBUG("Updating map caches...");
 
-	if(!memory && signatures.size() == 0)
-	{
-		ROS_ERROR("Memory and signatures should not be both null!?");
-		return std::map<int, rtabmap::Transform>();
-	}
-
 	// process only nodes (exclude landmarks)
 	std::map<int, rtabmap::Transform> poses;
 	if(posesIn.begin()->first < 0)
@@ -545,6 +1095,76 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 		}
 
 		bool occupancySavedInDB = memory && uStrNumCmp(memory->getDatabaseVersion(), "0.11.10")>=0?true:false;
+		std::set<int> octomapCachedIds; // nodes added to octomap's cache
+
+		if(mapCacheThreads_ > 1)
+		{
+			// Load data of nodes not in cache, then create their local grids in parallel.
+			// Memory is accessed only from this thread.
+			std::vector<LocalGridJob> jobs;
+			for(std::map<int, rtabmap::Transform>::iterator iter=filteredPoses.lower_bound(1); iter!=filteredPoses.end(); ++iter)
+			{
+				if(!iter->second.isNull() && !uContains(gridMaps_, iter->first))
+				{
+					LocalGridJob job;
+					job.id = iter->first;
+					job.pose = iter->second;
+					std::map<int, rtabmap::Signature>::const_iterator findIter = signatures.find(iter->first);
+					if(findIter != signatures.end())
+					{
+						job.data = findIter->second.sensorData();
+						if(occupancySavedInDB && job.data.gridCellSize() == 0.0f)
+						{
+							warnOccupancyGridRegenerated(iter->first);
+							if(memory)
+							{
+								// old nodes without occupancy grid, reload raw data (like the serial path below)
+								job.data = memory->getNodeData(iter->first, occupancyGrid_->isGridFromDepth(), !occupancyGrid_->isGridFromDepth(), false, false);
+							}
+						}
+					}
+					else if(memory)
+					{
+						job.data = memory->getNodeData(iter->first, occupancyGrid_->isGridFromDepth() && !occupancySavedInDB, !occupancyGrid_->isGridFromDepth() && !occupancySavedInDB, false, true);
+						if(occupancySavedInDB && job.data.gridCellSize() == 0.0f)
+						{
+							warnOccupancyGridRegenerated(iter->first);
+							// old nodes without occupancy grid, reload raw data
+							job.data = memory->getNodeData(iter->first, occupancyGrid_->isGridFromDepth(), !occupancyGrid_->isGridFromDepth(), false, false);
+						}
+					}
+					else
+					{
+						continue;
+					}
+					jobs.push_back(job);
+				}
+			}
+
+			if(jobs.size())
+			{
+				UTimer timer;
+				int threads = std::min(mapCacheThreads_, (int)jobs.size());
+				if(threads > 1)
+				{
+					if(localGridWorkers_ == 0)
+					{
+						localGridWorkers_ = new LocalGridWorkers(mapCacheThreads_, parameters_);
+					}
+					localGridWorkers_->process(jobs);
+				}
+				else
+				{
+					createLocalGrid(occupancyGrid_, jobs.front());
+				}
+				for(std::vector<LocalGridJob>::iterator iter=jobs.begin(); iter!=jobs.end(); ++iter)
+				{
+					uInsert(gridMaps_, std::make_pair(iter->id, std::make_pair(std::make_pair(iter->ground, iter->obstacles), iter->emptyCells)));
+					uInsert(gridMapsViewpoints_, std::make_pair(iter->id, iter->viewPoint));
+				}
+				ROS_DEBUG("Created %d local grids with %d threads (%fs)", (int)jobs.size(), threads, timer.ticks());
+			}
+		}
 
 		for(std::map<int, rtabmap::Transform>::iterator iter=filteredPoses.begin(); iter!=filteredPoses.end(); ++iter)
 		{
@@ -563,6 +1183,13 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 					{
 						data = memory->getNodeData(iter->first, occupancyGrid_->isGridFromDepth() && !occupancySavedInDB, !occupancyGrid_->isGridFromDepth() && !occupancySavedInDB, false, true);
 					}
+					else
+					{
+						// No memory access (asynchronous update), data of this node
+						// has not been loaded yet, it will be added on a next update.
+						ROS_DEBUG("No data for node %d, skipping it for this update...", iter->first);
+						continue;
+					}
 
 					ROS_DEBUG("Adding grid map %d to cache...", iter->first);
 					cv::Point3f viewPoint;
@@ -572,19 +1199,9 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 						cv::Mat rgb, depth;
 						LaserScan scan;
 						bool generateGrid = data.gridCellSize() == 0.0f;
-						static bool warningShown = false;
-						if(occupancySavedInDB && generateGrid && !warningShown)
+						if(occupancySavedInDB && generateGrid)
 						{
-							warningShown = true;
-							UWARN("Occupancy grid for location %d should be added to global map (e..g, a ROS node is subscribed to "
-									"any occupancy grid output) but it cannot be found "
-									"in memory. For convenience, the occupancy "
-									"grid is regenerated. Make sure parameter \"%s\" is true to "
-									"avoid this warning for the next locations added to map. For older "
-									"locations already in database without an occupancy grid map, you can use the "
-									"\"rtabmap-databaseViewer\" to regenerate the missing occupancy grid maps and "
-									"save them back in the database for next sessions. This warning is only shown once.",
-									data.id(), Parameters::kRGBDCreateOccupancyGrid().c_str());
+							warnOccupancyGridRegenerated(data.id());
 						}
 						if(memory && occupancySavedInDB && generateGrid)
 						{
@@ -696,6 +1313,7 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 						   (mter->second.second.empty() || mter->second.second.channels() > 2))
 						{
 							octomap_->addToCache(iter->first, mter->second.first.first, mter->second.first.second, mter->second.second, pter->second);
+							octomapCachedIds.insert(iter->first);
 						}
 						else if(!mter->second.first.first.empty() && !mter->second.first.second.empty() && !mter->second.second.empty())
 						{
@@ -726,6 +1344,17 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 		{
 			UTimer time;
 			octomapUpdated_ = octomap_->update(filteredPoses);
+			for(std::set<int>::iterator iter=octomapCachedIds.begin(); iter!=octomapCachedIds.end(); ++iter)
+			{
+				std::map<int, Transform>::const_iterator jter = octomap_->addedNodes().find(*iter);
+				std::map<int, std::pair<std::pair<cv::Mat, cv::Mat>, cv::Mat> >::iterator mter = gridMaps_.find(*iter);
+				if(jter != octomap_->addedNodes().end() && mter != gridMaps_.end())
+				{
+					octomapClouds_->touch(mter->second.first.first, jter->second);
+					octomapClouds_->touch(mter->second.first.second, jter->second);
+					octomapClouds_->touch(mter->second.second, jter->second);
+				}
+			}
 			ROS_INFO("Octomap update time = %fs", time.ticks());
 		}
 #endif
@@ -733,7 +1362,8 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 		for(std::map<int, std::pair<std::pair<cv::Mat, cv::Mat>, cv::Mat> >::iterator iter=gridMaps_.begin();
 			iter!=gridMaps_.end();)
 		{
-			if(!uContains(poses, iter->first))
+			if(!uContains(poses, iter->first) ||
+			   (gridCacheFiltered_ && !uContains(filteredPoses, iter->first)))
 			{
 				UASSERT(gridMapsViewpoints_.erase(iter->first) != 0);
 				gridMaps_.erase(iter++);
@@ -749,6 +1379,15 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 		{
 			if(!uContains(poses, iter->first))
 			{
+				std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::iterator jter = assembledGroundSegments_.find(iter->first);
+				if(jter != assembledGroundSegments_.end())
+				{
+					if(cloudOutputVoxelized_)
+					{
+						assembledGroundVoxels_.remove(*jter->second);
+					}
+					assembledGroundSegments_.erase(jter);
+				}
 				groundClouds_.erase(iter++);
 			}
 			else
@@ -762,6 +1401,15 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 		{
 			if(!uContains(poses, iter->first))
 			{
+				std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::iterator jter = assembledObstacleSegments_.find(iter->first);
+				if(jter != assembledObstacleSegments_.end())
+				{
+					if(cloudOutputVoxelized_)
+					{
+						assembledObstacleVoxels_.remove(*jter->second);
+					}
+					assembledObstacleSegments_.erase(jter);
+				}
 				obstacleClouds_.erase(iter++);
 			}
 			else
@@ -779,7 +1427,7 @@ std::map<int, rtabmap::Transform> MapsManager::updateMapCaches(
 	return filteredPoses;
 }
 
-pcl::PointCloud<pcl::PointXYZRGB>::Ptr subtractFiltering(
+static pcl::PointCloud<pcl::PointXYZRGB>::Ptr subtractFiltering(
 		const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloud,
 		const rtabmap::FlannIndex & substractCloudIndex,
 		float radiusSearch,
@@ -806,6 +1454,228 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr subtractFiltering(
 	return output;
 }
 
+static void eraseSegment(
+		int id,
+		std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > & segments,
+		MapsManager::VoxelCloud * voxels)
+{
+	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::iterator iter = segments.find(id);
+	if(iter != segments.end())
+	{
+		if(voxels)
+		{
+			voxels->remove(*iter->second);
+		}
+		segments.erase(iter);
+	}
+}
+
+// Re-transform only the cached clouds of the nodes that moved more than the
+// update error. Nodes not in the graph anymore are removed. If set, the voxels
+// are updated with the segments changed. Returns the number of segments updated.
+static int updateAssembledSegments(
+		const std::map<int, rtabmap::Transform> & poses,
+		float updateErrorSqr,
+		const std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > & localClouds,
+		std::map<int, rtabmap::Transform> & assembledPoses,
+		std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > & segments,
+		MapsManager::VoxelCloud * voxels)
+{
+	for(std::map<int, rtabmap::Transform>::iterator iter=assembledPoses.begin(); iter!=assembledPoses.end();)
+	{
+		if(!uContains(poses, iter->first))
+		{
+			eraseSegment(iter->first, segments, voxels);
+			assembledPoses.erase(iter++);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	int updated = 0;
+	for(std::map<int, rtabmap::Transform>::const_iterator iter=poses.lower_bound(1); iter!=poses.end(); ++iter)
+	{
+		std::map<int, rtabmap::Transform>::iterator jter = assembledPoses.find(iter->first);
+		if(jter != assembledPoses.end() && iter->second.getDistanceSquared(jter->second) > updateErrorSqr)
+		{
+			jter->second = iter->second;
+			eraseSegment(iter->first, segments, voxels);
+			std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::const_iterator kter = localClouds.find(iter->first);
+			if(kter != localClouds.end() && kter->second->size())
+			{
+				pcl::PointCloud<pcl::PointXYZRGB>::Ptr segment = util3d::transformPointCloud(kter->second, iter->second);
+				segments.insert(std::make_pair(iter->first, segment));
+				if(voxels)
+				{
+					voxels->add(*segment);
+				}
+				++updated;
+			}
+		}
+	}
+	return updated;
+}
+
+static void assembleSegments(
+		const std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > & segments,
+		pcl::PointCloud<pcl::PointXYZRGB> & output)
+{
+	size_t totalSize = 0;
+	for(std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::const_iterator iter=segments.begin(); iter!=segments.end(); ++iter)
+	{
+		totalSize += iter->second->size();
+	}
+	output.clear();
+	output.reserve(totalSize);
+	for(std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::const_iterator iter=segments.begin(); iter!=segments.end(); ++iter)
+	{
+		output += *iter->second;
+	}
+}
+
+// Index of the points of the segments (not the voxel centroids when
+// cloud_output_voxelized is true), as done incrementally for subtract filtering.
+static void buildCloudIndex(
+		const std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > & segments,
+		rtabmap::FlannIndex & index)
+{
+	index.release();
+	size_t totalSize = 0;
+	for(std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::const_iterator iter=segments.begin(); iter!=segments.end(); ++iter)
+	{
+		totalSize += iter->second->size();
+	}
+	if(totalSize)
+	{
+		cv::Mat pts(totalSize, 3, CV_32FC1);
+		int i = 0;
+		for(std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::const_iterator iter=segments.begin(); iter!=segments.end(); ++iter)
+		{
+			for(size_t j=0; j<iter->second->size(); ++j, ++i)
+			{
+				pts.at<float>(i, 0) = iter->second->at(j).x;
+				pts.at<float>(i, 1) = iter->second->at(j).y;
+				pts.at<float>(i, 2) = iter->second->at(j).z;
+			}
+		}
+		index.buildKDTreeSingleIndex(pts, 15);
+	}
+}
+
+void MapsManager::VoxelCloud::setCellSize(float cellSize)
+{
+	if(cellSize != cellSize_)
+	{
+		clear();
+		cellSize_ = cellSize;
+	}
+}
+
+// 21 bits per axis. Returns false if the point is too far from the
+// origin, its key would alias another voxel.
+bool MapsManager::VoxelCloud::key(const pcl::PointXYZRGB & pt, std::uint64_t & k) const
+{
+	const double half = 1<<20;
+	double x = std::floor(double(pt.x)/cellSize_);
+	double y = std::floor(double(pt.y)/cellSize_);
+	double z = std::floor(double(pt.z)/cellSize_);
+	if(!(x >= -half && x < half && y >= -half && y < half && z >= -half && z < half))
+	{
+		ROS_WARN_THROTTLE(10, "MapsManager: point (%f,%f,%f) is too far from the origin to be voxelized "
+				"with cell size %f, it is ignored in the voxelized clouds.", pt.x, pt.y, pt.z, cellSize_);
+		return false;
+	}
+	k = (static_cast<std::uint64_t>(x + half)<<42) |
+		(static_cast<std::uint64_t>(y + half)<<21) |
+		static_cast<std::uint64_t>(z + half);
+	return true;
+}
+
+void MapsManager::VoxelCloud::add(const pcl::PointCloud<pcl::PointXYZRGB> & cloud)
+{
+	UASSERT(cellSize_ > 0.0f);
+	for(size_t i=0; i<cloud.size(); ++i)
+	{
+		const pcl::PointXYZRGB & pt = cloud.at(i);
+		std::uint64_t k;
+		if(!std::isfinite(pt.x) || !std::isfinite(pt.y) || !std::isfinite(pt.z) || !key(pt, k))
+		{
+			continue;
+		}
+		Voxel & v = voxels_[k];
+		v.x += pt.x;
+		v.y += pt.y;
+		v.z += pt.z;
+		v.r += pt.r;
+		v.g += pt.g;
+		v.b += pt.b;
+		++v.count;
+	}
+	modified_ = modified_ || cloud.size();
+}
+
+void MapsManager::VoxelCloud::remove(const pcl::PointCloud<pcl::PointXYZRGB> & cloud)
+{
+	for(size_t i=0; i<cloud.size(); ++i)
+	{
+		const pcl::PointXYZRGB & pt = cloud.at(i);
+		std::uint64_t k;
+		if(!std::isfinite(pt.x) || !std::isfinite(pt.y) || !std::isfinite(pt.z) || !key(pt, k))
+		{
+			continue;
+		}
+		std::unordered_map<std::uint64_t, Voxel>::iterator iter = voxels_.find(k);
+		if(iter == voxels_.end())
+		{
+			continue;
+		}
+		Voxel & v = iter->second;
+		if(--v.count <= 0)
+		{
+			voxels_.erase(iter);
+		}
+		else
+		{
+			v.x -= pt.x;
+			v.y -= pt.y;
+			v.z -= pt.z;
+			v.r -= std::min(v.r, (unsigned int)pt.r);
+			v.g -= std::min(v.g, (unsigned int)pt.g);
+			v.b -= std::min(v.b, (unsigned int)pt.b);
+		}
+	}
+	modified_ = modified_ || cloud.size();
+}
+
+void MapsManager::VoxelCloud::clear()
+{
+	modified_ = modified_ || !voxels_.empty();
+	voxels_.clear();
+}
+
+void MapsManager::VoxelCloud::toCloud(pcl::PointCloud<pcl::PointXYZRGB> & output)
+{
+	output.resize(voxels_.size());
+	size_t i = 0;
+	for(std::unordered_map<std::uint64_t, Voxel>::const_iterator iter=voxels_.begin(); iter!=voxels_.end(); ++iter, ++i)
+	{
+		const Voxel & v = iter->second;
+		pcl::PointXYZRGB & pt = output.at(i);
+		pt.x = v.x/v.count;
+		pt.y = v.y/v.count;
+		pt.z = v.z/v.count;
+		pt.r = v.r/v.count;
+		pt.g = v.g/v.count;
+		pt.b = v.b/v.count;
+	}
+	output.width = output.size();
+	output.height = 1;
+	output.is_dense = true;
+	modified_ = false;
+}
+
 void MapsManager::publishMaps(
 		const std::map<int, rtabmap::Transform> & poses,
 		const ros::Time & stamp,
@@ -851,6 +1721,27 @@ void MapsManager::publishMaps(
 		bool graphGroundChanged = updateGround;
 		bool graphObstacleChanged = updateObstacles;
 		float updateErrorSqr = occupancyGrid_->getUpdateError()*occupancyGrid_->getUpdateError();
+		bool regenerateVoxels = false;
+		if(cloudOutputVoxelized_)
+		{
+			UASSERT(occupancyGrid_->getCellSize() > 0.0);
+			// clouds of the nodes not yet in the graph are added again below
+			for(size_t i=0; i<temporaryGroundSegments_.size(); ++i)
+			{
+				assembledGroundVoxels_.remove(*temporaryGroundSegments_[i]);
+			}
+			for(size_t i=0; i<temporaryObstacleSegments_.size(); ++i)
+			{
+				assembledObstacleVoxels_.remove(*temporaryObstacleSegments_[i]);
+			}
+			temporaryGroundSegments_.clear();
+			temporaryObstacleSegments_.clear();
+			regenerateVoxels =
+					assembledGroundVoxels_.cellSize() != occupancyGrid_->getCellSize() ||
+					assembledObstacleVoxels_.cellSize() != occupancyGrid_->getCellSize();
+			assembledGroundVoxels_.setCellSize(occupancyGrid_->getCellSize());
+			assembledObstacleVoxels_.setCellSize(occupancyGrid_->getCellSize());
+		}
 		for(std::map<int, Transform>::const_iterator iter=poses.lower_bound(1); iter!=poses.end(); ++iter)
 		{
 			std::map<int, Transform>::const_iterator jter;
@@ -883,106 +1774,71 @@ void MapsManager::publishMaps(
 		}
 		int countObstacles = 0;
 		int countGrounds = 0;
-		int previousIndexedGroundSize = assembledGroundIndex_.indexedFeatures();
-		int previousIndexedObstacleSize = assembledObstacleIndex_.indexedFeatures();
-		if(graphGroundOptimized || graphGroundChanged)
+		if(graphGroundChanged || regenerateVoxels)
 		{
-			int previousSize = assembledGround_->size();
 			assembledGround_->clear();
-			assembledGround_->reserve(previousSize);
 			assembledGroundPoses_.clear();
+			assembledGroundSegments_.clear();
+			assembledGroundVoxels_.clear();
 			assembledGroundIndex_.release();
 		}
-		if(graphObstacleOptimized || graphObstacleChanged )
+		if(graphObstacleChanged || regenerateVoxels)
 		{
-			int previousSize = assembledObstacles_->size();
 			assembledObstacles_->clear();
-			assembledObstacles_->reserve(previousSize);
 			assembledObstaclePoses_.clear();
+			assembledObstacleSegments_.clear();
+			assembledObstacleVoxels_.clear();
 			assembledObstacleIndex_.release();
 		}
+		VoxelCloud * groundVoxels = cloudOutputVoxelized_?&assembledGroundVoxels_:0;
+		VoxelCloud * obstacleVoxels = cloudOutputVoxelized_?&assembledObstacleVoxels_:0;
 
 		if(graphGroundOptimized || graphObstacleOptimized)
 		{
 			ROS_INFO("Graph has changed, updating clouds...");
 			UTimer t;
-			cv::Mat tmpGroundPts;
-			cv::Mat tmpObstaclePts;
-			for(std::map<int, Transform>::const_iterator iter = poses.lower_bound(1); iter!=poses.end(); ++iter)
+			if(graphGroundOptimized)
 			{
-				if(updateGround  &&
-				   (graphGroundOptimized || assembledGroundPoses_.find(iter->first) == assembledGroundPoses_.end()))
+				countGrounds = updateAssembledSegments(poses, updateErrorSqr, groundClouds_, assembledGroundPoses_, assembledGroundSegments_, groundVoxels);
+				if(groundVoxels)
 				{
-					std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::iterator kter=groundClouds_.find(iter->first);
-					if(kter != groundClouds_.end() && kter->second->size())
-					{
-						assembledGroundPoses_.insert(*iter);
-						pcl::PointCloud<pcl::PointXYZRGB>::Ptr transformed = util3d::transformPointCloud(kter->second, iter->second);
-						*assembledGround_+=*transformed;
-						if(cloudSubtractFiltering_)
-						{
-							for(unsigned int i=0; i<transformed->size(); ++i)
-							{
-								if(tmpGroundPts.empty())
-								{
-									tmpGroundPts = (cv::Mat_<float>(1, 3) << transformed->at(i).x, transformed->at(i).y, transformed->at(i).z);
-									tmpGroundPts.reserve(previousIndexedGroundSize>0?previousIndexedGroundSize:100);
-								}
-								else
-								{
-									cv::Mat pt = (cv::Mat_<float>(1, 3) << transformed->at(i).x, transformed->at(i).y, transformed->at(i).z);
-									tmpGroundPts.push_back(pt);
-								}
-							}
-						}
-						++countGrounds;
-					}
+					groundVoxels->toCloud(*assembledGround_);
 				}
-				if(updateObstacles  &&
-				   (graphObstacleOptimized || assembledObstaclePoses_.find(iter->first) == assembledObstaclePoses_.end()))
+				else
 				{
-					std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::iterator kter=obstacleClouds_.find(iter->first);
-					if(kter != obstacleClouds_.end() && kter->second->size())
-					{
-						assembledObstaclePoses_.insert(*iter);
-						pcl::PointCloud<pcl::PointXYZRGB>::Ptr transformed = util3d::transformPointCloud(kter->second, iter->second);
-						*assembledObstacles_+=*transformed;
-						if(cloudSubtractFiltering_)
-						{
-							for(unsigned int i=0; i<transformed->size(); ++i)
-							{
-								if(tmpObstaclePts.empty())
-								{
-									tmpObstaclePts = (cv::Mat_<float>(1, 3) << transformed->at(i).x, transformed->at(i).y, transformed->at(i).z);
-									tmpObstaclePts.reserve(previousIndexedObstacleSize>0?previousIndexedObstacleSize:100);
-								}
-								else
-								{
-									cv::Mat pt = (cv::Mat_<float>(1, 3) << transformed->at(i).x, transformed->at(i).y, transformed->at(i).z);
-									tmpObstaclePts.push_back(pt);
-								}
-							}
-						}
-						++countObstacles;
-					}
-					else
-					{
-						std::map<int, std::pair<std::pair<cv::Mat, cv::Mat>, cv::Mat> >::iterator jter = gridMaps_.find(iter->first);
-					}
+					assembleSegments(assembledGroundSegments_, *assembledGround_);
 				}
 			}
-			double addingPointsTime = t.ticks();
-
-			if(graphGroundOptimized && !tmpGroundPts.empty())
+			if(graphObstacleOptimized)
 			{
-				assembledGroundIndex_.buildKDTreeSingleIndex(tmpGroundPts, 15);
+				countObstacles = updateAssembledSegments(poses, updateErrorSqr, obstacleClouds_, assembledObstaclePoses_, assembledObstacleSegments_, obstacleVoxels);
+				if(obstacleVoxels)
+				{
+					obstacleVoxels->toCloud(*assembledObstacles_);
+				}
+				else
+				{
+					assembleSegments(assembledObstacleSegments_, *assembledObstacles_);
+				}
 			}
-			if(graphObstacleOptimized && !tmpObstaclePts.empty())
+			double addingPointsTime = t.ticks();
+
+			if(cloudSubtractFiltering_)
 			{
-				assembledObstacleIndex_.buildKDTreeSingleIndex(tmpObstaclePts, 15);
+				if(graphGroundOptimized)
+				{
+					buildCloudIndex(assembledGroundSegments_, assembledGroundIndex_);
+				}
+				if(graphObstacleOptimized)
+				{
+					buildCloudIndex(assembledObstacleSegments_, assembledObstacleIndex_);
+				}
 			}
 			double indexingTime = t.ticks();
-			ROS_INFO("Graph optimized! Time recreating clouds (%d ground, %d obstacles) = %f s (indexing %fs)", countGrounds, countObstacles, addingPointsTime+indexingTime, indexingTime);
+			ROS_INFO("Graph optimized! Time updating clouds (%d/%d ground, %d/%d obstacles moved) = %f s (indexing %fs)",
+					countGrounds, (int)assembledGroundSegments_.size(),
+					countObstacles, (int)assembledObstacleSegments_.size(),
+					addingPointsTime+indexingTime, indexingTime);
 		}
 		else if(graphGroundChanged || graphObstacleChanged)
 		{
@@ -1031,10 +1887,26 @@ void MapsManager::publishMaps(
 					if(iter->first>0)
 					{
 						groundClouds_.insert(std::make_pair(iter->first, util3d::transformPointCloud(subtractedCloud, iter->second.inverse())));
+						if(subtractedCloud->size())
+						{
+							eraseSegment(iter->first, assembledGroundSegments_, groundVoxels);
+							assembledGroundSegments_.insert(std::make_pair(iter->first, subtractedCloud));
+						}
+					}
+					else if(groundVoxels && subtractedCloud->size())
+					{
+						temporaryGroundSegments_.push_back(subtractedCloud);
 					}
 					if(subtractedCloud->size())
 					{
-						*assembledGround_+=*subtractedCloud;
+						if(groundVoxels)
+						{
+							groundVoxels->add(*subtractedCloud);
+						}
+						else
+						{
+							*assembledGround_+=*subtractedCloud;
+						}
 					}
 					++countGrounds;
 				}
@@ -1078,26 +1950,45 @@ void MapsManager::publishMaps(
 					if(iter->first>0)
 					{
 						obstacleClouds_.insert(std::make_pair(iter->first, util3d::transformPointCloud(subtractedCloud, iter->second.inverse())));
+						if(subtractedCloud->size())
+						{
+							eraseSegment(iter->first, assembledObstacleSegments_, obstacleVoxels);
+							assembledObstacleSegments_.insert(std::make_pair(iter->first, subtractedCloud));
+						}
+					}
+					else if(obstacleVoxels && subtractedCloud->size())
+					{
+						temporaryObstacleSegments_.push_back(subtractedCloud);
 					}
 					if(subtractedCloud->size())
 					{
-						*assembledObstacles_+=*subtractedCloud;
+						if(obstacleVoxels)
+						{
+							obstacleVoxels->add(*subtractedCloud);
+						}
+						else
+						{
+							*assembledObstacles_+=*subtractedCloud;
+						}
 					}
 					++countObstacles;
 				}
 			}
 		}
 
+		bool voxelsModified = false;
 		if(cloudOutputVoxelized_)
 		{
-			UASSERT(occupancyGrid_->getCellSize() > 0.0);
-			if(countGrounds && assembledGround_->size())
+			// only the new or removed clouds have been voxelized
+			if(assembledGroundVoxels_.modified())
 			{
-				assembledGround_ = util3d::voxelize(assembledGround_, occupancyGrid_->getCellSize());
+				assembledGroundVoxels_.toCloud(*assembledGround_);
+				voxelsModified = true;
 			}
-			if(countObstacles && assembledObstacles_->size())
+			if(assembledObstacleVoxels_.modified())
 			{
-				assembledObstacles_ = util3d::voxelize(assembledObstacles_, occupancyGrid_->getCellSize());
+				assembledObstacleVoxels_.toCloud(*assembledObstacles_);
+				voxelsModified = true;
 			}
 		}
 
@@ -1106,6 +1997,7 @@ void MapsManager::publishMaps(
 
 		if( countGrounds > 0 ||
 			countObstacles > 0 ||
+			voxelsModified ||
 			!latching_ ||
 			(assembledGround_->empty() && assembledObstacles_->empty()) ||
 			(cloudGroundPub_.getNumSubscribers() && !latched_.at(&cloudGroundPub_)) ||
@@ -1165,6 +2057,14 @@ void MapsManager::publishMaps(
 			{
 				totalBytes += sizeof(int) + iter->second->points.size()*sizeof(pcl::PointXYZRGB);
 			}
+			for(std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::iterator iter=assembledGroundSegments_.begin();iter!=assembledGroundSegments_.end();++iter)
+			{
+				totalBytes += sizeof(int) + iter->second->points.size()*sizeof(pcl::PointXYZRGB);
+			}
+			for(std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr >::iterator iter=assembledObstacleSegments_.begin();iter!=assembledObstacleSegments_.end();++iter)
+			{
+				totalBytes += sizeof(int) + iter->second->points.size()*sizeof(pcl::PointXYZRGB);
+			}
 			totalBytes += (assembledGround_->size() + assembledObstacles_->size()) *sizeof(pcl::PointXYZRGB);
 			totalBytes += (assembledGroundPoses_.size() + assembledObstaclePoses_.size()) * 13*sizeof(float);
 			totalBytes += assembledGroundIndex_.indexedFeatures()*assembledGroundIndex_.featuresDim() * sizeof(float);
@@ -1182,6 +2082,12 @@ void MapsManager::publishMaps(
 		assembledObstacleIndex_.release();
 		groundClouds_.clear();
 		obstacleClouds_.clear();
+		assembledGroundSegments_.clear();
+		assembledObstacleSegments_.clear();
+		assembledGroundVoxels_.clear();
+		assembledObstacleVoxels_.clear();
+		temporaryGroundSegments_.clear();
+		temporaryObstacleSegments_.clear();
 	}
 	if(cloudMapPub_.getNumSubscribers() == 0)
 	{
@@ -1238,63 +2144,64 @@ void MapsManager::publishMaps(
 			octoMapEmptySpace_.getNumSubscribers())
 		{
 			sensor_msgs::PointCloud2 msg;
-			pcl::IndicesPtr obstacleIndices(new std::vector<int>);
-			pcl::IndicesPtr frontierIndices(new std::vector<int>);
-			pcl::IndicesPtr emptyIndices(new std::vector<int>);
-			pcl::IndicesPtr groundIndices(new std::vector<int>);
-			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = octomap_->createCloud(octomapTreeDepth_, obstacleIndices.get(), emptyIndices.get(), groundIndices.get(), true, frontierIndices.get(),0);
+			octomapClouds_->update(*octomap_, octomapTreeDepth_);
 
-			if(octoMapCloud_.getNumSubscribers())
+			// Publish only the clouds that changed, or to new subscribers
+			if(octoMapCloud_.getNumSubscribers() &&
+				(!latching_ || !latched_.at(&octoMapCloud_) ||
+				 octomapClouds_->modified(OctomapClouds::kObstacles) ||
+				 octomapClouds_->modified(OctomapClouds::kGround)))
 			{
-				pcl::PointCloud<pcl::PointXYZRGB> cloudOccupiedSpace;
-				pcl::IndicesPtr indices = util3d::concatenate(obstacleIndices, groundIndices);
-				pcl::copyPointCloud(*cloud, *indices, cloudOccupiedSpace);
+				pcl::PointCloud<pcl::PointXYZRGB> cloudOccupiedSpace = octomapClouds_->cloud(OctomapClouds::kObstacles);
+				cloudOccupiedSpace += octomapClouds_->cloud(OctomapClouds::kGround);
 				pcl::toROSMsg(cloudOccupiedSpace, msg);
 				msg.header.frame_id = mapFrameId;
 				msg.header.stamp = stamp;
 				octoMapCloud_.publish(msg);
 				latched_.at(&octoMapCloud_) = true;
 			}
-			if(octoMapFrontierCloud_.getNumSubscribers())
+			if(octoMapFrontierCloud_.getNumSubscribers() &&
+				(!latching_ || !latched_.at(&octoMapFrontierCloud_) || octomapClouds_->modified(OctomapClouds::kFrontier)))
 			{
-				pcl::PointCloud<pcl::PointXYZRGB> cloudFrontier;
-				pcl::copyPointCloud(*cloud, *frontierIndices, cloudFrontier);
-				pcl::toROSMsg(cloudFrontier, msg);
+				pcl::toROSMsg(octomapClouds_->cloud(OctomapClouds::kFrontier), msg);
 				msg.header.frame_id = mapFrameId;
 				msg.header.stamp = stamp;
 				octoMapFrontierCloud_.publish(msg);
 				latched_.at(&octoMapFrontierCloud_) = true;
 			}
-			if(octoMapObstacleCloud_.getNumSubscribers())
+			if(octoMapObstacleCloud_.getNumSubscribers() &&
+				(!latching_ || !latched_.at(&octoMapObstacleCloud_) || octomapClouds_->modified(OctomapClouds::kObstacles)))
 			{
-				pcl::PointCloud<pcl::PointXYZRGB> cloudObstacles;
-				pcl::copyPointCloud(*cloud, *obstacleIndices, cloudObstacles);
-				pcl::toROSMsg(cloudObstacles, msg);
+				pcl::toROSMsg(octomapClouds_->cloud(OctomapClouds::kObstacles), msg);
 				msg.header.frame_id = mapFrameId;
 				msg.header.stamp = stamp;
 				octoMapObstacleCloud_.publish(msg);
 				latched_.at(&octoMapObstacleCloud_) = true;
 			}
-			if(octoMapGroundCloud_.getNumSubscribers())
+			if(octoMapGroundCloud_.getNumSubscribers() &&
+				(!latching_ || !latched_.at(&octoMapGroundCloud_) || octomapClouds_->modified(OctomapClouds::kGround)))
 			{
-				pcl::PointCloud<pcl::PointXYZRGB> cloudGround;
-				pcl::copyPointCloud(*cloud, *groundIndices, cloudGround);
-				pcl::toROSMsg(cloudGround, msg);
+				pcl::toROSMsg(octomapClouds_->cloud(OctomapClouds::kGround), msg);
 				msg.header.frame_id = mapFrameId;
 				msg.header.stamp = stamp;
 				octoMapGroundCloud_.publish(msg);
 				latched_.at(&octoMapGroundCloud_) = true;
 			}
-			if(octoMapEmptySpace_.getNumSubscribers())
+			if(octoMapEmptySpace_.getNumSubscribers() &&
+				(!latching_ || !latched_.at(&octoMapEmptySpace_) || octomapClouds_->modified(OctomapClouds::kEmpty)))
 			{
-				pcl::PointCloud<pcl::PointXYZRGB> cloudEmptySpace;
-				pcl::copyPointCloud(*cloud, *emptyIndices, cloudEmptySpace);
-				pcl::toROSMsg(cloudEmptySpace, msg);
+				pcl::toROSMsg(octomapClouds_->cloud(OctomapClouds::kEmpty), msg);
 				msg.header.frame_id = mapFrameId;
 				msg.header.stamp = stamp;
 				octoMapEmptySpace_.publish(msg);
 				latched_.at(&octoMapEmptySpace_) = true;
 			}
+			octomapClouds_->resetModified();
+		}
+		else
+		{
+			// stop tracking octree changes
+			octomapClouds_->clear();
 		}
 		if(octoMapProj_.getNumSubscribers())
 		{
@@ -1356,6 +2263,7 @@ void MapsManager::publishMaps(
 					octomap_->octree()->getNumLeafNodes(),
 					octomap_->octree()->memoryUsage()/1048576);
 		}
+		octomapClouds_->clear();
 		octomap_->clear();
 	}
 
@@ -1466,37 +2374,110 @@ void MapsManager::publishMaps(
 
 			if(!pixels.empty())
 			{
-				//init
-				nav_msgs::OccupancyGrid map;
-				map.info.resolution = gridCellSize;
-				map.info.origin.position.x = 0.0;
-				map.info.origin.position.y = 0.0;
-				map.info.origin.position.z = 0.0;
-				map.info.origin.orientation.x = 0.0;
-				map.info.origin.orientation.y = 0.0;
-				map.info.origin.orientation.z = 0.0;
-				map.info.origin.orientation.w = 1.0;
-
-				map.info.width = pixels.cols;
-				map.info.height = pixels.rows;
-				map.info.origin.position.x = xMin;
-				map.info.origin.position.y = yMin;
-				map.data.resize(map.info.width * map.info.height);
-
-				memcpy(map.data.data(), pixels.data, map.info.width * map.info.height);
-
-				map.header.frame_id = mapFrameId;
-				map.header.stamp = stamp;
+				// Send only the changed cells if subscribers already have a
+				// grid with the same origin and size, otherwise the full map.
+				// All grid_map subscribers should also listen to the updates,
+				// and the full map is sent periodically in case some don't.
+				// A new subscriber may have received an older latched map, so
+				// the full map is sent after a connection.
+				bool sendUpdate = gridMapPub_.getNumSubscribers() &&
+						gridMapUpdates_ &&
+						gridMapUpdatesPub_.getNumSubscribers() >= gridMapPub_.getNumSubscribers() &&
+						(gridMapUpdatesKeyframe_ <= 0 || gridMapUpdatesSinceKeyframe_ < gridMapUpdatesKeyframe_) &&
+						latched_.at(&gridMapPub_) &&
+						!gridMapNewSubscriber_ &&
+						gridMapPublished_.cols == pixels.cols &&
+						gridMapPublished_.rows == pixels.rows &&
+						gridMapPublishedXMin_ == xMin &&
+						gridMapPublishedYMin_ == yMin &&
+						gridMapPublishedCellSize_ == gridCellSize;
+
+				if(sendUpdate)
+				{
+					// dirty bounding box
+					int minX = pixels.cols, minY = pixels.rows, maxX = -1, maxY = -1;
+					for(int y=0; y<pixels.rows; ++y)
+					{
+						const char * row = pixels.ptr<char>(y);
+						const char * rowPublished = gridMapPublished_.ptr<char>(y);
+						if(memcmp(row, rowPublished, pixels.cols) != 0)
+						{
+							int x=0;
+							while(row[x] == rowPublished[x]) ++x;
+							int xEnd=pixels.cols-1;
+							while(row[xEnd] == rowPublished[xEnd]) --xEnd;
+							minX = std::min(minX, x);
+							maxX = std::max(maxX, xEnd);
+							minY = std::min(minY, y);
+							maxY = y;
+						}
+					}
+					if(maxX >= 0)
+					{
+						map_msgs::OccupancyGridUpdate update;
+						update.header.frame_id = mapFrameId;
+						update.header.stamp = stamp;
+						update.x = minX;
+						update.y = minY;
+						update.width = maxX - minX + 1;
+						update.height = maxY - minY + 1;
+						update.data.resize(update.width * update.height);
+						for(unsigned int y=0; y<update.height; ++y)
+						{
+							memcpy(update.data.data() + y*update.width, pixels.ptr<char>(minY+y) + minX, update.width);
+						}
+						gridMapUpdatesPub_.publish(update);
+						++gridMapUpdatesSinceKeyframe_;
+						ROS_DEBUG("Published grid map update %dx%d at (%d,%d) (map is %dx%d)",
+								update.width, update.height, update.x, update.y, pixels.cols, pixels.rows);
+					}
+				}
 
-				if(gridMapPub_.getNumSubscribers())
+				if((gridMapPub_.getNumSubscribers() && !sendUpdate) || projMapPub_.getNumSubscribers())
 				{
-					gridMapPub_.publish(map);
-					latched_.at(&gridMapPub_) = true;
+					//init
+					nav_msgs::OccupancyGrid map;
+					map.info.resolution = gridCellSize;
+					map.info.origin.position.x = 0.0;
+					map.info.origin.position.y = 0.0;
+					map.info.origin.position.z = 0.0;
+					map.info.origin.orientation.x = 0.0;
+					map.info.origin.orientation.y = 0.0;
+					map.info.origin.orientation.z = 0.0;
+					map.info.origin.orientation.w = 1.0;
+
+					map.info.width = pixels.cols;
+					map.info.height = pixels.rows;
+					map.info.origin.position.x = xMin;
+					map.info.origin.position.y = yMin;
+					map.data.resize(map.info.width * map.info.height);
+
+					memcpy(map.data.data(), pixels.data, map.info.width * map.info.height);
+
+					map.header.frame_id = mapFrameId;
+					map.header.stamp = stamp;
+
+					if(gridMapPub_.getNumSubscribers() && !sendUpdate)
+					{
+						gridMapNewSubscriber_ = false;
+						gridMapPub_.publish(map);
+						latched_.at(&gridMapPub_) = true;
+						gridMapUpdatesSinceKeyframe_ = 0;
+					}
+					if(projMapPub_.getNumSubscribers())
+					{
+						projMapPub_.publish(map);
+						latched_.at(&projMapPub_) = true;
+					}
 				}
-				if(projMapPub_.getNumSubscribers())
+
+				if(gridMapPub_.getNumSubscribers() && gridMapUpdates_)
 				{
-					projMapPub_.publish(map);
-					latched_.at(&projMapPub_) = true;
+					// getGridMap() returns a new matrix on each call, no need to copy it
+					gridMapPublished_ = pixels;
+					gridMapPublishedXMin_ = xMin;
+					gridMapPublishedYMin_ = yMin;
+					gridMapPublishedCellSize_ = gridCellSize;
 				}
 			}
 			else if(poses.size())
@@ -1509,6 +2490,7 @@ void MapsManager::publishMaps(
 	if(gridMapPub_.getNumSubscribers() == 0)
 	{
 		latched_.at(&gridMapPub_) = false;
+		gridMapPublished_ = cv::Mat();
 	}
 	if(projMapPub_.getNumSubscribers() == 0)
 	{
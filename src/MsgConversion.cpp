@@ -42,8 +42,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <image_geometry/pinhole_camera_model.h>
 #include <image_geometry/stereo_camera_model.h>
 #include <sensor_msgs/image_encodings.h>
-#include <laser_geometry/laser_geometry.h>
 #include <rtabmap/core/util3d_surface.h>
+#include <rtabmap/core/util2d.h>
+#include <boost/thread/mutex.hpp>
+#include <limits>
 
 namespace rtabmap_ros {
 
@@ -154,7 +156,7 @@ void toCvCopy(const rtabmap_ros::RGBDImage & image, cv_bridge::CvImagePtr & rgb,
 	{
 		cv_bridge::CvImagePtr ptr = boost::make_shared<cv_bridge::CvImage>();
 		ptr->header = image.depth_compressed.header;
-		ptr->image = rtabmap::uncompressImage(image.depth_compressed.data);
+		ptr->image = uncompressDepth(image.depth_compressed);
 		ROS_ASSERT(ptr->image.empty() || ptr->image.type() == CV_32FC1 || ptr->image.type() == CV_16UC1);
 		ptr->encoding = ptr->image.empty()?"":ptr->image.type() == CV_32FC1?sensor_msgs::image_encodings::TYPE_32FC1:sensor_msgs::image_encodings::TYPE_16UC1;
 		depth = ptr;
@@ -199,7 +201,7 @@ void toCvShare(const rtabmap_ros::RGBDImage & image, const boost::shared_ptr<voi
 		{
 			cv_bridge::CvImagePtr ptr = boost::make_shared<cv_bridge::CvImage>();
 			ptr->header = image.depth_compressed.header;
-			ptr->image = rtabmap::uncompressImage(image.depth_compressed.data);
+			ptr->image = uncompressDepth(image.depth_compressed);
 			ROS_ASSERT(ptr->image.empty() || ptr->image.type() == CV_32FC1 || ptr->image.type() == CV_16UC1);
 			ptr->encoding = ptr->image.empty()?"":ptr->image.type() == CV_32FC1?sensor_msgs::image_encodings::TYPE_32FC1:sensor_msgs::image_encodings::TYPE_16UC1;
 			depth = ptr;
@@ -453,6 +455,194 @@ cv::Mat compressedMatFromBytes(const std::vector<unsigned char> & bytes, bool co
 	return out;
 }
 
+// RVL (run length / variable length) depth coding, see
+// "Fast Lossless Depth Image Compression", A. D. Wilson, 2017.
+// Layout: int32 rows, int32 cols, then 32 bits words of 4 bits nibbles.
+class RVLEncoder
+{
+public:
+	RVLEncoder(std::vector<unsigned char> & bytes) : bytes_(bytes), word_(0), nibbles_(0) {}
+	void encode(int value)
+	{
+		do
+		{
+			int nibble = value & 0x7; // lower 3 bits
+			if(value >>= 3)
+			{
+				nibble |= 0x8; // more to come
+			}
+			word_ <<= 4;
+			word_ |= nibble;
+			if(++nibbles_ == 8)
+			{
+				append();
+			}
+		}
+		while(value);
+	}
+	void flush()
+	{
+		if(nibbles_)
+		{
+			word_ <<= 4 * (8 - nibbles_);
+			append();
+		}
+	}
+private:
+	void append()
+	{
+		size_t size = bytes_.size();
+		bytes_.resize(size + sizeof(word_));
+		memcpy(bytes_.data()+size, &word_, sizeof(word_));
+		word_ = 0;
+		nibbles_ = 0;
+	}
+	std::vector<unsigned char> & bytes_;
+	unsigned int word_;
+	int nibbles_;
+};
+
+class RVLDecoder
+{
+public:
+	RVLDecoder(const unsigned char * data, size_t size) : data_(data), end_(data+size), word_(0), nibbles_(0) {}
+	bool decode(int & value)
+	{
+		unsigned int nibble;
+		int bits = 29;
+		value = 0;
+		do
+		{
+			if(!nibbles_)
+			{
+				if(data_ + sizeof(word_) > end_)
+				{
+					return false;
+				}
+				memcpy(&word_, data_, sizeof(word_));
+				data_ += sizeof(word_);
+				nibbles_ = 8;
+			}
+			nibble = word_ & 0xf0000000;
+			value |= (nibble << 1) >> bits;
+			word_ <<= 4;
+			--nibbles_;
+			bits -= 3;
+		}
+		while((nibble & 0x80000000) && bits >= 0);
+		return true;
+	}
+private:
+	const unsigned char * data_;
+	const unsigned char * end_;
+	unsigned int word_;
+	int nibbles_;
+};
+
+std::vector<unsigned char> compressDepthRVL(const cv::Mat & depth)
+{
+	std::vector<unsigned char> bytes;
+	if(depth.empty())
+	{
+		return bytes;
+	}
+	// converting float depth to mm would not be lossless
+	UASSERT_MSG(depth.type() == CV_16UC1, "RVL compression requires a 16UC1 depth image");
+	cv::Mat depth16U = depth;
+	if(!depth16U.isContinuous())
+	{
+		depth16U = depth16U.clone();
+	}
+
+	int size[2] = {depth16U.rows, depth16U.cols};
+	bytes.reserve(sizeof(size) + depth16U.total()*sizeof(unsigned short)/2);
+	bytes.resize(sizeof(size));
+	memcpy(bytes.data(), size, sizeof(size));
+
+	RVLEncoder encoder(bytes);
+	const unsigned short * input = depth16U.ptr<unsigned short>();
+	const unsigned short * end = input + depth16U.total();
+	int previous = 0;
+	while(input != end)
+	{
+		int zeros = 0;
+		for(; input != end && *input == 0; ++input, ++zeros);
+		encoder.encode(zeros);
+		int nonzeros = 0;
+		for(const unsigned short * p = input; p != end && *p != 0; ++p, ++nonzeros);
+		encoder.encode(nonzeros);
+		for(int i=0; i<nonzeros; ++i)
+		{
+			int current = *input++;
+			int delta = current - previous;
+			encoder.encode((delta << 1) ^ (delta >> 31)); // zigzag
+			previous = current;
+		}
+	}
+	encoder.flush();
+	return bytes;
+}
+
+cv::Mat uncompressDepthRVL(const std::vector<unsigned char> & bytes)
+{
+	int size[2] = {0, 0};
+	if(bytes.size() < sizeof(size))
+	{
+		return cv::Mat();
+	}
+	memcpy(size, bytes.data(), sizeof(size));
+	if(size[0] <= 0 || size[1] <= 0)
+	{
+		return cv::Mat();
+	}
+	cv::Mat depth(size[0], size[1], CV_16UC1);
+	RVLDecoder decoder(bytes.data()+sizeof(size), bytes.size()-sizeof(size));
+	unsigned short * output = depth.ptr<unsigned short>();
+	int remaining = (int)depth.total();
+	int previous = 0;
+	while(remaining > 0)
+	{
+		int zeros, nonzeros;
+		if(!decoder.decode(zeros) || zeros > remaining)
+		{
+			ROS_ERROR("Corrupted RVL depth image!");
+			return cv::Mat();
+		}
+		memset(output, 0, zeros*sizeof(unsigned short));
+		output += zeros;
+		remaining -= zeros;
+		if(!decoder.decode(nonzeros) || nonzeros > remaining)
+		{
+			ROS_ERROR("Corrupted RVL depth image!");
+			return cv::Mat();
+		}
+		for(int i=0; i<nonzeros; ++i)
+		{
+			int positive;
+			if(!decoder.decode(positive))
+			{
+				ROS_ERROR("Corrupted RVL depth image!");
+				return cv::Mat();
+			}
+			int delta = (positive >> 1) ^ -(positive & 1);
+			int current = previous + delta;
+			*output++ = (unsigned short)current;
+			previous = current;
+		}
+		remaining -= nonzeros;
+	}
+	return depth;
+}
+
+cv::Mat uncompressDepth(const sensor_msgs::CompressedImage & msg)
+{
+	if(msg.format.compare("rvl") == 0)
+	{
+		return uncompressDepthRVL(msg.data);
+	}
+	return rtabmap::uncompressImage(msg.data);
+}
+
 void infoFromROS(const rtabmap_ros::Info & info, rtabmap::Statistics & stat)
 {
 	stat.setExtended(true); // Extended
@@ -945,7 +1135,7 @@ rtabmap::StereoCameraModel stereoCameraModelFromROS(
 		const sensor_msgs::CameraInfo & leftCamInfo,
 		const sensor_msgs::CameraInfo & rightCamInfo,
 		const std::string & frameId,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform)
 {
 	rtabmap::Transform localTransform = getTransform(
@@ -988,6 +1178,27 @@ void mapDataFromROS(
 		signatures.insert(std::make_pair(msg.nodes[i].id, nodeDataFromROS(msg.nodes[i])));
 	}
 }
+bool mapDataDeltaFromROS(
+		const rtabmap_ros::MapData & msg,
+		std::map<int, rtabmap::Transform> & poses,
+		std::multimap<int, rtabmap::Link> & links,
+		std::map<int, rtabmap::Signature> & signatures,
+		rtabmap::Transform & mapToOdom,
+		unsigned int & graphId,
+		bool withData)
+{
+	if(!mapGraphDeltaFromROS(msg.graph, poses, links, mapToOdom, graphId))
+	{
+		return false;
+	}
+
+	//Data
+	for(unsigned int i=0; i<msg.nodes.size(); ++i)
+	{
+		signatures.insert(std::make_pair(msg.nodes[i].id, withData?nodeDataFromROS(msg.nodes[i]):nodeInfoFromROS(msg.nodes[i])));
+	}
+	return true;
+}
 void mapDataToROS(
 		const std::map<int, rtabmap::Transform> & poses,
 		const std::multimap<int, rtabmap::Link> & links,
@@ -1059,6 +1270,209 @@ void mapGraphToROS(
 	transformToGeometryMsg(mapToOdom, msg.mapToOdom);
 }
 
+// Link with the same nodes and type as "link", or links.end()
+static std::multimap<int, rtabmap::Link>::const_iterator findLink(const std::multimap<int, rtabmap::Link> & links, const rtabmap::Link & link)
+{
+	std::pair<std::multimap<int, rtabmap::Link>::const_iterator, std::multimap<int, rtabmap::Link>::const_iterator> range = links.equal_range(link.from());
+	for(std::multimap<int, rtabmap::Link>::const_iterator iter=range.first; iter!=range.second; ++iter)
+	{
+		if(iter->second.to() == link.to() && iter->second.type() == link.type())
+		{
+			return iter;
+		}
+	}
+	return links.end();
+}
+
+// Same nodes, type and transform
+static bool containsLink(const std::multimap<int, rtabmap::Link> & links, const rtabmap::Link & link)
+{
+	std::multimap<int, rtabmap::Link>::const_iterator iter = findLink(links, link);
+	return iter != links.end() && iter->second.transform() == link.transform();
+}
+
+// A new link replaces the link with the same nodes and type (e.g., refined transform)
+static void insertLinks(std::multimap<int, rtabmap::Link> & links, const std::multimap<int, rtabmap::Link> & newLinks)
+{
+	for(std::multimap<int, rtabmap::Link>::const_iterator iter=newLinks.begin(); iter!=newLinks.end(); ++iter)
+	{
+		std::multimap<int, rtabmap::Link>::const_iterator jter = findLink(links, iter->second);
+		if(jter != links.end())
+		{
+			links.erase(jter);
+		}
+		links.insert(*iter);
+	}
+}
+
+static void removeLinksOfNodes(std::multimap<int, rtabmap::Link> & links, const std::set<int> & ids)
+{
+	if(ids.empty())
+	{
+		return;
+	}
+	for(std::multimap<int, rtabmap::Link>::iterator iter=links.begin(); iter!=links.end();)
+	{
+		if(ids.find(iter->second.from()) != ids.end() || ids.find(iter->second.to()) != ids.end())
+		{
+			links.erase(iter++);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+bool mapGraphDeltaToROS(
+		const std::map<int, rtabmap::Transform> & poses,
+		const std::multimap<int, rtabmap::Link> & links,
+		const rtabmap::Transform & mapToOdom,
+		float tolerance,
+		bool keyframe,
+		std::map<int, rtabmap::Transform> & previousPoses,
+		std::multimap<int, rtabmap::Link> & previousLinks,
+		rtabmap_ros::MapGraph & msg)
+{
+	std::set<int> removedIds;
+	std::map<int, rtabmap::Transform> changedPoses;
+	std::multimap<int, rtabmap::Link> newLinks;
+	if(!keyframe && !previousPoses.empty())
+	{
+		for(std::map<int, rtabmap::Transform>::const_iterator iter=previousPoses.begin(); iter!=previousPoses.end(); ++iter)
+		{
+			if(poses.find(iter->first) == poses.end())
+			{
+				removedIds.insert(removedIds.end(), iter->first);
+			}
+		}
+
+		float toleranceSqr = tolerance*tolerance;
+		for(std::map<int, rtabmap::Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+		{
+			std::map<int, rtabmap::Transform>::const_iterator jter = previousPoses.find(iter->first);
+			if(jter == previousPoses.end() ||
+			   iter->second.getDistanceSquared(jter->second) > toleranceSqr ||
+			   iter->second.getQuaternionf().angularDistance(jter->second.getQuaternionf()) > tolerance)
+			{
+				changedPoses.insert(changedPoses.end(), *iter);
+			}
+		}
+
+		int keptLinks = 0;
+		for(std::multimap<int, rtabmap::Link>::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
+		{
+			if(containsLink(previousLinks, iter->second))
+			{
+				++keptLinks;
+			}
+			else
+			{
+				if(findLink(previousLinks, iter->second) != previousLinks.end())
+				{
+					// transform changed, replaced by the subscribers
+					++keptLinks;
+				}
+				newLinks.insert(*iter);
+			}
+		}
+
+		// Links removed between nodes still in the graph cannot be sent as delta
+		int previousLinksKept = 0;
+		for(std::multimap<int, rtabmap::Link>::const_iterator iter=previousLinks.begin(); iter!=previousLinks.end(); ++iter)
+		{
+			if(removedIds.find(iter->second.from()) == removedIds.end() && removedIds.find(iter->second.to()) == removedIds.end())
+			{
+				++previousLinksKept;
+			}
+		}
+		keyframe = previousLinksKept != keptLinks;
+	}
+	else
+	{
+		keyframe = true;
+	}
+
+	if(keyframe)
+	{
+		mapGraphToROS(poses, links, mapToOdom, msg);
+		msg.delta = false;
+		msg.removedPosesId.clear();
+		previousPoses = poses;
+		previousLinks = links;
+		return false;
+	}
+
+	mapGraphToROS(changedPoses, newLinks, mapToOdom, msg);
+	msg.delta = true;
+	msg.removedPosesId = std::vector<int>(removedIds.begin(), removedIds.end());
+
+	for(std::set<int>::iterator iter=removedIds.begin(); iter!=removedIds.end(); ++iter)
+	{
+		previousPoses.erase(*iter);
+	}
+	for(std::map<int, rtabmap::Transform>::iterator iter=changedPoses.begin(); iter!=changedPoses.end(); ++iter)
+	{
+		uInsert(previousPoses, *iter);
+	}
+	removeLinksOfNodes(previousLinks, removedIds);
+	insertLinks(previousLinks, newLinks);
+	return true;
+}
+
+bool mapGraphDeltaFromROS(
+		const rtabmap_ros::MapGraph & msg,
+		std::map<int, rtabmap::Transform> & poses,
+		std::multimap<int, rtabmap::Link> & links,
+		rtabmap::Transform & mapToOdom,
+		unsigned int & graphId)
+{
+	if(msg.delta && msg.graphId == 0 && msg.deltaBaseId == 0)
+	{
+		// no graph (e.g., next pages of a map chunk)
+		return false;
+	}
+	if(!msg.delta)
+	{
+		poses.clear();
+		links.clear();
+		mapGraphFromROS(msg, poses, links, mapToOdom);
+		graphId = msg.graphId;
+		return true;
+	}
+	if(!poses.empty() && msg.deltaBaseId != graphId)
+	{
+		ROS_WARN("Graph delta %u is based on graph %u but the last graph received is %u, "
+				"waiting for a complete graph (call rtabmap's \"publish_map\" service to get one now).",
+				msg.graphId, msg.deltaBaseId, graphId);
+		poses.clear();
+		links.clear();
+	}
+	if(poses.empty())
+	{
+		// wait for a complete graph
+		return false;
+	}
+
+	std::map<int, rtabmap::Transform> changedPoses;
+	std::multimap<int, rtabmap::Link> newLinks;
+	mapGraphFromROS(msg, changedPoses, newLinks, mapToOdom);
+
+	std::set<int> removedIds(msg.removedPosesId.begin(), msg.removedPosesId.end());
+	for(std::set<int>::iterator iter=removedIds.begin(); iter!=removedIds.end(); ++iter)
+	{
+		poses.erase(*iter);
+	}
+	removeLinksOfNodes(links, removedIds);
+	for(std::map<int, rtabmap::Transform>::iterator iter=changedPoses.begin(); iter!=changedPoses.end(); ++iter)
+	{
+		uInsert(poses, *iter);
+	}
+	insertLinks(links, newLinks);
+	graphId = msg.graphId;
+	return true;
+}
+
 rtabmap::Signature nodeDataFromROS(const rtabmap_ros::NodeData & msg)
 {
 	//Features stuff...
@@ -1665,7 +2079,7 @@ rtabmap::Landmarks landmarksFromROS(
 		const std::string & frameId,
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		double defaultLinVariance,
 		double defaultAngVariance)
@@ -1732,7 +2146,7 @@ rtabmap::Transform getTransform(
 		const std::string & fromFrameId,
 		const std::string & toFrameId,
 		const ros::Time & stamp,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform)
 {
 	// TF ready?
@@ -1769,7 +2183,7 @@ rtabmap::Transform getTransform(
 		const std::string & fixedFrame,
 		const ros::Time & stampSource,
 		const ros::Time & stampTarget,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform)
 {
 	// TF ready?
@@ -1799,6 +2213,307 @@ rtabmap::Transform getTransform(
 	return transform;
 }
 
+// Transforms made only of static transforms, shared by all resolvers of a
+// same listener. They are looked up again after a while in case a static
+// transform is republished.
+struct StaticTransform
+{
+	rtabmap::Transform transform; // null if not static
+	ros::WallTime stamp;
+};
+static const double kStaticTransformRefresh = 10.0; // sec
+static boost::mutex g_staticTransformsMutex;
+static std::map<std::pair<const tf::Transformer *, std::pair<std::string, std::string> >, StaticTransform> g_staticTransforms;
+
+static std::pair<std::string, std::string> framePair(const std::string & a, const std::string & b)
+{
+	// same key for both directions
+	return a<b?std::make_pair(a, b):std::make_pair(b, a);
+}
+
+TransformResolver::TransformResolver(tf::Transformer & listener, double waitForTransform) :
+	listener_(listener),
+	waitForTransform_(waitForTransform)
+{
+}
+
+void TransformResolver::addRequest(const std::string & fromFrameId, const std::string & toFrameId, const ros::Time & stamp)
+{
+	if(fromFrameId.compare(toFrameId) != 0)
+	{
+		ros::Time & latest = requests_[framePair(fromFrameId, toFrameId)];
+		if(stamp > latest)
+		{
+			latest = stamp;
+		}
+	}
+}
+
+void TransformResolver::waitForRequests()
+{
+	for(std::map<std::pair<std::string, std::string>, ros::Time>::iterator iter=requests_.begin(); iter!=requests_.end(); ++iter)
+	{
+		wait(iter->first.first, iter->first.second, iter->second);
+	}
+	requests_.clear();
+}
+
+bool TransformResolver::wait(const std::string & fromFrameId, const std::string & toFrameId, const ros::Time & stamp)
+{
+	if(waitForTransform_ <= 0.0 || stamp.isZero())
+	{
+		return true;
+	}
+	std::map<std::pair<std::string, std::string>, ros::Time>::iterator iter = waited_.find(framePair(fromFrameId, toFrameId));
+	if(iter != waited_.end() && iter->second >= stamp)
+	{
+		// already waited (even if it failed, the lookup will tell)
+		return true;
+	}
+	waited_[framePair(fromFrameId, toFrameId)] = stamp;
+
+	std::string errorMsg;
+	if(!listener_.waitForTransform(fromFrameId, toFrameId, stamp, ros::Duration(waitForTransform_), ros::Duration(0.01), &errorMsg))
+	{
+		ROS_WARN("Could not get transform from %s to %s after %f seconds (for stamp=%f)! Error=\"%s\".",
+				fromFrameId.c_str(), toFrameId.c_str(), waitForTransform_, stamp.toSec(), errorMsg.c_str());
+		return false;
+	}
+	return true;
+}
+
+rtabmap::Transform TransformResolver::getTransform(
+		const std::string & fromFrameId,
+		const std::string & toFrameId,
+		const ros::Time & stamp)
+{
+	std::pair<std::string, std::string> frames(fromFrameId, toFrameId);
+	std::pair<std::string, std::string> inverseFrames(toFrameId, fromFrameId);
+
+	std::map<std::pair<std::pair<std::string, std::string>, ros::Time>, rtabmap::Transform>::iterator iter = transforms_.find(std::make_pair(frames, stamp));
+	if(iter != transforms_.end())
+	{
+		return iter->second;
+	}
+	iter = transforms_.find(std::make_pair(inverseFrames, stamp));
+	if(iter != transforms_.end())
+	{
+		return iter->second.isNull()?iter->second:iter->second.inverse();
+	}
+
+	std::pair<const tf::Transformer *, std::pair<std::string, std::string> > staticKey(&listener_, frames);
+	bool known = false;
+	{
+		boost::mutex::scoped_lock lock(g_staticTransformsMutex);
+		std::map<std::pair<const tf::Transformer *, std::pair<std::string, std::string> >, StaticTransform>::iterator jter = g_staticTransforms.find(staticKey);
+		if(jter != g_staticTransforms.end())
+		{
+			if((ros::WallTime::now() - jter->second.stamp).toSec() < kStaticTransformRefresh)
+			{
+				if(!jter->second.transform.isNull())
+				{
+					transforms_.insert(std::make_pair(std::make_pair(frames, stamp), jter->second.transform));
+					return jter->second.transform;
+				}
+				known = true;
+			}
+			else
+			{
+				g_staticTransforms.erase(jter);
+			}
+		}
+	}
+
+	rtabmap::Transform transform;
+	if(wait(fromFrameId, toFrameId, stamp))
+	{
+		transform = rtabmap_ros::getTransform(fromFrameId, toFrameId, stamp, listener_, 0.0);
+	}
+	transforms_.insert(std::make_pair(std::make_pair(frames, stamp), transform));
+
+	// Only static transforms between the frames? Their latest common time is 0.
+	ros::Time latest;
+	if(!known &&
+	   !transform.isNull() &&
+	   listener_.getLatestCommonTime(fromFrameId, toFrameId, latest, 0) == tf::NO_ERROR)
+	{
+		StaticTransform staticTransform;
+		if(latest.isZero())
+		{
+			staticTransform.transform = transform;
+		}
+		staticTransform.stamp = ros::WallTime::now();
+		boost::mutex::scoped_lock lock(g_staticTransformsMutex);
+		g_staticTransforms[staticKey] = staticTransform;
+	}
+	return transform;
+}
+
+rtabmap::Transform TransformResolver::getTransform(
+		const std::string & sourceTargetFrame,
+		const std::string & fixedFrame,
+		const ros::Time & stampSource,
+		const ros::Time & stampTarget)
+{
+	std::pair<std::pair<std::string, std::string>, std::pair<ros::Time, ros::Time> > key(
+			std::make_pair(sourceTargetFrame, fixedFrame),
+			std::make_pair(stampSource, stampTarget));
+	std::map<std::pair<std::pair<std::string, std::string>, std::pair<ros::Time, ros::Time> >, rtabmap::Transform>::iterator iter = motions_.find(key);
+	if(iter != motions_.end())
+	{
+		return iter->second;
+	}
+
+	rtabmap::Transform transform;
+	if(wait(sourceTargetFrame, fixedFrame, stampSource>stampTarget?stampSource:stampTarget))
+	{
+		transform = rtabmap_ros::getTransform(sourceTargetFrame, fixedFrame, stampSource, stampTarget, listener_, 0.0);
+	}
+	motions_.insert(std::make_pair(key, transform));
+	return transform;
+}
+
+static const size_t kMosaicPoolSize = 4; // buffers per layout
+static boost::mutex g_mosaicPoolMutex;
+static std::map<std::pair<std::pair<int, int>, int>, std::vector<cv::Mat> > g_mosaicPool;
+
+cv::Mat mosaicBuffer(int rows, int cols, int type)
+{
+#if CV_MAJOR_VERSION > 2
+	boost::mutex::scoped_lock lock(g_mosaicPoolMutex);
+	std::vector<cv::Mat> & buffers = g_mosaicPool[std::make_pair(std::make_pair(rows, cols), type)];
+	for(size_t i=0; i<buffers.size(); ++i)
+	{
+		// only referenced by the pool?
+		if(buffers[i].u && buffers[i].u->refcount == 1)
+		{
+			return buffers[i];
+		}
+	}
+	if(buffers.size() < kMosaicPoolSize)
+	{
+		buffers.push_back(cv::Mat(rows, cols, type));
+		return buffers.back();
+	}
+#endif
+	return cv::Mat(rows, cols, type);
+}
+
+// Encoding of the image in the mosaic: 0=keep, 1=bgr8 (mono8 if mono), 2=mono8
+static std::string mosaicEncoding(const std::string & encoding, int mode)
+{
+	if(mode == 0)
+	{
+		return encoding;
+	}
+	if(encoding.compare(sensor_msgs::image_encodings::TYPE_8UC1) == 0 ||
+	   encoding.compare(sensor_msgs::image_encodings::MONO8) == 0 ||
+	   encoding.compare(sensor_msgs::image_encodings::MONO16) == 0 ||
+	   mode == 2)
+	{
+		return sensor_msgs::image_encodings::MONO8;
+	}
+	return sensor_msgs::image_encodings::BGR8;
+}
+
+// Color conversion done directly in the mosaic, -1 if not supported
+static int mosaicConversionCode(const std::string & from, const std::string & to)
+{
+	if(to.compare(sensor_msgs::image_encodings::BGR8) == 0)
+	{
+		if(from.compare(sensor_msgs::image_encodings::RGB8) == 0) return cv::COLOR_RGB2BGR;
+		if(from.compare(sensor_msgs::image_encodings::BGRA8) == 0) return cv::COLOR_BGRA2BGR;
+		if(from.compare(sensor_msgs::image_encodings::RGBA8) == 0) return cv::COLOR_RGBA2BGR;
+	}
+	else if(to.compare(sensor_msgs::image_encodings::MONO8) == 0)
+	{
+		if(from.compare(sensor_msgs::image_encodings::BGR8) == 0) return cv::COLOR_BGR2GRAY;
+		if(from.compare(sensor_msgs::image_encodings::RGB8) == 0) return cv::COLOR_RGB2GRAY;
+		if(from.compare(sensor_msgs::image_encodings::BGRA8) == 0) return cv::COLOR_BGRA2GRAY;
+		if(from.compare(sensor_msgs::image_encodings::RGBA8) == 0) return cv::COLOR_RGBA2GRAY;
+	}
+	return -1;
+}
+
+class MosaicCopy : public cv::ParallelLoopBody
+{
+public:
+	MosaicCopy(const std::vector<cv_bridge::CvImageConstPtr> & images, const std::vector<std::string> & encodings, cv::Mat & mosaic) :
+		images_(images),
+		encodings_(encodings),
+		mosaic_(mosaic)
+	{}
+	virtual void operator()(const cv::Range & range) const
+	{
+		for(int i=range.start; i<range.end; ++i)
+		{
+			const cv::Mat & image = images_[i]->image;
+			cv::Mat roi(mosaic_, cv::Rect(i*image.cols, 0, image.cols, image.rows));
+			const std::string & encoding = images_[i]->encoding;
+			int code;
+			if(encoding.compare(encodings_[i]) == 0 ||
+			   (encoding.compare(sensor_msgs::image_encodings::TYPE_8UC1) == 0 && encodings_[i].compare(sensor_msgs::image_encodings::MONO8) == 0))
+			{
+				image.copyTo(roi);
+			}
+			else if((code = mosaicConversionCode(encoding, encodings_[i])) >= 0)
+			{
+				// roi has already the right size and type, so it is written in place
+				cv::cvtColor(image, roi, code);
+			}
+			else
+			{
+				cv_bridge::cvtColor(images_[i], encodings_[i])->image.copyTo(roi);
+			}
+		}
+	}
+private:
+	const std::vector<cv_bridge::CvImageConstPtr> & images_;
+	const std::vector<std::string> & encodings_;
+	cv::Mat & mosaic_;
+};
+
+static bool toMosaic(const std::vector<cv_bridge::CvImageConstPtr> & images, int mode, cv::Mat & mosaic)
+{
+	UASSERT(!images.empty());
+	std::vector<std::string> encodings(images.size());
+	int type = -1;
+	for(size_t i=0; i<images.size(); ++i)
+	{
+		encodings[i] = mosaicEncoding(images[i]->encoding, mode);
+		int t = mode == 0?images[i]->image.type():
+				encodings[i].compare(sensor_msgs::image_encodings::MONO8)==0?CV_8UC1:CV_8UC3;
+		if(i>0 && t != type)
+		{
+			return false;
+		}
+		type = t;
+	}
+	int width = images[0]->image.cols;
+	int height = images[0]->image.rows;
+	mosaic = mosaicBuffer(height, width*images.size(), type);
+	MosaicCopy copy(images, encodings, mosaic);
+	if(images.size() > 1)
+	{
+		cv::parallel_for_(cv::Range(0, images.size()), copy);
+	}
+	else
+	{
+		copy(cv::Range(0, 1));
+	}
+	return true;
+}
+
+bool imagesToMosaic(const std::vector<cv_bridge::CvImageConstPtr> & images, bool color, cv::Mat & mosaic)
+{
+	return toMosaic(images, color?1:2, mosaic);
+}
+
+bool depthsToMosaic(const std::vector<cv_bridge::CvImageConstPtr> & images, cv::Mat & mosaic)
+{
+	return toMosaic(images, 0, mosaic);
+}
+
 bool convertRGBDMsgs(
 		const std::vector<cv_bridge::CvImageConstPtr> & imageMsgs,
 		const std::vector<cv_bridge::CvImageConstPtr> & depthMsgs,
@@ -1811,7 +2526,7 @@ bool convertRGBDMsgs(
 		cv::Mat & depth,
 		std::vector<rtabmap::CameraModel> & cameraModels,
 		std::vector<rtabmap::StereoCameraModel> & stereoCameraModels,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool alreadRectifiedImages,
 		const std::vector<std::vector<rtabmap_ros::KeyPoint> > & localKeyPointsMsgs,
@@ -1863,6 +2578,34 @@ bool convertRGBDMsgs(
 	}
 
 	int cameraCount = cameraInfoMsgs.size();
+
+	// use depth's stamp so that geometry is sync to odom, use rgb frame as we assume depth is registered (normally depth msg should have same frame than rgb)
+	std::vector<ros::Time> stamps(cameraCount);
+	std::vector<std::string> frameIds(cameraCount);
+	TransformResolver tfResolver(listener, waitForTransform);
+	for(int i=0; i<cameraCount; ++i)
+	{
+		if(isDepth && !depthMsgs.empty())
+		{
+			stamps[i] = depthMsgs[i]->header.stamp;
+		}
+		else if(!imageMsgs.empty())
+		{
+			stamps[i] = imageMsgs[i]->header.stamp;
+		}
+		else
+		{
+			stamps[i] = cameraInfoMsgs[i].header.stamp;
+		}
+		frameIds[i] = !imageMsgs.empty()?imageMsgs[i]->header.frame_id:cameraInfoMsgs[i].header.frame_id;
+		tfResolver.addRequest(frameId, frameIds[i], stamps[i]);
+		if(!odomFrameId.empty() && odomStamp != stamps[i])
+		{
+			tfResolver.addRequest(frameId, odomFrameId, odomStamp>stamps[i]?odomStamp:stamps[i]);
+		}
+	}
+	tfResolver.waitForRequests();
+
 	for(unsigned int i=0; i<cameraInfoMsgs.size(); ++i)
 	{
 		if(!imageMsgs.empty())
@@ -1916,7 +2659,7 @@ bool convertRGBDMsgs(
 		}
 
 
-		ros::Time stamp;
+		const ros::Time & stamp = stamps[i];
 		if(isDepth && !depthMsgs.empty())
 		{
 			UASSERT_MSG(depthMsgs[i]->image.cols == depthWidth && depthMsgs[i]->image.rows == depthHeight,
@@ -1925,19 +2668,9 @@ bool convertRGBDMsgs(
 							depthMsgs[i]->image.cols,
 							depthHeight,
 							depthMsgs[i]->image.rows).c_str());
-			stamp = depthMsgs[i]->header.stamp;
-		}
-		else if(!imageMsgs.empty())
-		{
-			stamp = imageMsgs[i]->header.stamp;
-		}
-		else
-		{
-			stamp = cameraInfoMsgs[i].header.stamp;
 		}
 
-		// use depth's stamp so that geometry is sync to odom, use rgb frame as we assume depth is registered (normally depth msg should have same frame than rgb)
-		rtabmap::Transform localTransform = rtabmap_ros::getTransform(frameId, !imageMsgs.empty()?imageMsgs[i]->header.frame_id:cameraInfoMsgs[i].header.frame_id, stamp, listener, waitForTransform);
+		rtabmap::Transform localTransform = tfResolver.getTransform(frameId, frameIds[i], stamp);
 		if(localTransform.isNull())
 		{
 			ROS_ERROR("TF of received image %d at time %fs is not set!", i, stamp.toSec());
@@ -1946,13 +2679,11 @@ bool convertRGBDMsgs(
 		// sync with odometry stamp
 		if(!odomFrameId.empty() && odomStamp != stamp)
 		{
-			rtabmap::Transform sensorT = getTransform(
+			rtabmap::Transform sensorT = tfResolver.getTransform(
 					frameId,
 					odomFrameId,
 					odomStamp,
-					stamp,
-					listener,
-					waitForTransform);
+					stamp);
 			if(sensorT.isNull())
 			{
 				ROS_WARN("Could not get odometry value for image stamp (%fs). Latest odometry "
@@ -1965,92 +2696,6 @@ bool convertRGBDMsgs(
 			}
 		}
 
-		if(!imageMsgs.empty())
-		{
-			cv_bridge::CvImageConstPtr ptrImage = imageMsgs[i];
-			if(imageMsgs[i]->encoding.compare(sensor_msgs::image_encodings::TYPE_8UC1)==0 ||
-			   imageMsgs[i]->encoding.compare(sensor_msgs::image_encodings::MONO8) == 0 ||
-			   imageMsgs[i]->encoding.compare(sensor_msgs::image_encodings::BGR8) == 0)
-			{
-				// do nothing
-			}
-			else if(imageMsgs[i]->encoding.compare(sensor_msgs::image_encodings::MONO16) == 0)
-			{
-				ptrImage = cv_bridge::cvtColor(imageMsgs[i], "mono8");
-			}
-			else
-			{
-				ptrImage = cv_bridge::cvtColor(imageMsgs[i], "bgr8");
-			}
-
-			// initialize
-			if(rgb.empty())
-			{
-				rgb = cv::Mat(imageHeight, imageWidth*cameraCount, ptrImage->image.type());
-			}
-			if(ptrImage->image.type() == rgb.type())
-			{
-				ptrImage->image.copyTo(cv::Mat(rgb, cv::Rect(i*imageWidth, 0, imageWidth, imageHeight)));
-			}
-			else
-			{
-				ROS_ERROR("Some RGB/left images are not the same type!");
-				return false;
-			}
-		}
-
-		if(!depthMsgs.empty())
-		{
-			if(isDepth)
-			{
-				cv_bridge::CvImageConstPtr ptrDepth = depthMsgs[i];
-				cv::Mat subDepth = ptrDepth->image;
-
-				if(depth.empty())
-				{
-					depth = cv::Mat(depthHeight, depthWidth*cameraCount, subDepth.type());
-				}
-
-				if(subDepth.type() == depth.type())
-				{
-					subDepth.copyTo(cv::Mat(depth, cv::Rect(i*depthWidth, 0, depthWidth, depthHeight)));
-				}
-				else
-				{
-					ROS_ERROR("Some Depth images are not the same type!");
-					return false;
-				}
-			}
-			else
-			{
-				cv_bridge::CvImageConstPtr ptrImage = depthMsgs[i];
-				if( depthMsgs[i]->encoding.compare(sensor_msgs::image_encodings::TYPE_8UC1)==0 ||
-					depthMsgs[i]->encoding.compare(sensor_msgs::image_encodings::MONO8) == 0)
-				{
-					// do nothing
-				}
-				else
-				{
-					ptrImage = cv_bridge::cvtColor(depthMsgs[i], "mono8");
-				}
-
-				// initialize
-				if(depth.empty())
-				{
-					depth = cv::Mat(depthHeight, depthWidth*cameraCount, ptrImage->image.type());
-				}
-				if(ptrImage->image.type() == depth.type())
-				{
-					ptrImage->image.copyTo(cv::Mat(depth, cv::Rect(i*depthWidth, 0, depthWidth, depthHeight)));
-				}
-				else
-				{
-					ROS_ERROR("Some right images are not the same type!");
-					return false;
-				}
-			}
-		}
-
 		if(isDepth)
 		{
 			cameraModels.push_back(rtabmap_ros::cameraModelFromROS(cameraInfoMsgs[i], localTransform));
@@ -2061,12 +2706,10 @@ bool convertRGBDMsgs(
 			rtabmap::Transform stereoTransform;
 			if(!alreadRectifiedImages)
 			{
-				stereoTransform = getTransform(
+				stereoTransform = tfResolver.getTransform(
 						depthCameraInfoMsgs[i].header.frame_id,
 						cameraInfoMsgs[i].header.frame_id,
-						cameraInfoMsgs[i].header.stamp,
-						listener,
-						waitForTransform);
+						cameraInfoMsgs[i].header.stamp);
 				if(stereoTransform.isNull())
 				{
 					ROS_ERROR("Parameter %s is false but we cannot get TF between the two cameras!", rtabmap::Parameters::kRtabmapImagesAlreadyRectified().c_str());
@@ -2091,12 +2734,10 @@ bool convertRGBDMsgs(
 			}
 			else if(stereoModel.baseline() == 0 && alreadRectifiedImages)
 			{
-				rtabmap::Transform stereoTransform = getTransform(
+				rtabmap::Transform stereoTransform = tfResolver.getTransform(
 						cameraInfoMsgs[i].header.frame_id,
 						depthCameraInfoMsgs[i].header.frame_id,
-						cameraInfoMsgs[i].header.stamp,
-						listener,
-						waitForTransform);
+						cameraInfoMsgs[i].header.stamp);
 				if(stereoTransform.isNull() || stereoTransform.x()<=0)
 				{
 					ROS_WARN("We cannot estimated the baseline of the rectified images with tf! (%s->%s = %s)",
@@ -2141,6 +2782,25 @@ bool convertRGBDMsgs(
 			localDescriptors->push_back(localDescriptorsMsgs[i]);
 		}
 	}
+
+	if(!imageMsgs.empty() && !imagesToMosaic(imageMsgs, true, rgb))
+	{
+		ROS_ERROR("Some RGB/left images are not the same type!");
+		return false;
+	}
+	if(!depthMsgs.empty())
+	{
+		if(isDepth && !depthsToMosaic(depthMsgs, depth))
+		{
+			ROS_ERROR("Some Depth images are not the same type!");
+			return false;
+		}
+		else if(!isDepth && !imagesToMosaic(depthMsgs, false, depth))
+		{
+			ROS_ERROR("Some right images are not the same type!");
+			return false;
+		}
+	}
 	return true;
 }
 
@@ -2155,7 +2815,7 @@ bool convertStereoMsg(
 		cv::Mat & left,
 		cv::Mat & right,
 		rtabmap::StereoCameraModel & stereoModel,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool alreadyRectified)
 {
@@ -2301,51 +2961,89 @@ bool convertStereoMsg(
 	return true;
 }
 
+// Cosine and sine of the beam angles of a laser
+struct ScanAngles
+{
+	float angleMin;
+	float angleIncrement;
+	std::vector<float> cos;
+	std::vector<float> sin;
+};
+static boost::mutex g_scanAnglesMutex;
+static std::map<std::string, boost::shared_ptr<const ScanAngles> > g_scanAngles; // by laser frame
+
+static boost::shared_ptr<const ScanAngles> scanAngles(const sensor_msgs::LaserScan & msg)
+{
+	boost::mutex::scoped_lock lock(g_scanAnglesMutex);
+	boost::shared_ptr<const ScanAngles> & angles = g_scanAngles[msg.header.frame_id];
+	if(angles.get() == 0 ||
+	   angles->angleMin != msg.angle_min ||
+	   angles->angleIncrement != msg.angle_increment ||
+	   angles->cos.size() != msg.ranges.size())
+	{
+		boost::shared_ptr<ScanAngles> newAngles(new ScanAngles);
+		newAngles->angleMin = msg.angle_min;
+		newAngles->angleIncrement = msg.angle_increment;
+		newAngles->cos.resize(msg.ranges.size());
+		newAngles->sin.resize(msg.ranges.size());
+		for(size_t i=0; i<msg.ranges.size(); ++i)
+		{
+			double angle = double(msg.angle_min) + double(i)*double(msg.angle_increment);
+			newAngles->cos[i] = std::cos(angle);
+			newAngles->sin[i] = std::sin(angle);
+		}
+		angles = newAngles;
+	}
+	return angles;
+}
+
 bool convertScanMsg(
 		const sensor_msgs::LaserScan & scan2dMsg,
 		const std::string & frameId,
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
 		rtabmap::LaserScan & scan,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		bool outputInFrameId)
 {
+	const std::string & fixedFrameId = odomFrameId.empty()?frameId:odomFrameId;
+	int rangesSize = (int)scan2dMsg.ranges.size();
+	ros::Time scanEndStamp = scan2dMsg.header.stamp + ros::Duration().fromSec(rangesSize*scan2dMsg.time_increment);
+	// stamp of the last beam
+	ros::Time scanLastStamp = scan2dMsg.header.stamp + ros::Duration().fromSec((rangesSize>0?rangesSize-1:0)*scan2dMsg.time_increment);
+	TransformResolver tfResolver(listener, waitForTransform);
 	// make sure the frame of the laser is updated too
-	rtabmap::Transform tmpT = getTransform(
-			odomFrameId.empty()?frameId:odomFrameId,
+	tfResolver.addRequest(fixedFrameId, scan2dMsg.header.frame_id, scanEndStamp);
+	tfResolver.addRequest(frameId, scan2dMsg.header.frame_id, scan2dMsg.header.stamp);
+	if(!odomFrameId.empty() && odomStamp != scan2dMsg.header.stamp)
+	{
+		tfResolver.addRequest(frameId, odomFrameId, odomStamp>scan2dMsg.header.stamp?odomStamp:scan2dMsg.header.stamp);
+	}
+	tfResolver.waitForRequests();
+
+	rtabmap::Transform laserEnd = tfResolver.getTransform(
+			fixedFrameId,
 			scan2dMsg.header.frame_id,
-			scan2dMsg.header.stamp + ros::Duration().fromSec(scan2dMsg.ranges.size()*scan2dMsg.time_increment),
-			listener,
-			waitForTransform);
-	if(tmpT.isNull())
+			scanLastStamp);
+	if(laserEnd.isNull())
 	{
 		return false;
 	}
 
-	rtabmap::Transform scanLocalTransform = getTransform(
+	rtabmap::Transform scanLocalTransform = tfResolver.getTransform(
 			frameId,
 			scan2dMsg.header.frame_id,
-			scan2dMsg.header.stamp,
-			listener,
-			waitForTransform);
+			scan2dMsg.header.stamp);
 	if(scanLocalTransform.isNull())
 	{
 		return false;
 	}
 
-	//transform in frameId_ frame
-	sensor_msgs::PointCloud2 scanOut;
-	laser_geometry::LaserProjection projection;
-	projection.transformLaserScanToPointCloud(odomFrameId.empty()?frameId:odomFrameId, scan2dMsg, scanOut, listener);
-
-	//transform back in laser frame
-	rtabmap::Transform laserToOdom = getTransform(
+	rtabmap::Transform laserToOdom = tfResolver.getTransform(
 			scan2dMsg.header.frame_id,
-			odomFrameId.empty()?frameId:odomFrameId,
-			scan2dMsg.header.stamp,
-			listener,
-			waitForTransform);
+			fixedFrameId,
+			scan2dMsg.header.stamp);
 	if(laserToOdom.isNull())
 	{
 		return false;
@@ -2354,13 +3052,11 @@ bool convertScanMsg(
 	// sync with odometry stamp
 	if(!odomFrameId.empty() && odomStamp != scan2dMsg.header.stamp)
 	{
-		rtabmap::Transform sensorT = getTransform(
+		rtabmap::Transform sensorT = tfResolver.getTransform(
 				frameId,
 				odomFrameId,
 				odomStamp,
-				scan2dMsg.header.stamp,
-				listener,
-				waitForTransform);
+				scan2dMsg.header.stamp);
 		if(sensorT.isNull())
 		{
 			ROS_WARN("Could not get odometry value for laser scan stamp (%fs). Latest odometry "
@@ -2373,55 +3069,55 @@ bool convertScanMsg(
 		}
 	}
 
+	// Motion of the laser during the scan (laser at first beam <- laser at
+	// last beam), interpolated for each beam to deskew the scan, like
+	// laser_geometry's transformLaserScanToPointCloud() in the fixed frame.
+	rtabmap::Transform motion = laserToOdom * laserEnd;
+	bool deskew = rangesSize > 1 && !motion.isIdentity();
+	Eigen::Quaternionf motionRotation = motion.getQuaternionf();
+	Eigen::Vector3f motionTranslation(motion.x(), motion.y(), motion.z());
+
+	Eigen::Affine3f outputTransform = Eigen::Affine3f::Identity();
 	if(outputInFrameId)
 	{
-		laserToOdom *= scanLocalTransform;
+		outputTransform = (laserToOdom * scanLocalTransform * laserToOdom.inverse()).toEigen3f();
 	}
 
-	bool hasIntensity = false;
-	for(unsigned int i=0; i<scanOut.fields.size(); ++i)
+	bool hasIntensity = !scan2dMsg.intensities.empty() && scan2dMsg.intensities.size() == scan2dMsg.ranges.size();
+	rtabmap::LaserScan::Format format = hasIntensity?rtabmap::LaserScan::kXYI:rtabmap::LaserScan::kXY;
+
+	boost::shared_ptr<const ScanAngles> angles = scanAngles(scan2dMsg);
+	cv::Mat data(1, rangesSize, hasIntensity?CV_32FC3:CV_32FC2);
+	int oi = 0;
+	for(int i=0; i<rangesSize; ++i)
 	{
-		if(scanOut.fields[i].name.compare("intensity") == 0)
+		float range = scan2dMsg.ranges[i];
+		if(!(range < scan2dMsg.range_max && range >= scan2dMsg.range_min))
 		{
-			if(scanOut.fields[i].datatype == sensor_msgs::PointField::FLOAT32)
-			{
-				hasIntensity = true;
-			}
-			else
-			{
-				static bool warningShown = false;
-				if(!warningShown)
-				{
-					ROS_WARN("The input scan cloud has an \"intensity\" field "
-							"but the datatype (%d) is not supported. Intensity will be ignored. "
-							"This message is only shown once.", scanOut.fields[i].datatype);
-					warningShown = true;
-				}
-			}
+			continue;
+		}
+		Eigen::Vector3f pt(range*angles->cos[i], range*angles->sin[i], 0.0f);
+		if(deskew)
+		{
+			float ratio = float(i) / float(rangesSize-1);
+			pt = Eigen::Quaternionf::Identity().slerp(ratio, motionRotation) * pt + ratio * motionTranslation;
+		}
+		if(outputInFrameId)
+		{
+			pt = outputTransform * pt;
+		}
+		float * ptr = data.ptr<float>(0, oi++);
+		ptr[0] = pt[0];
+		ptr[1] = pt[1];
+		if(hasIntensity)
+		{
+			ptr[2] = scan2dMsg.intensities[i];
 		}
 	}
-
-	rtabmap::LaserScan::Format format;
-	cv::Mat data;
-	if(hasIntensity)
-	{
-		pcl::PointCloud<pcl::PointXYZI>::Ptr pclScan(new pcl::PointCloud<pcl::PointXYZI>);
-		pcl::fromROSMsg(scanOut, *pclScan);
-		pclScan->is_dense = true;
-		data = rtabmap::util3d::laserScan2dFromPointCloud(*pclScan, laserToOdom).data(); // put back in laser frame
-		format = rtabmap::LaserScan::kXYI;
-	}
-	else
-	{
-		pcl::PointCloud<pcl::PointXYZ>::Ptr pclScan(new pcl::PointCloud<pcl::PointXYZ>);
-		pcl::fromROSMsg(scanOut, *pclScan);
-		pclScan->is_dense = true;
-		data = rtabmap::util3d::laserScan2dFromPointCloud(*pclScan, laserToOdom).data(); // put back in laser frame
-		format = rtabmap::LaserScan::kXY;
-	}
+	data = data.colRange(0, oi);
 
 	rtabmap::Transform zAxis(0,0,1,0,0,0);
-	if((scanLocalTransform.rotation()*zAxis).z() < 0)
+	if(!data.empty() && (scanLocalTransform.rotation()*zAxis).z() < 0)
 	{
 		cv::Mat flipScan;
 		cv::flip(data, flipScan, 1);
@@ -2441,13 +3137,88 @@ bool convertScanMsg(
 	return true;
 }
 
+// Offsets of the float fields x,y,z and intensity (-1 if not set) of a
+// cloud, false if the layout is not supported by pointCloud2ToScanData()
+static bool scanFieldOffsets(const sensor_msgs::PointCloud2 & msg, int & x, int & y, int & z, int & intensity)
+{
+	x = y = z = intensity = -1;
+	if(msg.is_bigendian)
+	{
+		return false;
+	}
+	for(size_t i=0; i<msg.fields.size(); ++i)
+	{
+		const sensor_msgs::PointField & field = msg.fields[i];
+		int * offset = 0;
+		if(field.name.compare("x") == 0) offset = &x;
+		else if(field.name.compare("y") == 0) offset = &y;
+		else if(field.name.compare("z") == 0) offset = &z;
+		else if(field.name.compare("intensity") == 0) offset = &intensity;
+		else if(field.name.compare("rgb") == 0 ||
+				field.name.compare("rgba") == 0 ||
+				field.name.compare("normal_x") == 0)
+		{
+			// color and normals are handled by util3d
+			return false;
+		}
+		if(offset)
+		{
+			if(field.datatype != sensor_msgs::PointField::FLOAT32 || field.count != 1)
+			{
+				return false;
+			}
+			*offset = field.offset;
+		}
+		// other fields (e.g., ring, time) are ignored
+	}
+	return x>=0 && y>=0 && z>=0;
+}
+
+// Pack the valid points (finite and closer than maxRange if set) of
+// the cloud in scan data (CV_32FC3 or CV_32FC4 with intensity)
+template<bool withIntensity>
+static cv::Mat pointCloud2ToScanData(const sensor_msgs::PointCloud2 & msg, int xOffset, int yOffset, int zOffset, int intensityOffset, float maxRange)
+{
+	const int channels = withIntensity?4:3;
+	cv::Mat data(1, msg.width*msg.height, CV_32FC(channels));
+	float * out = data.ptr<float>();
+	const float maxRangeSqr = maxRange>0.0f?maxRange*maxRange:std::numeric_limits<float>::max();
+	int oi = 0;
+	for(unsigned int row=0; row<msg.height; ++row)
+	{
+		const unsigned char * in = msg.data.data() + row*msg.row_step;
+		for(unsigned int col=0; col<msg.width; ++col, in+=msg.point_step)
+		{
+			float x, y, z;
+			memcpy(&x, in+xOffset, sizeof(float));
+			memcpy(&y, in+yOffset, sizeof(float));
+			memcpy(&z, in+zOffset, sizeof(float));
+			float rangeSqr = x*x + y*y + z*z;
+			// false for NaNs and infinite values
+			if(rangeSqr < maxRangeSqr)
+			{
+				float * ptr = out + oi*channels;
+				ptr[0] = x;
+				ptr[1] = y;
+				ptr[2] = z;
+				if(withIntensity)
+				{
+					memcpy(ptr+3, in+intensityOffset, sizeof(float));
+				}
+				++oi;
+			}
+		}
+	}
+	return data.colRange(0, oi);
+}
+
 bool convertScan3dMsg(
 		const sensor_msgs::PointCloud2 & scan3dMsg,
 		const std::string & frameId,
 		const std::string & odomFrameId,
 		const ros::Time & odomStamp,
 		rtabmap::LaserScan & scan,
-		tf::TransformListener & listener,
+		tf::Transformer & listener,
 		double waitForTransform,
 		int maxPoints,
 		float maxRange)
@@ -2455,7 +3226,15 @@ bool convertScan3dMsg(
 	UASSERT_MSG(scan3dMsg.data.size() == scan3dMsg.row_step*scan3dMsg.height,
 			uFormat("data=%d row_step=%d height=%d", scan3dMsg.data.size(), scan3dMsg.row_step, scan3dMsg.height).c_str());
 
-	rtabmap::Transform scanLocalTransform = getTransform(frameId, scan3dMsg.header.frame_id, scan3dMsg.header.stamp, listener, waitForTransform);
+	TransformResolver tfResolver(listener, waitForTransform);
+	tfResolver.addRequest(frameId, scan3dMsg.header.frame_id, scan3dMsg.header.stamp);
+	if(!odomFrameId.empty() && odomStamp != scan3dMsg.header.stamp)
+	{
+		tfResolver.addRequest(frameId, odomFrameId, odomStamp>scan3dMsg.header.stamp?odomStamp:scan3dMsg.header.stamp);
+	}
+	tfResolver.waitForRequests();
+
+	rtabmap::Transform scanLocalTransform = tfResolver.getTransform(frameId, scan3dMsg.header.frame_id, scan3dMsg.header.stamp);
 	if(scanLocalTransform.isNull())
 	{
 		ROS_ERROR("TF of received scan cloud at time %fs is not set, aborting rtabmap update.", scan3dMsg.header.stamp.toSec());
@@ -2465,13 +3244,11 @@ bool convertScan3dMsg(
 	// sync with odometry stamp
 	if(!odomFrameId.empty() && odomStamp != scan3dMsg.header.stamp)
 	{
-		rtabmap::Transform sensorT = getTransform(
+		rtabmap::Transform sensorT = tfResolver.getTransform(
 				frameId,
 				odomFrameId,
 				odomStamp,
-				scan3dMsg.header.stamp,
-				listener,
-				waitForTransform);
+				scan3dMsg.header.stamp);
 		if(sensorT.isNull())
 		{
 			ROS_WARN("Could not get odometry value for laser scan stamp (%fs). Latest odometry "
@@ -2482,8 +3259,35 @@ bool convertScan3dMsg(
 			scanLocalTransform = sensorT * scanLocalTransform;
 		}
 	}
-	scan = rtabmap::util3d::laserScanFromPointCloud(scan3dMsg);
-	scan = rtabmap::LaserScan(scan, maxPoints, maxRange, scanLocalTransform);
+
+	int xOffset, yOffset, zOffset, intensityOffset;
+	if(scanFieldOffsets(scan3dMsg, xOffset, yOffset, zOffset, intensityOffset))
+	{
+		// XYZ or XYZI with any other fields (e.g., ring and time of Velodyne/Ouster)
+		if(intensityOffset >= 0)
+		{
+			scan = rtabmap::LaserScan(
+					pointCloud2ToScanData<true>(scan3dMsg, xOffset, yOffset, zOffset, intensityOffset, maxRange),
+					maxPoints,
+					maxRange,
+					rtabmap::LaserScan::kXYZI,
+					scanLocalTransform);
+		}
+		else
+		{
+			scan = rtabmap::LaserScan(
+					pointCloud2ToScanData<false>(scan3dMsg, xOffset, yOffset, zOffset, -1, maxRange),
+					maxPoints,
+					maxRange,
+					rtabmap::LaserScan::kXYZ,
+					scanLocalTransform);
+		}
+	}
+	else
+	{
+		scan = rtabmap::util3d::laserScanFromPointCloud(scan3dMsg);
+		scan = rtabmap::LaserScan(scan, maxPoints, maxRange, scanLocalTransform);
+	}
 	return true;
 }
 
@@ -0,0 +1,568 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <ros/ros.h>
+#include <sensor_msgs/image_encodings.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <tf/tf.h>
+
+#include <rtabmap_ros/MsgConversion.h>
+#include <rtabmap_ros/MapData.h>
+#include <rtabmap_ros/NodeData.h>
+
+#include <rtabmap/core/Compression.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UConversion.h>
+
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+/*
+ * Standalone benchmark of MsgConversion functions on synthetic data, no ROS
+ * master is required. Example:
+ * $ rosrun rtabmap_ros msg_conversion_benchmark --width 1280 --height 720 --iterations 200
+ */
+
+// Count heap allocations done while a conversion is running: operator new
+// and cv::Mat buffers (which are allocated with malloc by OpenCV). Other
+// malloc-based allocations (e.g., zlib) are not counted.
+static boost::atomic<bool> g_countAllocations(false);
+static boost::atomic<size_t> g_allocations(0);
+static boost::atomic<size_t> g_allocatedBytes(0);
+
+static inline void countAllocation(std::size_t size)
+{
+	if(g_countAllocations.load(boost::memory_order_relaxed))
+	{
+		g_allocations.fetch_add(1, boost::memory_order_relaxed);
+		g_allocatedBytes.fetch_add(size, boost::memory_order_relaxed);
+	}
+}
+
+void * operator new(std::size_t size)
+{
+	countAllocation(size);
+	void * ptr = std::malloc(size?size:1);
+	if(!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+void * operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+void operator delete(void * ptr) noexcept
+{
+	std::free(ptr);
+}
+void operator delete[](void * ptr) noexcept
+{
+	std::free(ptr);
+}
+void operator delete(void * ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+void operator delete[](void * ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+#if CV_MAJOR_VERSION >= 3
+// Default cv::Mat allocator counting the allocations, the buffers are
+// allocated and released by OpenCV's standard allocator.
+class CountingMatAllocator : public cv::MatAllocator
+{
+public:
+	CountingMatAllocator() : allocator_(cv::Mat::getStdAllocator()) {}
+#if CV_MAJOR_VERSION >= 4
+	typedef cv::AccessFlag AccessFlags;
+#else
+	typedef int AccessFlags;
+#endif
+	virtual cv::UMatData * allocate(int dims, const int * sizes, int type, void * data, size_t * step, AccessFlags flags, cv::UMatUsageFlags usageFlags) const
+	{
+		cv::UMatData * u = allocator_->allocate(dims, sizes, type, data, step, flags, usageFlags);
+		if(u && data == 0)
+		{
+			countAllocation(u->size);
+		}
+		return u;
+	}
+	virtual bool allocate(cv::UMatData * data, AccessFlags flags, cv::UMatUsageFlags usageFlags) const
+	{
+		return allocator_->allocate(data, flags, usageFlags);
+	}
+	virtual void deallocate(cv::UMatData * data) const
+	{
+		allocator_->deallocate(data);
+	}
+private:
+	const cv::MatAllocator * allocator_;
+};
+#endif
+
+struct Options
+{
+	Options() :
+		width(640),
+		height(480),
+		cameras(1),
+		points(100000),
+		keypoints(1000),
+		nodes(100),
+		iterations(100),
+		warmup(5)
+	{}
+	int width;
+	int height;
+	int cameras;
+	int points;
+	int keypoints;
+	int nodes;
+	int iterations;
+	int warmup;
+};
+
+static void run(const std::string & name, const Options & opt, const boost::function<void()> & f)
+{
+	for(int i=0; i<opt.warmup; ++i)
+	{
+		f();
+	}
+
+	std::vector<double> latencies(opt.iterations);
+	g_allocations = 0;
+	g_allocatedBytes = 0;
+	ros::WallTime start = ros::WallTime::now();
+	for(int i=0; i<opt.iterations; ++i)
+	{
+		ros::WallTime t = ros::WallTime::now();
+		g_countAllocations = true;
+		f();
+		g_countAllocations = false;
+		latencies[i] = (ros::WallTime::now() - t).toSec()*1000.0;
+	}
+	double total = (ros::WallTime::now() - start).toSec();
+	std::sort(latencies.begin(), latencies.end());
+
+	double mean = 0.0;
+	for(size_t i=0; i<latencies.size(); ++i)
+	{
+		mean += latencies[i];
+	}
+	mean /= double(latencies.size());
+	printf("%-28s %10.1f %9.3f %9.3f %9.3f %9.3f %9.3f %10.1f %10.1f\n",
+			name.c_str(),
+			double(opt.iterations)/total,
+			mean,
+			latencies[latencies.size()*50/100],
+			latencies[latencies.size()*90/100],
+			latencies[std::min(latencies.size()-1, latencies.size()*99/100)],
+			latencies.back(),
+			double(g_allocations)/double(opt.iterations),
+			double(g_allocatedBytes)/double(opt.iterations)/1024.0);
+}
+
+static cv_bridge::CvImagePtr createImage(int width, int height, const std::string & encoding, int type, const std::string & frameId, const ros::Time & stamp)
+{
+	cv_bridge::CvImagePtr image(new cv_bridge::CvImage);
+	image->header.frame_id = frameId;
+	image->header.stamp = stamp;
+	image->encoding = encoding;
+	image->image = cv::Mat(height, width, type);
+	if(type == CV_16UC1)
+	{
+		// smooth depth with some holes
+		for(int y=0; y<height; ++y)
+		{
+			unsigned short * row = image->image.ptr<unsigned short>(y);
+			for(int x=0; x<width; ++x)
+			{
+				row[x] = (x+y)%37==0?0:500+(x+2*y)%4000;
+			}
+		}
+	}
+	else
+	{
+		cv::randu(image->image, cv::Scalar::all(0), cv::Scalar::all(255));
+	}
+	return image;
+}
+
+static sensor_msgs::PointCloud2 createCloud(int points, const std::string & frameId, const ros::Time & stamp)
+{
+	sensor_msgs::PointCloud2 cloud;
+	cloud.header.frame_id = frameId;
+	cloud.header.stamp = stamp;
+	sensor_msgs::PointCloud2Modifier modifier(cloud);
+	modifier.setPointCloud2Fields(4,
+			"x", 1, sensor_msgs::PointField::FLOAT32,
+			"y", 1, sensor_msgs::PointField::FLOAT32,
+			"z", 1, sensor_msgs::PointField::FLOAT32,
+			"intensity", 1, sensor_msgs::PointField::FLOAT32);
+	modifier.resize(points);
+	sensor_msgs::PointCloud2Iterator<float> iter(cloud, "x");
+	for(int i=0; i<points; ++i, ++iter)
+	{
+		iter[0] = float(rand()%20000)/1000.0f - 10.0f;
+		iter[1] = float(rand()%20000)/1000.0f - 10.0f;
+		iter[2] = float(rand()%4000)/1000.0f - 2.0f;
+		iter[3] = float(rand()%256);
+	}
+	return cloud;
+}
+
+static std::vector<cv::KeyPoint> createKeypoints(int count, int width, int height)
+{
+	std::vector<cv::KeyPoint> kpts(count);
+	for(int i=0; i<count; ++i)
+	{
+		kpts[i] = cv::KeyPoint(float(rand()%width), float(rand()%height), 7.0f, float(rand()%360), 0.01f, rand()%8, -1);
+	}
+	return kpts;
+}
+
+static rtabmap::Signature createSignature(int id, const Options & opt, const cv::Mat & rgbCompressed, const cv::Mat & depthCompressed, const cv::Mat & scanCompressed)
+{
+	rtabmap::CameraModel model(525.0, 525.0, opt.width/2.0, opt.height/2.0, rtabmap::Transform::getIdentity(), 0.0, cv::Size(opt.width, opt.height));
+	rtabmap::Signature s(
+			id,
+			0,
+			0,
+			double(id),
+			"",
+			rtabmap::Transform(float(id), 0, 0, 0, 0, 0),
+			rtabmap::Transform(),
+			rtabmap::SensorData(
+					rtabmap::LaserScan(scanCompressed, 0, 0, rtabmap::LaserScan::kXYZI, rtabmap::Transform::getIdentity()),
+					rgbCompressed,
+					depthCompressed,
+					model,
+					id,
+					double(id)));
+
+	std::multimap<int, int> words;
+	std::vector<cv::Point3f> words3D(opt.keypoints);
+	for(int i=0; i<opt.keypoints; ++i)
+	{
+		words.insert(std::make_pair(i+1, i));
+		words3D[i] = cv::Point3f(float(rand()%1000)/100.0f, float(rand()%1000)/100.0f, float(rand()%1000)/100.0f);
+	}
+	cv::Mat descriptors(opt.keypoints, 32, CV_8UC1);
+	cv::randu(descriptors, cv::Scalar::all(0), cv::Scalar::all(255));
+	s.setWords(words, createKeypoints(opt.keypoints, opt.width, opt.height), words3D, descriptors);
+	return s;
+}
+
+static void showUsage()
+{
+	printf("\nUsage:\n"
+			"msg_conversion_benchmark [options]\n"
+			"Options:\n"
+			"  --width #       Image width (default 640).\n"
+			"  --height #      Image height (default 480).\n"
+			"  --cameras #     Number of cameras for convertRGBDMsgs (default 1).\n"
+			"  --points #      Number of points of the clouds (default 100000).\n"
+			"  --keypoints #   Number of keypoints/words (default 1000).\n"
+			"  --nodes #       Number of nodes for mapDataToROS (default 100).\n"
+			"  --iterations #  Timed iterations per conversion (default 100).\n"
+			"  --warmup #      Untimed iterations per conversion (default 5).\n\n");
+	exit(1);
+}
+
+int main(int argc, char** argv)
+{
+	Options opt;
+	for(int i=1; i<argc; ++i)
+	{
+		std::string arg = argv[i];
+		if(arg.compare("--help") == 0 || arg.compare("-h") == 0 || i+1 >= argc)
+		{
+			showUsage();
+		}
+		int value = atoi(argv[++i]);
+		if(value <= 0 && arg.compare("--warmup") != 0)
+		{
+			printf("Value of \"%s\" should be > 0.\n", arg.c_str());
+			showUsage();
+		}
+		if(arg.compare("--width") == 0) opt.width = value;
+		else if(arg.compare("--height") == 0) opt.height = value;
+		else if(arg.compare("--cameras") == 0) opt.cameras = value;
+		else if(arg.compare("--points") == 0) opt.points = value;
+		else if(arg.compare("--keypoints") == 0) opt.keypoints = value;
+		else if(arg.compare("--nodes") == 0) opt.nodes = value;
+		else if(arg.compare("--iterations") == 0) opt.iterations = value;
+		else if(arg.compare("--warmup") == 0) opt.warmup = value;
+		else
+		{
+			printf("Unknown option \"%s\".\n", arg.c_str());
+			showUsage();
+		}
+	}
+
+	// All data are in the same frame, the transforms are only looked up
+	// from a local buffer (no ROS node is created).
+	ros::Time::init();
+	const std::string frameId = "base_link";
+	const ros::Time stamp(1.0);
+	tf::Transformer listener(true, ros::Duration(10.0));
+	listener.setTransform(tf::StampedTransform(tf::Transform::getIdentity(), stamp, "odom", frameId), "msg_conversion_benchmark");
+
+#if CV_MAJOR_VERSION >= 3
+	CountingMatAllocator matAllocator;
+	cv::Mat::setDefaultAllocator(&matAllocator);
+#endif
+
+	printf("width=%d height=%d cameras=%d points=%d keypoints=%d nodes=%d iterations=%d\n\n",
+			opt.width, opt.height, opt.cameras, opt.points, opt.keypoints, opt.nodes, opt.iterations);
+	printf("%-28s %10s %9s %9s %9s %9s %9s %10s %10s\n",
+			"conversion", "it/s", "mean(ms)", "p50(ms)", "p90(ms)", "p99(ms)", "max(ms)", "allocs/it", "KB/it");
+
+	// convertRGBDMsgs
+	std::vector<cv_bridge::CvImageConstPtr> imageMsgs;
+	std::vector<cv_bridge::CvImageConstPtr> depthMsgs;
+	std::vector<sensor_msgs::CameraInfo> cameraInfoMsgs;
+	for(int i=0; i<opt.cameras; ++i)
+	{
+		imageMsgs.push_back(createImage(opt.width, opt.height, sensor_msgs::image_encodings::BGR8, CV_8UC3, frameId, stamp));
+		depthMsgs.push_back(createImage(opt.width, opt.height, sensor_msgs::image_encodings::TYPE_16UC1, CV_16UC1, frameId, stamp));
+		rtabmap::CameraModel model(525.0, 525.0, opt.width/2.0, opt.height/2.0, rtabmap::Transform::getIdentity(), 0.0, cv::Size(opt.width, opt.height));
+		sensor_msgs::CameraInfo info;
+		rtabmap_ros::cameraModelToROS(model, info);
+		info.header.frame_id = frameId;
+		info.header.stamp = stamp;
+		cameraInfoMsgs.push_back(info);
+	}
+	struct RGBDConversion
+	{
+		static void convert(
+				const std::vector<cv_bridge::CvImageConstPtr> & imageMsgs,
+				const std::vector<cv_bridge::CvImageConstPtr> & depthMsgs,
+				const std::vector<sensor_msgs::CameraInfo> & cameraInfoMsgs,
+				const std::string & frameId,
+				tf::Transformer * listener)
+		{
+			cv::Mat rgb, depth;
+			std::vector<rtabmap::CameraModel> cameraModels;
+			std::vector<rtabmap::StereoCameraModel> stereoCameraModels;
+			rtabmap_ros::convertRGBDMsgs(
+					imageMsgs, depthMsgs, cameraInfoMsgs, std::vector<sensor_msgs::CameraInfo>(),
+					frameId, "", ros::Time(), rgb, depth, cameraModels, stereoCameraModels,
+					*listener, 0.0, true);
+		}
+	};
+	{
+		cv::Mat rgb, depth;
+		std::vector<rtabmap::CameraModel> cameraModels;
+		std::vector<rtabmap::StereoCameraModel> stereoCameraModels;
+		rtabmap_ros::convertRGBDMsgs(
+				imageMsgs, depthMsgs, cameraInfoMsgs, std::vector<sensor_msgs::CameraInfo>(),
+				frameId, "", ros::Time(), rgb, depth, cameraModels, stereoCameraModels,
+				listener, 0.0, true);
+		UASSERT(rgb.cols == opt.width*opt.cameras && rgb.rows == opt.height && rgb.type() == CV_8UC3);
+		UASSERT(depth.cols == opt.width*opt.cameras && depth.rows == opt.height && depth.type() == CV_16UC1);
+		UASSERT((int)cameraModels.size() == opt.cameras);
+	}
+	run("convertRGBDMsgs", opt, boost::bind(&RGBDConversion::convert, boost::cref(imageMsgs), boost::cref(depthMsgs), boost::cref(cameraInfoMsgs), frameId, &listener));
+
+	// convertScan3dMsg
+	sensor_msgs::PointCloud2 cloud = createCloud(opt.points, frameId, stamp);
+	struct Scan3dConversion
+	{
+		static void convert(const sensor_msgs::PointCloud2 & cloud, const std::string & frameId, tf::Transformer * listener)
+		{
+			rtabmap::LaserScan scan;
+			rtabmap_ros::convertScan3dMsg(cloud, frameId, "", ros::Time(), scan, *listener, 0.0);
+		}
+	};
+	{
+		rtabmap::LaserScan scan;
+		rtabmap_ros::convertScan3dMsg(cloud, frameId, "", ros::Time(), scan, listener, 0.0);
+		UASSERT(scan.size() == opt.points && scan.format() == rtabmap::LaserScan::kXYZI);
+	}
+	run("convertScan3dMsg", opt, boost::bind(&Scan3dConversion::convert, boost::cref(cloud), frameId, &listener));
+
+	// keypointsToROS / keypointsFromROS
+	std::vector<cv::KeyPoint> kpts = createKeypoints(opt.keypoints, opt.width, opt.height);
+	std::vector<rtabmap_ros::KeyPoint> kptsMsg;
+	rtabmap_ros::keypointsToROS(kpts, kptsMsg);
+	struct KeypointsConversion
+	{
+		static void toROS(const std::vector<cv::KeyPoint> & kpts)
+		{
+			std::vector<rtabmap_ros::KeyPoint> msg;
+			rtabmap_ros::keypointsToROS(kpts, msg);
+		}
+		static void fromROS(const std::vector<rtabmap_ros::KeyPoint> & msg)
+		{
+			std::vector<cv::KeyPoint> kpts = rtabmap_ros::keypointsFromROS(msg);
+		}
+	};
+	{
+		std::vector<cv::KeyPoint> kptsOut = rtabmap_ros::keypointsFromROS(kptsMsg);
+		UASSERT(kptsOut.size() == kpts.size());
+		for(size_t i=0; i<kpts.size(); ++i)
+		{
+			UASSERT(kptsOut[i].pt == kpts[i].pt &&
+					kptsOut[i].size == kpts[i].size &&
+					kptsOut[i].angle == kpts[i].angle &&
+					kptsOut[i].response == kpts[i].response &&
+					kptsOut[i].octave == kpts[i].octave &&
+					kptsOut[i].class_id == kpts[i].class_id);
+		}
+	}
+	run("keypointsToROS", opt, boost::bind(&KeypointsConversion::toROS, boost::cref(kpts)));
+	run("keypointsFromROS", opt, boost::bind(&KeypointsConversion::fromROS, boost::cref(kptsMsg)));
+
+	// nodeDataToROS / nodeDataFromROS
+	cv::Mat rgbCompressed = rtabmap::compressImage2(imageMsgs[0]->image, ".jpg");
+	cv::Mat depthCompressed = rtabmap::compressImage2(depthMsgs[0]->image, ".png");
+	cv::Mat scanCompressed;
+	{
+		rtabmap::LaserScan scan;
+		rtabmap_ros::convertScan3dMsg(cloud, frameId, "", ros::Time(), scan, listener, 0.0);
+		scanCompressed = rtabmap::compressData2(scan.data());
+	}
+	rtabmap::Signature signature = createSignature(1, opt, rgbCompressed, depthCompressed, scanCompressed);
+	rtabmap_ros::NodeData nodeMsg;
+	rtabmap_ros::nodeDataToROS(signature, nodeMsg);
+	struct NodeDataConversion
+	{
+		static void toROS(const rtabmap::Signature & s)
+		{
+			rtabmap_ros::NodeData msg;
+			rtabmap_ros::nodeDataToROS(s, msg);
+		}
+		static void fromROS(const rtabmap_ros::NodeData & msg)
+		{
+			rtabmap::Signature s = rtabmap_ros::nodeDataFromROS(msg);
+		}
+	};
+	{
+		rtabmap::Signature s = rtabmap_ros::nodeDataFromROS(nodeMsg);
+		UASSERT(s.id() == signature.id());
+		UASSERT(s.getWords().size() == signature.getWords().size());
+		UASSERT(s.getWordsKpts().size() == signature.getWordsKpts().size());
+		const cv::Mat & image = s.sensorData().imageCompressed();
+		UASSERT(image.total()*image.elemSize() == rgbCompressed.total()*rgbCompressed.elemSize() &&
+				memcmp(image.data, rgbCompressed.data, image.total()*image.elemSize()) == 0);
+	}
+	run("nodeDataToROS", opt, boost::bind(&NodeDataConversion::toROS, boost::cref(signature)));
+	run("nodeDataFromROS", opt, boost::bind(&NodeDataConversion::fromROS, boost::cref(nodeMsg)));
+
+	// mapDataToROS / mapDataFromROS
+	std::map<int, rtabmap::Transform> poses;
+	std::multimap<int, rtabmap::Link> links;
+	std::map<int, rtabmap::Signature> signatures;
+	for(int i=1; i<=opt.nodes; ++i)
+	{
+		signatures.insert(std::make_pair(i, createSignature(i, opt, rgbCompressed, depthCompressed, scanCompressed)));
+		poses.insert(std::make_pair(i, signatures.at(i).getPose()));
+		if(i>1)
+		{
+			links.insert(std::make_pair(i-1, rtabmap::Link(i-1, i, rtabmap::Link::kNeighbor, poses.at(i-1).inverse()*poses.at(i))));
+		}
+	}
+	rtabmap_ros::MapData mapMsg;
+	rtabmap_ros::mapDataToROS(poses, links, signatures, rtabmap::Transform::getIdentity(), mapMsg);
+	struct MapDataConversion
+	{
+		static void toROS(
+				const std::map<int, rtabmap::Transform> & poses,
+				const std::multimap<int, rtabmap::Link> & links,
+				const std::map<int, rtabmap::Signature> & signatures)
+		{
+			rtabmap_ros::MapData msg;
+			rtabmap_ros::mapDataToROS(poses, links, signatures, rtabmap::Transform::getIdentity(), msg);
+		}
+		static void fromROS(const rtabmap_ros::MapData & msg)
+		{
+			std::map<int, rtabmap::Transform> poses;
+			std::multimap<int, rtabmap::Link> links;
+			std::map<int, rtabmap::Signature> signatures;
+			rtabmap::Transform mapToOdom;
+			rtabmap_ros::mapDataFromROS(msg, poses, links, signatures, mapToOdom);
+		}
+	};
+	{
+		std::map<int, rtabmap::Transform> posesOut;
+		std::multimap<int, rtabmap::Link> linksOut;
+		std::map<int, rtabmap::Signature> signaturesOut;
+		rtabmap::Transform mapToOdom;
+		rtabmap_ros::mapDataFromROS(mapMsg, posesOut, linksOut, signaturesOut, mapToOdom);
+		UASSERT(posesOut.size() == poses.size() && linksOut.size() == links.size() && signaturesOut.size() == signatures.size());
+		UASSERT(posesOut.rbegin()->second.getDistance(poses.rbegin()->second) < 0.0001f);
+	}
+	run("mapDataToROS", opt, boost::bind(&MapDataConversion::toROS, boost::cref(poses), boost::cref(links), boost::cref(signatures)));
+	run("mapDataFromROS", opt, boost::bind(&MapDataConversion::fromROS, boost::cref(mapMsg)));
+
+	// depth codecs
+	struct DepthCompression
+	{
+		static void png(const cv::Mat & depth)
+		{
+			std::vector<unsigned char> bytes = rtabmap::compressImage(depth, ".png");
+		}
+		static void rvl(const cv::Mat & depth)
+		{
+			std::vector<unsigned char> bytes = rtabmap_ros::compressDepthRVL(depth);
+		}
+		static void rvlDecode(const std::vector<unsigned char> & bytes)
+		{
+			cv::Mat depth = rtabmap_ros::uncompressDepthRVL(bytes);
+		}
+	};
+	std::vector<unsigned char> rvlBytes = rtabmap_ros::compressDepthRVL(depthMsgs[0]->image);
+	{
+		// RVL is lossless
+		cv::Mat depth = rtabmap_ros::uncompressDepthRVL(rvlBytes);
+		const cv::Mat & original = depthMsgs[0]->image;
+		UASSERT(depth.size() == original.size() && depth.type() == original.type());
+		UASSERT(cv::countNonZero(depth != original) == 0);
+		UASSERT(rtabmap::uncompressImage(rtabmap::compressImage(original, ".png")).size() == original.size());
+	}
+	run("depth png", opt, boost::bind(&DepthCompression::png, boost::cref(depthMsgs[0]->image)));
+	run("depth rvl", opt, boost::bind(&DepthCompression::rvl, boost::cref(depthMsgs[0]->image)));
+	run("depth rvl decode", opt, boost::bind(&DepthCompression::rvlDecode, boost::cref(rvlBytes)));
+
+#if CV_MAJOR_VERSION >= 3
+	cv::Mat::setDefaultAllocator(0);
+#endif
+
+	return 0;
+}
@@ -83,7 +83,14 @@ OdometryROS::OdometryROS(bool stereoParams, bool visParams, bool icpParams) :
 	maxUpdateRate_(0.0),
 	odomStrategy_(Parameters::defaultOdomStrategy()),
 	waitIMUToinit_(false),
-	imuProcessed_(false)
+	imuProcessed_(false),
+	asyncProcess_(false),
+	asyncQueueSize_(1),
+	asyncKeepLatest_(false),
+	processingThread_(0),
+	processingThreadRunning_(false),
+	droppedFrames_(0),
+	droppedFramesTotal_(0)
 {
 
 }
@@ -97,9 +104,26 @@ OdometryROS::~OdometryROS()
 		delete warningThread_;
 	}
 
+	stopAsyncProcessing();
+
 	delete odometry_;
 }
 
+void OdometryROS::stopAsyncProcessing()
+{
+	if(processingThread_)
+	{
+		{
+			boost::mutex::scoped_lock lock(queueMutex_);
+			processingThreadRunning_ = false;
+			queueCondition_.notify_all();
+		}
+		processingThread_->join();
+		delete processingThread_;
+		processingThread_ = 0;
+	}
+}
+
 void OdometryROS::onInit()
 {
 	ros::NodeHandle & nh = getNodeHandle();
@@ -151,6 +175,25 @@ void OdometryROS::onInit()
 
 	pnh.param("wait_imu_to_init", waitIMUToinit_, waitIMUToinit_);
 
+	std::string asyncDropPolicy = "drop_oldest";
+	pnh.param("async_process", asyncProcess_, asyncProcess_);
+	pnh.param("async_queue_size", asyncQueueSize_, asyncQueueSize_);
+	pnh.param("async_drop_policy", asyncDropPolicy, asyncDropPolicy); // "drop_oldest" or "keep_latest"
+	if(asyncQueueSize_ < 1)
+	{
+		NODELET_WARN("Parameter \"async_queue_size\" should be >= 1 (value=%d), setting it to 1.", asyncQueueSize_);
+		asyncQueueSize_ = 1;
+	}
+	if(asyncDropPolicy.compare("keep_latest") == 0)
+	{
+		asyncKeepLatest_ = true;
+	}
+	else if(asyncDropPolicy.compare("drop_oldest") != 0)
+	{
+		NODELET_WARN("Unknown \"async_drop_policy\" value \"%s\" (should be \"drop_oldest\" or \"keep_latest\"), \"drop_oldest\" is used.", asyncDropPolicy.c_str());
+		asyncDropPolicy = "drop_oldest";
+	}
+
 	if(publishTf_ && !guessFrameId_.empty() && guessFrameId_.compare(odomFrameId_) == 0)
 	{
 		NODELET_WARN( "\"publish_tf\" and \"guess_frame_id\" cannot be used "
@@ -175,6 +218,9 @@ void OdometryROS::onInit()
 	NODELET_INFO("Odometry: expected_update_rate   = %f Hz", expectedUpdateRate_);
 	NODELET_INFO("Odometry: max_update_rate        = %f Hz", maxUpdateRate_);
 	NODELET_INFO("Odometry: wait_imu_to_init       = %s", waitIMUToinit_?"true":"false");
+	NODELET_INFO("Odometry: async_process          = %s", asyncProcess_?"true":"false");
+	NODELET_INFO("Odometry: async_queue_size       = %d", asyncQueueSize_);
+	NODELET_INFO("Odometry: async_drop_policy      = %s", asyncDropPolicy.c_str());
 
 	configPath = uReplaceChar(configPath, '~', UDirectory::homeDir());
 	if(configPath.size() && configPath.at(0) != '/')
@@ -366,6 +412,12 @@ void OdometryROS::onInit()
 		NODELET_INFO("odometry: Subscribing to IMU topic %s", imuSub_.getTopic().c_str());
 	}
 
+	if(asyncProcess_)
+	{
+		processingThreadRunning_ = true;
+		processingThread_ = new boost::thread(boost::bind(&OdometryROS::processingLoop, this));
+	}
+
 	onOdomInit();
 }
 
@@ -440,66 +492,129 @@ void OdometryROS::callbackIMU(const sensor_msgs::ImuConstPtr& msg)
 			return;
 		}
 
-		IMU imu(cv::Vec4d(msg->orientation.x, msg->orientation.y, msg->orientation.z, msg->orientation.w),
-				cv::Mat(3,3,CV_64FC1,(void*)msg->orientation_covariance.data()).clone(),
-				cv::Vec3d(msg->angular_velocity.x, msg->angular_velocity.y, msg->angular_velocity.z),
-				cv::Mat(3,3,CV_64FC1,(void*)msg->angular_velocity_covariance.data()).clone(),
-				cv::Vec3d(msg->linear_acceleration.x, msg->linear_acceleration.y, msg->linear_acceleration.z),
-				cv::Mat(3,3,CV_64FC1,(void*)msg->linear_acceleration_covariance.data()).clone(),
-				localTransform);
-
-		imus_.insert(std::make_pair(stamp, imu));
-
-		if(bufferedData_.first.isValid() && stamp > bufferedData_.first.stamp())
+		SensorData bufferedData;
+		std_msgs::Header bufferedHeader;
 		{
-			SensorData data = bufferedData_.first;
-			bufferedData_.first = SensorData();
-			processData(data, bufferedData_.second);
+			boost::mutex::scoped_lock lock(imuMutex_);
+			if(!imus_.push(*msg, localTransform))
+			{
+				NODELET_WARN_THROTTLE(1, "IMU msg received with stamp %f older than the last one (%f), it is ignored.", stamp, imus_.lastStamp());
+				return;
+			}
+
+			if(bufferedData_.first.isValid() && stamp > bufferedData_.first.stamp())
+			{
+				bufferedData = bufferedData_.first;
+				bufferedHeader = bufferedData_.second;
+				bufferedData_.first = SensorData();
+			}
 		}
 
-		if(imus_.size() > 1000)
+		if(bufferedData.isValid())
 		{
-			imus_.erase(imus_.begin());
+			processData(bufferedData, bufferedHeader);
 		}
 	}
 }
 
 void OdometryROS::processData(SensorData & data, const std_msgs::Header & header)
 {
-	if((waitIMUToinit_ && !imuProcessed_) && odometry_->framesProcessed() == 0 && odometry_->getPose().isIdentity() && imus_.empty())
+	if(!asyncProcess_)
 	{
-		NODELET_WARN("odometry: waiting imu (%s) to initialize orientation (wait_imu_to_init=true)", imuSub_.getTopic().c_str());
+		boost::mutex::scoped_lock lock(processMutex_);
+		processDataImpl(data, header);
 		return;
 	}
 
-	if(waitIMUToinit_ && (imus_.empty() || imus_.rbegin()->first < header.stamp.toSec()))
+	QueuedData queued;
+	queued.data = data;
+	queued.header = header;
+	queued.received = ros::WallTime::now();
+
+	boost::mutex::scoped_lock lock(queueMutex_);
+	while((int)dataQueue_.size() >= asyncQueueSize_)
 	{
-		//NODELET_WARN("No imu received with higher stamp than last image (%f)! Buffering this image until we get more imu msgs...", stamp.toSec());
+		NODELET_DEBUG("Odometry: dropping frame %f, the odometry is too slow (async_queue_size=%d).",
+				dataQueue_.front().header.stamp.toSec(), asyncQueueSize_);
+		dataQueue_.pop_front();
+		++droppedFrames_;
+		++droppedFramesTotal_;
+	}
+	dataQueue_.push_back(queued);
+	queueCondition_.notify_one();
+}
 
-		// keep in cache to process later when we will receive imu msgs
-		if(bufferedData_.first.isValid())
+void OdometryROS::processingLoop()
+{
+	while(true)
+	{
+		QueuedData queued;
 		{
-			NODELET_ERROR("Overwriting previous data! Make sure IMU is "
-					"published faster than data rate. (last image stamp "
-					"buffered=%f and new one is %f, last imu stamp received=%f)",
-					bufferedData_.first.stamp(), data.stamp(), imus_.empty()?0:imus_.rbegin()->first);
+			boost::mutex::scoped_lock lock(queueMutex_);
+			while(processingThreadRunning_ && dataQueue_.empty())
+			{
+				queueCondition_.wait(lock);
+			}
+			if(!processingThreadRunning_)
+			{
+				break;
+			}
+			if(asyncKeepLatest_ && dataQueue_.size() > 1)
+			{
+				// skip directly to the newest frame
+				droppedFrames_ += dataQueue_.size()-1;
+				droppedFramesTotal_ += dataQueue_.size()-1;
+				queued = dataQueue_.back();
+				dataQueue_.clear();
+			}
+			else
+			{
+				queued = dataQueue_.front();
+				dataQueue_.pop_front();
+			}
 		}
-		bufferedData_.first = data;
-		bufferedData_.second = header;
-		return;
+		NODELET_DEBUG("Odometry: frame %f waited %fs in the queue.", queued.header.stamp.toSec(), (ros::WallTime::now() - queued.received).toSec());
+
+		boost::mutex::scoped_lock lock(processMutex_);
+		processDataImpl(queued.data, queued.header);
 	}
-	// process all imu data up to current image stamp (or just after so that underlying odom approach can do interpolation of imu at image stamp)
-	std::map<double, rtabmap::IMU>::iterator iterEnd = imus_.lower_bound(header.stamp.toSec());
-	if(iterEnd!= imus_.end())
+}
+
+void OdometryROS::processDataImpl(SensorData & data, const std_msgs::Header & header)
+{
+	std::vector<ImuBuffer::Sample> imusToProcess;
 	{
-		++iterEnd;
+		boost::mutex::scoped_lock lock(imuMutex_);
+		if((waitIMUToinit_ && !imuProcessed_) && odometry_->framesProcessed() == 0 && odometry_->getPose().isIdentity() && imus_.empty())
+		{
+			NODELET_WARN("odometry: waiting imu (%s) to initialize orientation (wait_imu_to_init=true)", imuSub_.getTopic().c_str());
+			return;
+		}
+
+		if(waitIMUToinit_ && (imus_.empty() || imus_.lastStamp() < header.stamp.toSec()))
+		{
+			//NODELET_WARN("No imu received with higher stamp than last image (%f)! Buffering this image until we get more imu msgs...", stamp.toSec());
+
+			// keep in cache to process later when we will receive imu msgs
+			if(bufferedData_.first.isValid())
+			{
+				NODELET_ERROR("Overwriting previous data! Make sure IMU is "
+						"published faster than data rate. (last image stamp "
+						"buffered=%f and new one is %f, last imu stamp received=%f)",
+						bufferedData_.first.stamp(), data.stamp(), imus_.lastStamp());
+			}
+			bufferedData_.first = data;
+			bufferedData_.second = header;
+			return;
+		}
+		// process all imu data up to current image stamp (or just after so that underlying odom approach can do interpolation of imu at image stamp)
+		imusToProcess = imus_.takeUntil(header.stamp.toSec());
 	}
-	for(std::map<double, rtabmap::IMU>::iterator iter=imus_.begin(); iter!=iterEnd;)
+	for(size_t i=0; i<imusToProcess.size(); ++i)
 	{
-		//NODELET_WARN("img callback: process imu   %f", iter->first);
-		SensorData dataIMU(iter->second, 0, iter->first);
+		//NODELET_WARN("img callback: process imu   %f", imusToProcess[i].stamp);
+		SensorData dataIMU(ImuBuffer::toIMU(imusToProcess[i]), 0, imusToProcess[i].stamp);
 		odometry_->process(dataIMU);
-		imus_.erase(iter++);
 		imuProcessed_ = true;
 	}
 
@@ -895,6 +1010,13 @@ void OdometryROS::processData(SensorData & data, const std_msgs::Header & header
 		odomInfoToROS(info, infoMsg, odomInfoPub_.getNumSubscribers()==0);
 		infoMsg.header.stamp = header.stamp; // use corresponding time stamp to image
 		infoMsg.header.frame_id = odomFrameId_;
+		if(asyncProcess_)
+		{
+			boost::mutex::scoped_lock lock(queueMutex_);
+			infoMsg.droppedFrames = droppedFrames_;
+			infoMsg.droppedFramesTotal = droppedFramesTotal_;
+			droppedFrames_ = 0;
+		}
 		if(odomInfoPub_.getNumSubscribers()>0) {
 			odomInfoPub_.publish(infoMsg);
 		}
@@ -970,14 +1092,22 @@ bool OdometryROS::resetToPose(rtabmap_ros::ResetPose::Request& req, rtabmap_ros:
 
 void OdometryROS::reset(const Transform & pose)
 {
+	{
+		boost::mutex::scoped_lock lock(queueMutex_);
+		dataQueue_.clear();
+	}
+	boost::mutex::scoped_lock lock(processMutex_);
 	odometry_->reset(pose);
 	guess_.setNull();
 	guessPreviousPose_.setNull();
 	previousStamp_ = 0.0;
 	resetCurrentCount_ = resetCountdown_;
 	imuProcessed_ = false;
-	bufferedData_.first= SensorData();
-	imus_.clear();
+	{
+		boost::mutex::scoped_lock imuLock(imuMutex_);
+		bufferedData_.first= SensorData();
+		imus_.clear();
+	}
 	this->flushCallbacks();
 }
 
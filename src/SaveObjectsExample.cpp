@@ -40,6 +40,7 @@ class SaveObjectsExample
 public:
 	SaveObjectsExample() :
         objFramePrefix_("object"),
+        graphId_(0),
         frameId_("base_link")
     {
         ros::NodeHandle pnh("~");
@@ -99,11 +100,14 @@ public:
     // from rtabmap to rviz visualization
     void mapDataCallback(const rtabmap_ros::MapDataConstPtr & msg)
     {
-        std::map<int, rtabmap::Signature> signatures;
-        std::map<int, rtabmap::Transform> poses;
-        std::multimap<int, rtabmap::Link> links;
         rtabmap::Transform mapToOdom;
-        rtabmap_ros::mapDataFromROS(*msg, poses, links, signatures, mapToOdom);
+        std::map<int, rtabmap::Signature> signatures;
+        if(!rtabmap_ros::mapDataDeltaFromROS(*msg, graphPoses_, graphLinks_, signatures, mapToOdom, graphId_))
+        {
+            ROS_WARN("Waiting for a complete graph...");
+            return;
+        }
+        const std::map<int, rtabmap::Transform> & poses = graphPoses_;
 
         // handle the case where we can receive only latest data, or if all data are published
         for(std::map<int, rtabmap::Signature>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
@@ -140,7 +144,7 @@ public:
 
         if(nodeToObjects_.size())
         {
-            for(std::map<int, rtabmap::Transform>::iterator iter=poses.lower_bound(1); iter!=poses.end(); ++iter)
+            for(std::map<int, rtabmap::Transform>::const_iterator iter=poses.lower_bound(1); iter!=poses.end(); ++iter)
             {
                 if(nodeToObjects_.find(iter->first) != nodeToObjects_.end())
                 {
@@ -259,6 +263,9 @@ private:
     ros::Publisher pubMarkers_;
     std::map<int, cv::Mat> nodeToObjects_;
     std::map<double, int> nodeStamps_; // <stamp, id>
+    std::map<int, rtabmap::Transform> graphPoses_; // complete graph, mapData may only contain a delta
+    std::multimap<int, rtabmap::Link> graphLinks_;
+    unsigned int graphId_;
     std::string frameId_;
 };
 
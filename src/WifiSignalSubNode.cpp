@@ -119,16 +119,22 @@ void HSVtoRGB( float *r, float *g, float *b, float h, float s, float v )
 ros::Publisher wifiSignalCloudPub;
 std::map<double, int> wifiLevels;
 std::map<double, int> nodeStamps_;
+std::map<int, rtabmap::Transform> graphPoses_; // complete graph, mapData may only contain a delta
+std::multimap<int, rtabmap::Link> graphLinks_;
+unsigned int graphId_ = 0;
 
 void mapDataCallback(const rtabmap_ros::MapDataConstPtr & mapDataMsg)
 {
 	ROS_INFO("Received map data!");
 
 	rtabmap::Transform mapToOdom;
-	std::map<int, rtabmap::Transform> poses;
-	std::multimap<int, rtabmap::Link> links;
 	std::map<int, rtabmap::Signature> signatures;
-	rtabmap_ros::mapDataFromROS(*mapDataMsg, poses, links, signatures, mapToOdom);
+	if(!rtabmap_ros::mapDataDeltaFromROS(*mapDataMsg, graphPoses_, graphLinks_, signatures, mapToOdom, graphId_))
+	{
+		ROS_WARN("Waiting for a complete graph...");
+		return;
+	}
+	const std::map<int, rtabmap::Transform> & poses = graphPoses_;
 
 	// handle the case where we can receive only latest data, or if all data are published
 	for(std::map<int, rtabmap::Signature>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
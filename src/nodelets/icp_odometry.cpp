@@ -76,6 +76,7 @@ public:
 
 	virtual ~ICPOdometry()
 	{
+		stopAsyncProcessing();
 		plugins_.clear();
 	}
 
@@ -53,6 +53,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/util3d_filtering.h>
 #include <rtabmap/core/Version.h>
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace rtabmap_ros
 {
 
@@ -83,6 +86,7 @@ public:
 		rangeMin_(0),
 		rangeMax_(0),
 		voxelSize_(0),
+		voxelHash_(false),
 		noiseRadius_(0),
 		noiseMinNeighbors_(5),
 		removeZ_(false),
@@ -125,6 +129,7 @@ private:
 		pnh.param("range_min", rangeMin_, rangeMin_);
 		pnh.param("range_max", rangeMax_, rangeMax_);
 		pnh.param("voxel_size", voxelSize_, voxelSize_);
+		pnh.param("voxel_hash", voxelHash_, voxelHash_);
 		pnh.param("noise_radius", noiseRadius_, noiseRadius_);
 		pnh.param("noise_min_neighbors", noiseMinNeighbors_, noiseMinNeighbors_);
 		pnh.param("remove_z", removeZ_, removeZ_);
@@ -144,6 +149,7 @@ private:
 		ROS_INFO("%s: range_min=%f", getName().c_str(), rangeMin_);
 		ROS_INFO("%s: range_max=%f", getName().c_str(), rangeMax_);
 		ROS_INFO("%s: voxel_size=%fm", getName().c_str(), voxelSize_);
+		ROS_INFO("%s: voxel_hash=%s", getName().c_str(), voxelHash_?"true":"false");
 		ROS_INFO("%s: noise_radius=%fm", getName().c_str(), noiseRadius_);
 		ROS_INFO("%s: noise_min_neighbors=%d", getName().c_str(), noiseMinNeighbors_);
 		ROS_INFO("%s: remove_z=%s", getName().c_str(), removeZ_?"true":"false");
@@ -212,7 +218,7 @@ private:
 		else
 		{
 			NODELET_WARN("Reseting point cloud assembler as null odometry has been received.");
-			clouds_.clear();
+			clearClouds();
 		}
 	}
 
@@ -238,7 +244,7 @@ private:
 		else
 		{
 			NODELET_WARN("Reseting point cloud assembler as null odometry has been received.");
-			clouds_.clear();
+			clearClouds();
 		}
 	}
 
@@ -286,6 +292,455 @@ private:
 		return output;
 	}
 
+	static bool sameLayout(const pcl::PCLPointCloud2 & a, const pcl::PCLPointCloud2 & b)
+	{
+		if(a.point_step != b.point_step || a.fields.size() != b.fields.size() || a.is_bigendian != b.is_bigendian)
+		{
+			return false;
+		}
+		for(size_t i=0; i<a.fields.size(); ++i)
+		{
+			if(a.fields[i].name.compare(b.fields[i].name) != 0 ||
+			   a.fields[i].offset != b.fields[i].offset ||
+			   a.fields[i].datatype != b.fields[i].datatype ||
+			   a.fields[i].count != b.fields[i].count)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Concatenate clouds with the same fields in a single preallocated buffer,
+	// copying each cloud only once. Returns null if the clouds cannot be
+	// concatenated directly (different fields or padded rows).
+	static pcl::PCLPointCloud2::Ptr concatenateClouds(const std::list<pcl::PCLPointCloud2::Ptr> & clouds)
+	{
+		UASSERT(!clouds.empty());
+		const pcl::PCLPointCloud2 & first = *clouds.front();
+		size_t totalPoints = 0;
+		bool isDense = true;
+		for(std::list<pcl::PCLPointCloud2::Ptr>::const_iterator iter=clouds.begin(); iter!=clouds.end(); ++iter)
+		{
+			if(!sameLayout(first, **iter) ||
+			   (*iter)->data.size() != (size_t)(*iter)->width*(*iter)->height*(*iter)->point_step)
+			{
+				return pcl::PCLPointCloud2::Ptr();
+			}
+			totalPoints += (*iter)->width*(*iter)->height;
+			isDense = isDense && (*iter)->is_dense;
+		}
+
+		pcl::PCLPointCloud2::Ptr assembled(new pcl::PCLPointCloud2);
+		assembled->header = first.header;
+		assembled->fields = first.fields;
+		assembled->is_bigendian = first.is_bigendian;
+		assembled->point_step = first.point_step;
+		assembled->height = 1;
+		assembled->width = totalPoints;
+		assembled->row_step = assembled->width * assembled->point_step;
+		assembled->is_dense = isDense;
+		assembled->data.resize(totalPoints * assembled->point_step);
+		size_t offset = 0;
+		for(std::list<pcl::PCLPointCloud2::Ptr>::const_iterator iter=clouds.begin(); iter!=clouds.end(); ++iter)
+		{
+			if(!(*iter)->data.empty())
+			{
+				memcpy(assembled->data.data()+offset, (*iter)->data.data(), (*iter)->data.size());
+				offset += (*iter)->data.size();
+			}
+			assembled->header.stamp = std::max(assembled->header.stamp, (*iter)->header.stamp);
+		}
+		return assembled;
+	}
+
+	static bool xyzOffsets(const pcl::PCLPointCloud2 & cloud, int & x, int & y, int & z)
+	{
+		x = y = z = -1;
+		for(size_t i=0; i<cloud.fields.size(); ++i)
+		{
+			if(cloud.fields[i].datatype == pcl::PCLPointField::FLOAT32)
+			{
+				if(cloud.fields[i].name.compare("x") == 0)
+					x = cloud.fields[i].offset;
+				else if(cloud.fields[i].name.compare("y") == 0)
+					y = cloud.fields[i].offset;
+				else if(cloud.fields[i].name.compare("z") == 0)
+					z = cloud.fields[i].offset;
+			}
+		}
+		return x>=0 && y>=0 && z>=0;
+	}
+
+	// 21 bits per axis, enough for +-10 km with 1 cm voxels. Returns false if
+	// the point is out of that range, its key would alias another voxel.
+	static bool voxelKey(float x, float y, float z, float inverseVoxelSize, std::uint64_t & key)
+	{
+		const double half = 1<<20;
+		double fx = std::floor(double(x)*inverseVoxelSize);
+		double fy = std::floor(double(y)*inverseVoxelSize);
+		double fz = std::floor(double(z)*inverseVoxelSize);
+		if(!(fx >= -half && fx < half && fy >= -half && fy < half && fz >= -half && fz < half))
+		{
+			ROS_WARN_THROTTLE(10, "point_cloud_assembler: point (%f,%f,%f) is too far from the fixed frame for "
+					"the voxel hash with voxel_size=%f, falling back to PCL voxel filtering.",
+					x, y, z, 1.0f/inverseVoxelSize);
+			return false;
+		}
+		std::uint64_t ix = static_cast<std::uint64_t>(fx + half);
+		std::uint64_t iy = static_cast<std::uint64_t>(fy + half);
+		std::uint64_t iz = static_cast<std::uint64_t>(fz + half);
+		key = (ix<<42) | (iy<<21) | iz;
+		return true;
+	}
+
+	// Voxel filtering done while assembling: the points are streamed in a
+	// voxel hash, so the full assembled cloud is never created. The output point
+	// of a voxel is the centroid of its points, the other fields are taken from
+	// the first point added in the voxel. Returns null if the clouds
+	// don't have the same fields or float x, y and z fields, or if a point
+	// is out of the voxel key range.
+	static pcl::PCLPointCloud2::Ptr voxelizeClouds(const std::list<pcl::PCLPointCloud2::Ptr> & clouds, float voxelSize)
+	{
+		UASSERT(!clouds.empty() && voxelSize > 0.0f);
+		const pcl::PCLPointCloud2 & first = *clouds.front();
+		int xo, yo, zo;
+		if(!xyzOffsets(first, xo, yo, zo))
+		{
+			return pcl::PCLPointCloud2::Ptr();
+		}
+		size_t totalPoints = 0;
+		for(std::list<pcl::PCLPointCloud2::Ptr>::const_iterator iter=clouds.begin(); iter!=clouds.end(); ++iter)
+		{
+			if(!sameLayout(first, **iter))
+			{
+				return pcl::PCLPointCloud2::Ptr();
+			}
+			totalPoints += (*iter)->width*(*iter)->height;
+		}
+
+		pcl::PCLPointCloud2::Ptr assembled(new pcl::PCLPointCloud2);
+		assembled->header = first.header;
+		assembled->fields = first.fields;
+		assembled->is_bigendian = first.is_bigendian;
+		assembled->point_step = first.point_step;
+		assembled->height = 1;
+		assembled->is_dense = true;
+		assembled->data.reserve(totalPoints * assembled->point_step);
+
+		float inverseVoxelSize = 1.0f/voxelSize;
+		std::unordered_map<std::uint64_t, size_t> voxels;
+		voxels.reserve(totalPoints);
+		std::vector<Eigen::Vector4f, Eigen::aligned_allocator<Eigen::Vector4f> > sums; // x, y, z, count
+		sums.reserve(totalPoints);
+		for(std::list<pcl::PCLPointCloud2::Ptr>::const_iterator iter=clouds.begin(); iter!=clouds.end(); ++iter)
+		{
+			const pcl::PCLPointCloud2 & cloud = **iter;
+			for(size_t row=0; row<cloud.height; ++row)
+			{
+				for(size_t col=0; col<cloud.width; ++col)
+				{
+					const std::uint8_t * pt = &cloud.data[row*cloud.row_step + col*cloud.point_step];
+					float x, y, z;
+					memcpy(&x, pt+xo, sizeof(float));
+					memcpy(&y, pt+yo, sizeof(float));
+					memcpy(&z, pt+zo, sizeof(float));
+					if(!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z))
+					{
+						continue;
+					}
+					std::uint64_t key;
+					if(!voxelKey(x, y, z, inverseVoxelSize, key))
+					{
+						return pcl::PCLPointCloud2::Ptr();
+					}
+					std::pair<std::unordered_map<std::uint64_t, size_t>::iterator, bool> inserted =
+							voxels.insert(std::make_pair(key, sums.size()));
+					if(inserted.second)
+					{
+						assembled->data.insert(assembled->data.end(), pt, pt+cloud.point_step);
+						sums.push_back(Eigen::Vector4f(x, y, z, 1.0f));
+					}
+					else
+					{
+						sums[inserted.first->second] += Eigen::Vector4f(x, y, z, 1.0f);
+					}
+				}
+			}
+			assembled->header.stamp = std::max(assembled->header.stamp, cloud.header.stamp);
+		}
+
+		for(size_t i=0; i<sums.size(); ++i)
+		{
+			std::uint8_t * pt = &assembled->data[i*assembled->point_step];
+			float x = sums[i][0]/sums[i][3];
+			float y = sums[i][1]/sums[i][3];
+			float z = sums[i][2]/sums[i][3];
+			memcpy(pt+xo, &x, sizeof(float));
+			memcpy(pt+yo, &y, sizeof(float));
+			memcpy(pt+zo, &z, sizeof(float));
+		}
+		assembled->width = sums.size();
+		assembled->row_step = assembled->width * assembled->point_step;
+		return assembled;
+	}
+
+	// Voxel hash kept between callbacks in circular_buffer mode. Each voxel
+	// counts the points contributed by every cloud of the window, so adding
+	// or evicting a cloud only touches the points of that cloud. The other
+	// fields (rgb, intensity, normal...) of a voxel are taken from the first
+	// point of the oldest cloud still in the window contributing to it, which
+	// is referenced in the clouds kept by the window (not copied).
+	class VoxelWindow
+	{
+	public:
+		VoxelWindow() : voxelSize_(0.0f), xo_(-1), yo_(-1), zo_(-1), stamp_(0) {}
+
+		bool empty() const {return clouds_.empty();}
+		size_t size() const {return clouds_.size();}
+		bool contains(const pcl::PCLPointCloud2 * cloud) const {return find(cloud) != clouds_.end();}
+
+		void clear()
+		{
+			voxels_.clear();
+			clouds_.clear();
+			layout_ = pcl::PCLPointCloud2();
+		}
+
+		// Returns false if the cloud doesn't have the same fields than the clouds
+		// already added, or if a point is out of the voxel key range (the
+		// window is then cleared).
+		bool add(const pcl::PCLPointCloud2::Ptr & cloud, float voxelSize)
+		{
+			UASSERT(cloud.get() && voxelSize > 0.0f);
+			if(clouds_.empty())
+			{
+				voxels_.clear();
+				layout_ = pcl::PCLPointCloud2();
+				layout_.fields = cloud->fields;
+				layout_.point_step = cloud->point_step;
+				layout_.is_bigendian = cloud->is_bigendian;
+				voxelSize_ = voxelSize;
+				if(!xyzOffsets(layout_, xo_, yo_, zo_))
+				{
+					return false;
+				}
+			}
+			else if(voxelSize != voxelSize_ || !sameLayout(layout_, *cloud))
+			{
+				return false;
+			}
+			if(contains(cloud.get()))
+			{
+				return true;
+			}
+
+			// voxel key and offset of the points, sorted to group the points of a voxel
+			float inverseVoxelSize = 1.0f/voxelSize_;
+			std::vector<std::pair<std::uint64_t, size_t> > points;
+			points.reserve(cloud->width*cloud->height);
+			for(size_t row=0; row<cloud->height; ++row)
+			{
+				for(size_t col=0; col<cloud->width; ++col)
+				{
+					size_t offset = row*cloud->row_step + col*cloud->point_step;
+					float x, y, z;
+					readXYZ(*cloud, offset, x, y, z);
+					if(!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z))
+					{
+						continue;
+					}
+					std::uint64_t key;
+					if(!voxelKey(x, y, z, inverseVoxelSize, key))
+					{
+						clear();
+						return false;
+					}
+					points.push_back(std::make_pair(key, offset));
+				}
+			}
+			std::sort(points.begin(), points.end());
+
+			clouds_.push_back(std::make_pair(pcl::PCLPointCloud2::ConstPtr(cloud), std::vector<Contribution>()));
+			std::vector<Contribution> & contributions = clouds_.back().second;
+			for(size_t i=0; i<points.size(); ++i)
+			{
+				if(i == 0 || points[i].first != points[i-1].first)
+				{
+					contributions.push_back(Contribution());
+					contributions.back().key = points[i].first;
+					contributions.back().offset = points[i].second; // first point of the cloud in the voxel
+				}
+				float x, y, z;
+				readXYZ(*cloud, points[i].second, x, y, z);
+				Contribution & c = contributions.back();
+				c.x += x;
+				c.y += y;
+				c.z += z;
+				++c.count;
+			}
+			for(size_t i=0; i<contributions.size(); ++i)
+			{
+				const Contribution & c = contributions[i];
+				Voxel & v = voxels_[c.key];
+				if(v.count == 0)
+				{
+					v.cloud = cloud.get();
+					v.offset = c.offset;
+				}
+				v.x += c.x;
+				v.y += c.y;
+				v.z += c.z;
+				v.count += c.count;
+			}
+			stamp_ = cloud->header.stamp;
+			return true;
+		}
+
+		void remove(const pcl::PCLPointCloud2 * cloud)
+		{
+			CloudList::iterator iter = find(cloud);
+			if(iter == clouds_.end())
+			{
+				return;
+			}
+			const std::vector<Contribution> & contributions = iter->second;
+			for(size_t i=0; i<contributions.size(); ++i)
+			{
+				const Contribution & c = contributions[i];
+				std::unordered_map<std::uint64_t, Voxel>::iterator jter = voxels_.find(c.key);
+				UASSERT(jter != voxels_.end() && jter->second.count >= c.count);
+				Voxel & v = jter->second;
+				v.count -= c.count;
+				if(v.count == 0)
+				{
+					voxels_.erase(jter);
+					continue;
+				}
+				v.x -= c.x;
+				v.y -= c.y;
+				v.z -= c.z;
+				if(v.cloud == cloud)
+				{
+					// take the point of the next oldest cloud contributing to the voxel
+					v.cloud = 0;
+					for(CloudList::const_iterator kter=clouds_.begin(); v.cloud==0 && kter!=clouds_.end(); ++kter)
+					{
+						if(kter != iter)
+						{
+							std::vector<Contribution>::const_iterator lter = std::lower_bound(kter->second.begin(), kter->second.end(), c);
+							if(lter != kter->second.end() && lter->key == c.key)
+							{
+								v.cloud = kter->first.get();
+								v.offset = lter->offset;
+							}
+						}
+					}
+					UASSERT(v.cloud != 0);
+				}
+			}
+			clouds_.erase(iter);
+		}
+
+		// Centroid of each live voxel, the other fields are taken from the
+		// first point of the oldest cloud contributing to the voxel.
+		pcl::PCLPointCloud2::Ptr output() const
+		{
+			pcl::PCLPointCloud2::Ptr assembled(new pcl::PCLPointCloud2);
+			*assembled = layout_;
+			assembled->header.stamp = stamp_;
+			assembled->height = 1;
+			assembled->width = voxels_.size();
+			assembled->row_step = assembled->width * assembled->point_step;
+			assembled->is_dense = true;
+			assembled->data.resize(assembled->row_step);
+			std::uint8_t * pt = assembled->data.data();
+			for(std::unordered_map<std::uint64_t, Voxel>::const_iterator iter=voxels_.begin(); iter!=voxels_.end(); ++iter)
+			{
+				memcpy(pt, &iter->second.cloud->data[iter->second.offset], assembled->point_step);
+				float x = iter->second.x/iter->second.count;
+				float y = iter->second.y/iter->second.count;
+				float z = iter->second.z/iter->second.count;
+				memcpy(pt+xo_, &x, sizeof(float));
+				memcpy(pt+yo_, &y, sizeof(float));
+				memcpy(pt+zo_, &z, sizeof(float));
+				pt += assembled->point_step;
+			}
+			return assembled;
+		}
+
+	private:
+		struct Sum
+		{
+			Sum() : x(0), y(0), z(0), count(0), offset(0) {}
+			double x, y, z;
+			int count;
+			size_t offset; // offset of the first point in the cloud data
+		};
+		// Points of a cloud in a voxel, sorted by key in each cloud
+		struct Contribution : public Sum
+		{
+			Contribution() : key(0) {}
+			std::uint64_t key;
+			bool operator<(const Contribution & c) const {return key < c.key;}
+		};
+		struct Voxel : public Sum
+		{
+			Voxel() : cloud(0) {}
+			const pcl::PCLPointCloud2 * cloud; // oldest cloud contributing to the voxel
+		};
+		// clouds of the window, oldest first
+		typedef std::list<std::pair<pcl::PCLPointCloud2::ConstPtr, std::vector<Contribution> > > CloudList;
+
+		CloudList::iterator find(const pcl::PCLPointCloud2 * cloud)
+		{
+			CloudList::iterator iter = clouds_.begin();
+			while(iter != clouds_.end() && iter->first.get() != cloud)
+			{
+				++iter;
+			}
+			return iter;
+		}
+		CloudList::const_iterator find(const pcl::PCLPointCloud2 * cloud) const
+		{
+			return const_cast<VoxelWindow*>(this)->find(cloud);
+		}
+		void readXYZ(const pcl::PCLPointCloud2 & cloud, size_t offset, float & x, float & y, float & z) const
+		{
+			const std::uint8_t * pt = &cloud.data[offset];
+			memcpy(&x, pt+xo_, sizeof(float));
+			memcpy(&y, pt+yo_, sizeof(float));
+			memcpy(&z, pt+zo_, sizeof(float));
+		}
+
+		float voxelSize_;
+		int xo_, yo_, zo_;
+		pcl::PCLPointCloud2 layout_;
+#if PCL_VERSION_COMPARE(>=, 1, 10, 0)
+		std::uint64_t stamp_;
+#else
+		pcl::uint64_t stamp_;
+#endif
+		std::unordered_map<std::uint64_t, Voxel> voxels_;
+		CloudList clouds_;
+	};
+
+	void clearClouds()
+	{
+		clouds_.clear();
+		voxelWindow_.clear();
+	}
+	void popFrontCloud()
+	{
+		voxelWindow_.remove(clouds_.front().get());
+		clouds_.pop_front();
+	}
+	void popBackCloud()
+	{
+		voxelWindow_.remove(clouds_.back().get());
+		clouds_.pop_back();
+	}
+
 	void callbackCloud(const sensor_msgs::PointCloud2ConstPtr & cloudMsg)
 	{
 		if(cloudPub_.getNumSubscribers())
@@ -307,7 +762,7 @@ private:
 				if(pose.isNull())
 				{
 					ROS_ERROR("Cloud not transform all clouds! Resetting...");
-					clouds_.clear();
+					clearClouds();
 					return;
 				}
 
@@ -369,8 +824,53 @@ private:
 
 				if( circularBuffer_ || reachedMaxSize )
 				{
-					pcl::PCLPointCloud2Ptr assembled(new pcl::PCLPointCloud2);
-					for(std::list<pcl::PCLPointCloud2::Ptr>::iterator iter=clouds_.begin(); iter!=clouds_.end(); ++iter)
+					bool voxelized = false;
+					pcl::PCLPointCloud2Ptr assembled;
+					if(voxelSize_>0.0 && voxelHash_ && circularBuffer_)
+					{
+						// only the new cloud is added to the window if the window
+						// already contains all the other clouds
+						bool added = voxelWindow_.size()+1 == clouds_.size() && voxelWindow_.add(newCloud, voxelSize_);
+						if(!added)
+						{
+							// fields changed or the window has been cleared after
+							// a failed rebuild, rebuild it from all the clouds
+							voxelWindow_.clear();
+							added = true;
+							for(std::list<pcl::PCLPointCloud2::Ptr>::iterator iter=clouds_.begin(); added && iter!=clouds_.end(); ++iter)
+							{
+								added = voxelWindow_.add(*iter, voxelSize_);
+							}
+						}
+						if(added)
+						{
+							UASSERT_MSG(voxelWindow_.size() == clouds_.size(),
+									uFormat("window=%d clouds=%d", (int)voxelWindow_.size(), (int)clouds_.size()).c_str());
+							assembled = voxelWindow_.output();
+							voxelized = true;
+						}
+						else
+						{
+							// use voxelizeClouds() below until the window can be rebuilt
+							voxelWindow_.clear();
+						}
+					}
+					if(!assembled && voxelSize_>0.0 && voxelHash_)
+					{
+						assembled = voxelizeClouds(clouds_, voxelSize_);
+						voxelized = assembled.get() != 0;
+					}
+					if(!assembled)
+					{
+						assembled = concatenateClouds(clouds_);
+					}
+					bool pairwise = !assembled;
+					if(pairwise)
+					{
+						// clouds with different fields, let pcl handle them
+						assembled.reset(new pcl::PCLPointCloud2);
+					}
+					for(std::list<pcl::PCLPointCloud2::Ptr>::iterator iter=clouds_.begin(); pairwise && iter!=clouds_.end(); ++iter)
 					{
 						if(assembled->data.empty())
 						{
@@ -391,7 +891,7 @@ private:
 					}
 
 					sensor_msgs::PointCloud2 rosCloud;
-					if(voxelSize_>0.0)
+					if(voxelSize_>0.0 && !voxelized)
 					{
 						// estimate if there would be an overflow
 						int x_idx=-1, y_idx=-1, z_idx=-1;
@@ -465,7 +965,7 @@ private:
 						if(t.isNull())
 						{
 							ROS_ERROR("Cloud not transform back assembled clouds in target frame \"%s\"! Resetting...", frameId_.c_str());
-							clouds_.clear();
+							clearClouds();
 							return;
 						}
 					}
@@ -486,26 +986,26 @@ private:
 					{
 						if(!isMoving)
 						{
-							clouds_.pop_back();
+							popBackCloud();
 						}
 						else
 						{
 							previousPose_ = pose;
 							if(reachedMaxSize)
 							{
-								clouds_.pop_front();
+								popFrontCloud();
 							}
 						}
 					}
 					else
 					{
-						clouds_.clear();
+						clearClouds();
 						previousPose_.setNull();
 					}
 				}
 				else if(!isMoving)
 				{
-					clouds_.pop_back();
+					popBackCloud();
 				}
 				else
 				{
@@ -562,6 +1062,7 @@ private:
 	double rangeMin_;
 	double rangeMax_;
 	double voxelSize_;
+	bool voxelHash_;
 	double noiseRadius_;
 	int noiseMinNeighbors_;
 	bool removeZ_;
@@ -571,6 +1072,7 @@ private:
 	rtabmap::Transform previousPose_;
 
 	std::list<pcl::PCLPointCloud2::Ptr> clouds_;
+	VoxelWindow voxelWindow_;
 };
 
 PLUGINLIB_EXPORT_CLASS(rtabmap_ros::PointCloudAssembler, nodelet::Nodelet);
@@ -79,6 +79,7 @@ public:
 
 	virtual ~RGBDOdometry()
 	{
+		stopAsyncProcessing();
 		rgbdSub_.shutdown();
 		rgbdxSub_.shutdown();
 		if(approxSync_)
@@ -402,7 +403,6 @@ private:
 			imageWidth/depthWidth == imageHeight/depthHeight,
 			uFormat("rgb=%dx%d depth=%dx%d", imageWidth, imageHeight, depthWidth, depthHeight).c_str());
 
-		int cameraCount = rgbImages.size();
 		cv::Mat rgb;
 		cv::Mat depth;
 		std::vector<rtabmap::CameraModel> cameraModels;
@@ -478,56 +478,20 @@ private:
 				}
 			}
 
-
-			cv_bridge::CvImageConstPtr ptrImage = rgbImages[i];
-			if(rgbImages[i]->encoding.compare(sensor_msgs::image_encodings::TYPE_8UC1) !=0 &&
-			   rgbImages[i]->encoding.compare(sensor_msgs::image_encodings::MONO8) != 0)
-			{
-				if(keepColor_ && rgbImages[i]->encoding.compare(sensor_msgs::image_encodings::MONO16) != 0)
-				{
-					ptrImage = cv_bridge::cvtColor(rgbImages[i], "bgr8");
-				}
-				else
-				{
-					ptrImage = cv_bridge::cvtColor(rgbImages[i], "mono8");
-				}
-			}
-
-			cv_bridge::CvImageConstPtr ptrDepth = depthImages[i];
-
-			// initialize
-			if(rgb.empty())
-			{
-				rgb = cv::Mat(imageHeight, imageWidth*cameraCount, ptrImage->image.type());
-			}
-			if(depth.empty())
-			{
-				depth = cv::Mat(depthHeight, depthWidth*cameraCount, ptrDepth->image.type());
-			}
-
-			if(ptrImage->image.type() == rgb.type())
-			{
-				ptrImage->image.copyTo(cv::Mat(rgb, cv::Rect(i*imageWidth, 0, imageWidth, imageHeight)));
-			}
-			else
-			{
-				NODELET_ERROR("Some RGB images are not the same type! %d vs %d", ptrImage->image.type(), rgb.type());
-				return;
-			}
-
-			if(ptrDepth->image.type() == depth.type())
-			{
-				ptrDepth->image.copyTo(cv::Mat(depth, cv::Rect(i*depthWidth, 0, depthWidth, depthHeight)));
-			}
-			else
-			{
-				NODELET_ERROR("Some Depth images are not the same type! %d vs %d", ptrDepth->image.type(), depth.type());
-				return;
-			}
-
 			cameraModels.push_back(rtabmap_ros::cameraModelFromROS(cameraInfos[i], localTransform));
 		}
 
+		if(!rtabmap_ros::imagesToMosaic(rgbImages, keepColor_, rgb))
+		{
+			NODELET_ERROR("Some RGB images are not the same type!");
+			return;
+		}
+		if(!rtabmap_ros::depthsToMosaic(depthImages, depth))
+		{
+			NODELET_ERROR("Some Depth images are not the same type!");
+			return;
+		}
+
 		rtabmap::SensorData data(
 				rgb,
 				depth,
@@ -181,7 +181,7 @@ private:
 					// depth image
 					cv_bridge::CvImagePtr ptr = boost::make_shared<cv_bridge::CvImage>();
 					ptr->header = input->depth_compressed.header;
-					ptr->image = rtabmap::uncompressImage(input->depth_compressed.data);
+					ptr->image = rtabmap_ros::uncompressDepth(input->depth_compressed);
 					ROS_ASSERT(ptr->image.empty() || ptr->image.type() == CV_32FC1 || ptr->image.type() == CV_16UC1);
 					ptr->encoding = ptr->image.empty()?"":ptr->image.type() == CV_32FC1?sensor_msgs::image_encodings::TYPE_32FC1:sensor_msgs::image_encodings::TYPE_16UC1;
 					ptr->toImageMsg(output.depth);
@@ -63,6 +63,14 @@ public:
 		depthScale_(1.0),
 		decimation_(1),
 		compressedRate_(0),
+		compressedDepthFormat_("png"),
+		compressedAsync_(false),
+		compressionThread_(0),
+		compressionThreadRunning_(false),
+		depthThread_(0),
+		depthThreadRunning_(false),
+		depthJobInput_(0),
+		depthJobOutput_(0),
 		warningThread_(0),
 		callbackCalled_(false),
 		approxSyncDepth_(0),
@@ -82,6 +90,28 @@ public:
 			warningThread_->join();
 			delete warningThread_;
 		}
+
+		if(compressionThread_)
+		{
+			{
+				boost::mutex::scoped_lock lock(compressionMutex_);
+				compressionThreadRunning_ = false;
+				compressionCondition_.notify_all();
+			}
+			compressionThread_->join();
+			delete compressionThread_;
+		}
+
+		if(depthThread_)
+		{
+			{
+				boost::mutex::scoped_lock lock(depthMutex_);
+				depthThreadRunning_ = false;
+				depthCondition_.notify_all();
+			}
+			depthThread_->join();
+			delete depthThread_;
+		}
 	}
 
 private:
@@ -99,6 +129,18 @@ private:
 		pnh.param("depth_scale", depthScale_, depthScale_);
 		pnh.param("decimation", decimation_, decimation_);
 		pnh.param("compressed_rate", compressedRate_, compressedRate_);
+		// "png" or "rvl" (faster, 16UC1 depth only: float depth falls back to "png"),
+		// both lossless
+		pnh.param("compressed_depth_format", compressedDepthFormat_, compressedDepthFormat_);
+		// compress rgb and depth on a worker thread, compressed_depth_format applies the same way
+		pnh.param("compressed_async", compressedAsync_, compressedAsync_);
+
+		if(compressedDepthFormat_.compare("png") != 0 && compressedDepthFormat_.compare("rvl") != 0)
+		{
+			NODELET_WARN("%s: Unknown compressed_depth_format \"%s\" (should be \"png\" or \"rvl\"), \"png\" is used.",
+					getName().c_str(), compressedDepthFormat_.c_str());
+			compressedDepthFormat_ = "png";
+		}
 
 		if(decimation_<1)
 		{
@@ -112,10 +154,18 @@ private:
 		NODELET_INFO("%s: depth_scale = %f", getName().c_str(), depthScale_);
 		NODELET_INFO("%s: decimation = %d", getName().c_str(), decimation_);
 		NODELET_INFO("%s: compressed_rate = %f", getName().c_str(), compressedRate_);
+		NODELET_INFO("%s: compressed_depth_format = %s", getName().c_str(), compressedDepthFormat_.c_str());
+		NODELET_INFO("%s: compressed_async = %s", getName().c_str(), compressedAsync_?"true":"false");
 
 		rgbdImagePub_ = nh.advertise<rtabmap_ros::RGBDImage>("rgbd_image", 1);
 		rgbdImageCompressedPub_ = nh.advertise<rtabmap_ros::RGBDImage>("rgbd_image/compressed", 1);
 
+		if(compressedAsync_)
+		{
+			compressionThreadRunning_ = true;
+			compressionThread_ = new boost::thread(boost::bind(&RGBDSync::compressionLoop, this));
+		}
+
 		if(approxSync)
 		{
 			approxSyncDepth_ = new message_filters::Synchronizer<MyApproxSyncDepthPolicy>(MyApproxSyncDepthPolicy(queueSize), imageSub_, imageDepthSub_, cameraInfoSub_);
@@ -173,6 +223,122 @@ private:
 		}
 	}
 
+	struct CompressionJob
+	{
+		std_msgs::Header header;
+		sensor_msgs::CameraInfo rgbCameraInfo;
+		sensor_msgs::CameraInfo depthCameraInfo;
+		cv_bridge::CvImageConstPtr rgb;   // keeps the input message alive
+		cv_bridge::CvImageConstPtr depth; // keeps the input message alive
+		cv::Mat rgbMat;
+		cv::Mat depthMat;
+	};
+
+	void compressDepth(const cv::Mat & depth, sensor_msgs::CompressedImage & msg) const
+	{
+		if(compressedDepthFormat_.compare("rvl") == 0 && depth.type() == CV_16UC1)
+		{
+			msg.data = rtabmap_ros::compressDepthRVL(depth);
+			msg.format = "rvl";
+		}
+		else
+		{
+			if(compressedDepthFormat_.compare("rvl") == 0)
+			{
+				NODELET_WARN_ONCE("%s: compressed_depth_format is \"rvl\" but depth is not 16UC1, "
+						"\"png\" is used to keep the depth lossless.", getName().c_str());
+			}
+			msg.data = rtabmap::compressImage(depth, ".png");
+			msg.format = "png";
+		}
+	}
+
+	void publishCompressed(const CompressionJob & job)
+	{
+		rtabmap_ros::RGBDImagePtr msgCompressed(new rtabmap_ros::RGBDImage);
+		msgCompressed->header = job.header;
+		msgCompressed->rgb_camera_info = job.rgbCameraInfo;
+		msgCompressed->depth_camera_info = job.depthCameraInfo;
+
+		// encode depth and rgb at the same time
+		msgCompressed->depth_compressed.header = job.depth->header;
+		{
+			boost::mutex::scoped_lock lock(depthMutex_);
+			if(!depthThread_)
+			{
+				depthThreadRunning_ = true;
+				depthThread_ = new boost::thread(boost::bind(&RGBDSync::depthCompressionLoop, this));
+			}
+			depthJobInput_ = &job.depthMat;
+			depthJobOutput_ = &msgCompressed->depth_compressed;
+			depthCondition_.notify_all();
+		}
+
+		cv_bridge::CvImage cvImg;
+		cvImg.header = job.rgb->header;
+		cvImg.image = job.rgbMat;
+		cvImg.encoding = job.rgb->encoding;
+		cvImg.toCompressedImageMsg(msgCompressed->rgb_compressed, cv_bridge::JPG);
+
+		{
+			boost::mutex::scoped_lock lock(depthMutex_);
+			while(depthThreadRunning_ && depthJobInput_ != 0)
+			{
+				depthCondition_.wait(lock);
+			}
+		}
+
+		rgbdImageCompressedPub_.publish(msgCompressed);
+	}
+
+	// Compress the depth image given by publishCompressed() while it compresses the rgb image
+	void depthCompressionLoop()
+	{
+		boost::mutex::scoped_lock lock(depthMutex_);
+		while(true)
+		{
+			while(depthThreadRunning_ && depthJobInput_ == 0)
+			{
+				depthCondition_.wait(lock);
+			}
+			if(!depthThreadRunning_)
+			{
+				break;
+			}
+			const cv::Mat * input = depthJobInput_;
+			sensor_msgs::CompressedImage * output = depthJobOutput_;
+			lock.unlock();
+			compressDepth(*input, *output);
+			lock.lock();
+			depthJobInput_ = 0;
+			depthJobOutput_ = 0;
+			depthCondition_.notify_all();
+		}
+	}
+
+	// Compress the latest frame received while the next one is synchronized
+	void compressionLoop()
+	{
+		while(true)
+		{
+			CompressionJob job;
+			{
+				boost::mutex::scoped_lock lock(compressionMutex_);
+				while(compressionThreadRunning_ && !compressionJob_.rgb.get())
+				{
+					compressionCondition_.wait(lock);
+				}
+				if(!compressionThreadRunning_)
+				{
+					break;
+				}
+				job = compressionJob_;
+				compressionJob_ = CompressionJob();
+			}
+			publishCompressed(job);
+		}
+	}
+
 	void callback(
 			  const sensor_msgs::ImageConstPtr& image,
 			  const sensor_msgs::ImageConstPtr& depth,
@@ -197,7 +363,10 @@ private:
 						depthStamp);
 			}
 
-			rtabmap_ros::RGBDImage msg;
+			// Published as a shared pointer so that subscribers in the same
+			// nodelet manager receive it without serialization.
+			rtabmap_ros::RGBDImagePtr msgPtr(new rtabmap_ros::RGBDImage);
+			rtabmap_ros::RGBDImage & msg = *msgPtr;
 			msg.header.frame_id = cameraInfo->header.frame_id;
 			msg.header.stamp = image->header.stamp>depth->header.stamp?image->header.stamp:depth->header.stamp;
 			if(decimation_>1 && !(depth->width % decimation_ == 0 && depth->height % decimation_ == 0))
@@ -236,60 +405,82 @@ private:
 
 			if(depthScale_ != 1.0)
 			{
-				depthMat*=depthScale_;
+				// don't scale in place, depthMat may share the input buffer
+				depthMat = depthMat*depthScale_;
 			}
 
 			if(rgbdImageCompressedPub_.getNumSubscribers())
 			{
-				bool publishCompressed = true;
+				bool doPublish = true;
 				if (compressedRate_ > 0.0)
 				{
 					if ( lastCompressedPublished_ + ros::Duration(1.0/compressedRate_) > ros::Time::now())
 					{
 						NODELET_DEBUG("throttle last update at %f skipping", lastCompressedPublished_.toSec());
-						publishCompressed = false;
+						doPublish = false;
 					}
 				}
 
-				if(publishCompressed)
+				if(doPublish)
 				{
 					lastCompressedPublished_ = ros::Time::now();
 
-					rtabmap_ros::RGBDImage msgCompressed;
-					msgCompressed.header = msg.header;
-					msgCompressed.rgb_camera_info = msg.rgb_camera_info;
-					msgCompressed.depth_camera_info = msg.depth_camera_info;
+					CompressionJob job;
+					job.header = msg.header;
+					job.rgbCameraInfo = msg.rgb_camera_info;
+					job.depthCameraInfo = msg.depth_camera_info;
+					job.rgb = imagePtr;
+					job.depth = imageDepthPtr;
+					job.rgbMat = rgbMat;
+					job.depthMat = depthMat;
 
+					if(compressedAsync_)
+					{
+						boost::mutex::scoped_lock lock(compressionMutex_);
+						if(compressionJob_.rgb.get())
+						{
+							NODELET_DEBUG("Compression is too slow, skipping frame %f", compressionJob_.header.stamp.toSec());
+						}
+						compressionJob_ = job;
+						compressionCondition_.notify_one();
+					}
+					else
+					{
+						publishCompressed(job);
+					}
+				}
+			}
+
+			if(rgbdImagePub_.getNumSubscribers())
+			{
+				if(decimation_>1)
+				{
 					cv_bridge::CvImage cvImg;
 					cvImg.header = image->header;
 					cvImg.image = rgbMat;
 					cvImg.encoding = image->encoding;
-					cvImg.toCompressedImageMsg(msgCompressed.rgb_compressed, cv_bridge::JPG);
-
-					msgCompressed.depth_compressed.header = imageDepthPtr->header;
-					msgCompressed.depth_compressed.data = rtabmap::compressImage(depthMat, ".png");
-
-					msgCompressed.depth_compressed.format = "png";
+					cvImg.toImageMsg(msg.rgb);
+				}
+				else
+				{
+					// unchanged, copy the buffer directly
+					msg.rgb = *image;
+				}
 
-					rgbdImageCompressedPub_.publish(msgCompressed);
+				if(decimation_>1 || depthScale_ != 1.0)
+				{
+					cv_bridge::CvImage cvDepth;
+					cvDepth.header = depth->header;
+					cvDepth.image = depthMat;
+					cvDepth.encoding = depth->encoding;
+					cvDepth.toImageMsg(msg.depth);
+				}
+				else
+				{
+					msg.depth = *depth;
 				}
-			}
 
-			if(rgbdImagePub_.getNumSubscribers())
-			{
-				cv_bridge::CvImage cvImg;
-				cvImg.header = image->header;
-				cvImg.image = rgbMat;
-				cvImg.encoding = image->encoding;
-				cvImg.toImageMsg(msg.rgb);
-
-				cv_bridge::CvImage cvDepth;
-				cvDepth.header = depth->header;
-				cvDepth.image = depthMat;
-				cvDepth.encoding = depth->encoding;
-				cvDepth.toImageMsg(msg.depth);
-
-				rgbdImagePub_.publish(msg);
+				rgbdImagePub_.publish(msgPtr);
 			}
 
 			if( rgbStamp != image->header.stamp.toSec() ||
@@ -309,6 +500,19 @@ private:
 	double depthScale_;
 	int decimation_;
 	double compressedRate_;
+	std::string compressedDepthFormat_;
+	bool compressedAsync_;
+	boost::thread * compressionThread_;
+	bool compressionThreadRunning_;
+	boost::mutex compressionMutex_;
+	boost::condition_variable compressionCondition_;
+	CompressionJob compressionJob_;
+	boost::thread * depthThread_;
+	bool depthThreadRunning_;
+	boost::mutex depthMutex_;
+	boost::condition_variable depthCondition_;
+	const cv::Mat * depthJobInput_;
+	sensor_msgs::CompressedImage * depthJobOutput_;
 	boost::thread * warningThread_;
 	bool callbackCalled_;
 
@@ -83,6 +83,7 @@ public:
 
 	virtual ~RGBDICPOdometry()
 	{
+		stopAsyncProcessing();
 		if(approxScanSync_)
 		{
 			delete approxScanSync_;
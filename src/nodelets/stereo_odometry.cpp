@@ -77,6 +77,7 @@ public:
 
 	virtual ~StereoOdometry()
 	{
+		stopAsyncProcessing();
 		if(approxSync_)
 		{
 			delete approxSync_;
@@ -31,6 +31,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <OgreSceneNode.h>
 #include <OgreSceneManager.h>
+#include <OgreCamera.h>
 
 #include <ros/time.h>
 
@@ -38,6 +39,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <rviz/display_context.h>
 #include <rviz/frame_manager.h>
+#include <rviz/view_manager.h>
+#include <rviz/view_controller.h>
 #include <rviz/ogre_helpers/point_cloud.h>
 #include <rviz/validate_floats.h>
 #include <rviz/properties/int_property.h>
@@ -57,7 +60,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/Graph.h>
 #include <rtabmap_ros/MsgConversion.h>
 #include <rtabmap_ros/GetMap.h>
+#include <rtabmap_ros/GetMapChunk.h>
 #include <std_msgs/Int32MultiArray.h>
+#include <boost/unordered_set.hpp>
 
 
 namespace rtabmap_ros
@@ -68,7 +73,8 @@ MapCloudDisplay::CloudInfo::CloudInfo() :
 		manager_(0),
 		pose_(rtabmap::Transform::getIdentity()),
 		id_(0),
-		scene_node_(0)
+		scene_node_(0),
+		lod_(0)
 {}
 
 MapCloudDisplay::CloudInfo::~CloudInfo()
@@ -92,6 +98,11 @@ MapCloudDisplay::MapCloudDisplay()
     new_color_transformer_(false),
     needs_retransform_(false),
     transformer_class_loader_(NULL),
+	cloud_jobs_running_(0),
+	cloud_jobs_generation_(0),
+	cloud_jobs_sequence_(0),
+	cloud_workers_stopped_(false),
+	graph_id_(0),
 	current_map_updated_(false)
 {
 	//QIcon icon;
@@ -189,6 +200,22 @@ MapCloudDisplay::MapCloudDisplay()
 	node_filtering_angle_->setMin( 0.0f );
 	node_filtering_angle_->setMax( 359.0f );
 
+	lod_distance_ = new rviz::FloatProperty( "LOD distance (m)", 0.0f,
+										 "(Disabled=0) Clouds farther than this distance from the camera are shown "
+										 "with half the resolution, then again each time the distance doubles.",
+										 this, SLOT( updateLevelOfDetailParameters() ), this );
+	lod_distance_->setMin( 0.0f );
+
+	point_budget_ = new rviz::IntProperty( "Point budget", 0,
+										 "(Disabled=0) Maximum number of points shown, the resolution of the "
+										 "farthest clouds is reduced to respect it.",
+										 this, SLOT( updateLevelOfDetailParameters() ), this );
+	point_budget_->setMin( 0 );
+
+	frustum_culling_ = new rviz::BoolProperty( "Frustum culling", true,
+										 "Hide the clouds outside the camera view.",
+										 this );
+
 	download_namespace = new rviz::StringProperty("Download namespace", "rtabmap", "Namespace used to call Download services below", this, SLOT( downloadNamespaceChanged() ), this);
 
 	download_map_ = new rviz::BoolProperty( "Download map", false,
@@ -208,6 +235,14 @@ MapCloudDisplay::MapCloudDisplay()
 
 MapCloudDisplay::~MapCloudDisplay()
 {
+	{
+		boost::mutex::scoped_lock lock(cloud_jobs_mutex_);
+		cloud_workers_stopped_ = true;
+		cloud_jobs_.clear();
+		cloud_jobs_condition_.notify_all();
+	}
+	cloud_workers_.join_all();
+
 	if ( transformer_class_loader_ )
 	{
 		delete transformer_class_loader_;
@@ -262,98 +297,183 @@ void MapCloudDisplay::onInitialize()
 	updateBillboardSize();
 	updateAlpha();
 
+	int threads = std::max(1, (int)boost::thread::hardware_concurrency());
+	for(int i=0; i<threads; ++i)
+	{
+		cloud_workers_.create_thread(boost::bind(&MapCloudDisplay::cloudWorker, this));
+	}
+
 	spinner_.start();
 }
 
 void MapCloudDisplay::processMessage( const rtabmap_ros::MapDataConstPtr& msg )
 {
-	processMapData(*msg);
+	processMapData(msg);
 
 	this->emitTimeSignal(msg->header.stamp);
 }
 
-void MapCloudDisplay::processMapData(const rtabmap_ros::MapData& map)
+void MapCloudDisplay::processMapData(const rtabmap_ros::MapDataConstPtr& map)
 {
 	std::map<int, rtabmap::Transform> poses;
-	for(unsigned int i=0; i<map.graph.posesId.size() && i<map.graph.poses.size(); ++i)
+	bool graphUpdated = false;
+	if(map->graph.posesId.size() != map->graph.poses.size())
+	{
+		ROS_ERROR("rtabmap_ros::MapData: Error pose ids and poses must have all the same size.");
+	}
+	else
 	{
-		poses.insert(std::make_pair(map.graph.posesId[i], rtabmap_ros::transformFromPoseMsg(map.graph.poses[i])));
+		boost::mutex::scoped_lock lock(current_map_mutex_);
+		rtabmap::Transform mapToOdom;
+		graphUpdated = rtabmap_ros::mapGraphDeltaFromROS(map->graph, graph_poses_, graph_links_, mapToOdom, graph_id_);
+		poses = graph_poses_;
 	}
 
 	// Add new clouds...
-	bool fromDepth = !cloud_from_scan_->getBool();
 	std::set<int> nodeDataReceived;
-	for(unsigned int i=0; i<map.nodes.size() && i<map.nodes.size(); ++i)
+	if(!map->nodes.empty())
 	{
-		int id = map.nodes[i].id;
+		CloudJob job;
+		job.map_ = map;
+		job.fromDepth_ = !cloud_from_scan_->getBool();
+		job.decimation_ = cloud_decimation_->getInt();
+		job.maxDepth_ = cloud_max_depth_->getFloat();
+		job.minDepth_ = cloud_min_depth_->getFloat();
+		job.voxelSize_ = cloud_voxel_size_->getFloat();
+		job.floorHeight_ = cloud_filter_floor_height_->getFloat();
+		job.ceilingHeight_ = cloud_filter_ceiling_height_->getFloat();
+		job.lod_ = isLevelOfDetailEnabled();
+
+		boost::mutex::scoped_lock lock(cloud_jobs_mutex_);
+		job.generation_ = cloud_jobs_generation_;
+		for(unsigned int i=0; i<map->nodes.size(); ++i)
+		{
+			job.index_ = i;
+			job.sequence_ = ++cloud_jobs_sequence_;
+			cloud_jobs_latest_[map->nodes[i].id] = job.sequence_;
+			cloud_jobs_.push_back(job);
+			nodeDataReceived.insert(map->nodes[i].id);
+		}
+		cloud_jobs_condition_.notify_all();
+	}
 
-		// Always refresh the cloud if there are data
-		rtabmap::Signature s = rtabmap_ros::nodeDataFromROS(map.nodes[i]);
-		if((fromDepth &&
-			!s.sensorData().imageCompressed().empty() &&
-		    !s.sensorData().depthOrRightCompressed().empty() &&
-		    (s.sensorData().cameraModels().size() || s.sensorData().stereoCameraModels().size())) ||
-		   (!fromDepth && !s.sensorData().laserScanCompressed().isEmpty()))
+	// Update graph
+	if(graphUpdated && node_filtering_angle_->getFloat() > 0.0f && node_filtering_radius_->getFloat() > 0.0f)
+	{
+		poses = rtabmap::graph::radiusPosesFiltering(poses,
+				node_filtering_radius_->getFloat(),
+				node_filtering_angle_->getFloat()*CV_PI/180.0);
+	}
+
+	{
+		boost::mutex::scoped_lock lock(current_map_mutex_);
+		if(graphUpdated)
 		{
-			cv::Mat image, depth;
-			rtabmap::LaserScan scan;
+			current_map_ = poses;
+			current_map_updated_ = true;
+		}
+		nodeDataReceived_.insert(nodeDataReceived.begin(), nodeDataReceived.end());
+	}
+}
 
-			s.sensorData().uncompressData(fromDepth?&image:0, fromDepth?&depth:0, !fromDepth?&scan:0);
+void MapCloudDisplay::cloudWorker()
+{
+	while(true)
+	{
+		CloudJob job;
+		{
+			boost::mutex::scoped_lock lock(cloud_jobs_mutex_);
+			while(cloud_jobs_.empty() && !cloud_workers_stopped_)
+			{
+				cloud_jobs_condition_.wait(lock);
+			}
+			if(cloud_workers_stopped_)
+			{
+				return;
+			}
+			job = cloud_jobs_.front();
+			cloud_jobs_.pop_front();
+			if(!isLatestCloudJob(job))
+			{
+				// newer data of this node already queued
+				continue;
+			}
+			++cloud_jobs_running_;
+		}
 
-			sensor_msgs::PointCloud2::Ptr cloudMsg(new sensor_msgs::PointCloud2);
-			if(fromDepth && !s.sensorData().imageRaw().empty() && !s.sensorData().depthOrRightRaw().empty())
+		CloudInfoPtr info = createCloud(job);
+
+		{
+			boost::mutex::scoped_lock lock(cloud_jobs_mutex_);
+			--cloud_jobs_running_;
+			// drop the cloud if a newer one of the same node has been
+			// created by another worker in the meantime
+			if(info.get() && isLatestCloudJob(job))
 			{
-				pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud;
-				pcl::IndicesPtr validIndices(new std::vector<int>);
+				boost::mutex::scoped_lock lockClouds(new_clouds_mutex_);
+				new_cloud_infos_.erase(info->id_);
+				new_cloud_infos_.insert(std::make_pair(info->id_, info));
+			}
+		}
+	}
+}
 
-				cloud = rtabmap::util3d::cloudRGBFromSensorData(
-						s.sensorData(),
-						cloud_decimation_->getInt(),
-						cloud_max_depth_->getFloat(),
-						cloud_min_depth_->getFloat(),
-						validIndices.get());
+// cloud_jobs_mutex_ should be locked
+bool MapCloudDisplay::isLatestCloudJob(const CloudJob & job) const
+{
+	if(job.generation_ != cloud_jobs_generation_)
+	{
+		return false;
+	}
+	std::map<int, unsigned int>::const_iterator iter = cloud_jobs_latest_.find(job.map_->nodes[job.index_].id);
+	return iter != cloud_jobs_latest_.end() && iter->second == job.sequence_;
+}
 
-				if(!cloud->empty())
-				{
-					if(cloud_voxel_size_->getFloat())
-					{
-						cloud = rtabmap::util3d::voxelize(cloud, validIndices, cloud_voxel_size_->getFloat());
-					}
+MapCloudDisplay::CloudInfoPtr MapCloudDisplay::createCloud(const CloudJob & job)
+{
+	const rtabmap_ros::NodeData & node = job.map_->nodes[job.index_];
+	bool fromDepth = job.fromDepth_;
+
+	// Always refresh the cloud if there are data
+	rtabmap::Signature s = rtabmap_ros::nodeDataFromROS(node);
+	if((fromDepth &&
+		!s.sensorData().imageCompressed().empty() &&
+		!s.sensorData().depthOrRightCompressed().empty() &&
+		(s.sensorData().cameraModels().size() || s.sensorData().stereoCameraModels().size())) ||
+	   (!fromDepth && !s.sensorData().laserScanCompressed().isEmpty()))
+	{
+		cv::Mat image, depth;
+		rtabmap::LaserScan scan;
 
-					if(cloud_filter_floor_height_->getFloat() != 0.0f || cloud_filter_ceiling_height_->getFloat() != 0.0f)
-					{
-						// convert in /odom frame
-						cloud = rtabmap::util3d::transformPointCloud(cloud, s.getPose());
-						cloud = rtabmap::util3d::passThrough(cloud, "z",
-								cloud_filter_floor_height_->getFloat()!=0.0f?cloud_filter_floor_height_->getFloat():-999.0f,
-								cloud_filter_ceiling_height_->getFloat()!=0.0f && (cloud_filter_floor_height_->getFloat()==0.0f || cloud_filter_ceiling_height_->getFloat()>cloud_filter_floor_height_->getFloat())?cloud_filter_ceiling_height_->getFloat():999.0f);
-						// convert back in /base_link frame
-						cloud = rtabmap::util3d::transformPointCloud(cloud, s.getPose().inverse());
-					}
+		s.sensorData().uncompressData(fromDepth?&image:0, fromDepth?&depth:0, !fromDepth?&scan:0);
 
-					if(!cloud->empty())
-					{
-						pcl::toROSMsg(*cloud, *cloudMsg);
-					}
-				}
-			}
-			else if(!fromDepth && !scan.isEmpty())
+		sensor_msgs::PointCloud2::Ptr cloudMsg(new sensor_msgs::PointCloud2);
+		if(fromDepth && !s.sensorData().imageRaw().empty() && !s.sensorData().depthOrRightRaw().empty())
+		{
+			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud;
+			pcl::IndicesPtr validIndices(new std::vector<int>);
+
+			cloud = rtabmap::util3d::cloudRGBFromSensorData(
+					s.sensorData(),
+					job.decimation_,
+					job.maxDepth_,
+					job.minDepth_,
+					validIndices.get());
+
+			if(!cloud->empty())
 			{
-				scan = rtabmap::util3d::commonFiltering(
-						scan,
-						1,
-						cloud_min_depth_->getFloat(),
-						cloud_max_depth_->getFloat(),
-						cloud_voxel_size_->getFloat());
-				pcl::PointCloud<pcl::PointXYZI>::Ptr cloud;
-				cloud = rtabmap::util3d::laserScanToPointCloudI(scan, scan.localTransform());
-				if(cloud_filter_floor_height_->getFloat() > 0.0f || cloud_filter_ceiling_height_->getFloat() > 0.0f)
+				if(job.voxelSize_)
+				{
+					cloud = rtabmap::util3d::voxelize(cloud, validIndices, job.voxelSize_);
+				}
+
+				if(job.floorHeight_ != 0.0f || job.ceilingHeight_ != 0.0f)
 				{
 					// convert in /odom frame
 					cloud = rtabmap::util3d::transformPointCloud(cloud, s.getPose());
 					cloud = rtabmap::util3d::passThrough(cloud, "z",
-							cloud_filter_floor_height_->getFloat()>0.0f?cloud_filter_floor_height_->getFloat():-999.0f,
-							cloud_filter_ceiling_height_->getFloat()>0.0f && (cloud_filter_floor_height_->getFloat()<=0.0f || cloud_filter_ceiling_height_->getFloat()>cloud_filter_floor_height_->getFloat())?cloud_filter_ceiling_height_->getFloat():999.0f);
+							job.floorHeight_!=0.0f?job.floorHeight_:-999.0f,
+							job.ceilingHeight_!=0.0f && (job.floorHeight_==0.0f || job.ceilingHeight_>job.floorHeight_)?job.ceilingHeight_:999.0f);
 					// convert back in /base_link frame
 					cloud = rtabmap::util3d::transformPointCloud(cloud, s.getPose().inverse());
 				}
@@ -363,40 +483,180 @@ void MapCloudDisplay::processMapData(const rtabmap_ros::MapData& map)
 					pcl::toROSMsg(*cloud, *cloudMsg);
 				}
 			}
+		}
+		else if(!fromDepth && !scan.isEmpty())
+		{
+			scan = rtabmap::util3d::commonFiltering(
+					scan,
+					1,
+					job.minDepth_,
+					job.maxDepth_,
+					job.voxelSize_);
+			pcl::PointCloud<pcl::PointXYZI>::Ptr cloud;
+			cloud = rtabmap::util3d::laserScanToPointCloudI(scan, scan.localTransform());
+			if(job.floorHeight_ > 0.0f || job.ceilingHeight_ > 0.0f)
+			{
+				// convert in /odom frame
+				cloud = rtabmap::util3d::transformPointCloud(cloud, s.getPose());
+				cloud = rtabmap::util3d::passThrough(cloud, "z",
+						job.floorHeight_>0.0f?job.floorHeight_:-999.0f,
+						job.ceilingHeight_>0.0f && (job.floorHeight_<=0.0f || job.ceilingHeight_>job.floorHeight_)?job.ceilingHeight_:999.0f);
+				// convert back in /base_link frame
+				cloud = rtabmap::util3d::transformPointCloud(cloud, s.getPose().inverse());
+			}
 
-			if(!cloudMsg->data.empty())
+			if(!cloud->empty())
 			{
-				cloudMsg->header = map.header;
-				CloudInfoPtr info(new CloudInfo);
-				info->message_ = cloudMsg;
-				info->pose_ = rtabmap::Transform::getIdentity();
-				info->id_ = id;
+				pcl::toROSMsg(*cloud, *cloudMsg);
+			}
+		}
 
-				if (transformCloud(info, true))
+		if(!cloudMsg->data.empty())
+		{
+			cloudMsg->header = job.map_->header;
+			CloudInfoPtr info(new CloudInfo);
+			info->message_ = cloudMsg;
+			info->pose_ = rtabmap::Transform::getIdentity();
+			info->id_ = node.id;
+
+			if (transformCloud(info, true))
+			{
+				if(job.lod_)
 				{
-					boost::mutex::scoped_lock lock(new_clouds_mutex_);
-					new_cloud_infos_.erase(id);
-					new_cloud_infos_.insert(std::make_pair(id, info));
+					createLevelsOfDetail(info, job.voxelSize_);
 				}
+				return info;
 			}
 		}
-		nodeDataReceived.insert(id);
 	}
+	return CloudInfoPtr();
+}
 
-	// Update graph
-	if(node_filtering_angle_->getFloat() > 0.0f && node_filtering_radius_->getFloat() > 0.0f)
+bool MapCloudDisplay::isLevelOfDetailEnabled() const
+{
+	return lod_distance_->getFloat() > 0.0f || point_budget_->getInt() > 0;
+}
+
+void MapCloudDisplay::createLevelsOfDetail(const CloudInfoPtr& cloud_info, float voxelSize)
+{
+	static const int kMaxLevels = 4;
+	static const size_t kMinPoints = 64;
+	cloud_info->lod_points_.clear();
+	const std::vector<rviz::PointCloud::Point> * points = &cloud_info->transformed_points_;
+	voxelSize = std::max(voxelSize, 0.01f);
+	for(int level=1; level<=kMaxLevels && points->size() > kMinPoints; ++level)
 	{
-		poses = rtabmap::graph::radiusPosesFiltering(poses,
-				node_filtering_radius_->getFloat(),
-				node_filtering_angle_->getFloat()*CV_PI/180.0);
+		// keep the first point of each voxel
+		voxelSize *= 2.0f;
+		boost::unordered_set<std::pair<int, std::pair<int, int> > > voxels;
+		std::vector<rviz::PointCloud::Point> subsampled;
+		subsampled.reserve(points->size()/2);
+		for(size_t i=0; i<points->size(); ++i)
+		{
+			const Ogre::Vector3 & pt = points->at(i).position;
+			if(voxels.insert(std::make_pair(int(floor(pt.x/voxelSize)), std::make_pair(int(floor(pt.y/voxelSize)), int(floor(pt.z/voxelSize))))).second)
+			{
+				subsampled.push_back(points->at(i));
+			}
+		}
+		if(subsampled.size() == points->size())
+		{
+			continue;
+		}
+		cloud_info->lod_points_.push_back(subsampled);
+		points = &cloud_info->lod_points_.back();
 	}
+}
 
+void MapCloudDisplay::updateLevelOfDetailClouds(const CloudInfoPtr& cloud_info)
+{
+	for(size_t i=0; i<cloud_info->lod_clouds_.size(); ++i)
 	{
-		boost::mutex::scoped_lock lock(current_map_mutex_);
-		current_map_ = poses;
-		current_map_updated_ = true;
-		nodeDataReceived_.insert(nodeDataReceived.begin(), nodeDataReceived.end());
+		cloud_info->scene_node_->detachObject( cloud_info->lod_clouds_[i].get() );
+	}
+	cloud_info->lod_clouds_.clear();
+
+	rviz::PointCloud::RenderMode mode = (rviz::PointCloud::RenderMode) style_property_->getOptionInt();
+	float size = mode == rviz::PointCloud::RM_POINTS?point_pixel_size_property_->getFloat():point_world_size_property_->getFloat();
+	for(size_t i=0; i<cloud_info->lod_points_.size(); ++i)
+	{
+		// bigger points for lower resolutions
+		float lodSize = mode == rviz::PointCloud::RM_POINTS?size:size*float(2<<i);
+		boost::shared_ptr<rviz::PointCloud> cloud( new rviz::PointCloud() );
+		cloud->addPoints( &(cloud_info->lod_points_[i].front()), cloud_info->lod_points_[i].size() );
+		cloud->setRenderMode( mode );
+		cloud->setAlpha( alpha_property_->getFloat() );
+		cloud->setDimensions( lodSize, lodSize, lodSize );
+		cloud->setAutoSize(false);
+		cloud->setVisible(false);
+		cloud_info->scene_node_->attachObject( cloud.get() );
+		cloud_info->lod_clouds_.push_back(cloud);
+	}
+}
+
+int MapCloudDisplay::updateLevelsOfDetail(const std::vector<CloudInfoPtr> & shown)
+{
+	float lodDistance = lod_distance_->getFloat();
+	int budget = point_budget_->getInt();
+	Ogre::Camera * camera = context_->getViewManager()->getCurrent()?context_->getViewManager()->getCurrent()->getCamera():0;
+
+	// level for each cloud from its distance to the camera, -1 if not visible
+	std::vector<int> levels(shown.size(), 0);
+	std::multimap<float, int> byDistance;
+	int totalPoints = 0;
+	for(size_t i=0; i<shown.size(); ++i)
+	{
+		const CloudInfoPtr & info = shown[i];
+		int maxLevel = (int)info->lod_points_.size();
+		if(camera)
+		{
+			Ogre::AxisAlignedBox box = info->cloud_->getBoundingBox();
+			box.transformAffine(info->scene_node_->_getFullTransform());
+			if(frustum_culling_->getBool() && !box.isNull() && !camera->isVisible(box))
+			{
+				levels[i] = -1;
+				continue;
+			}
+			float distance = box.isNull()?0.0f:box.distance(camera->getDerivedPosition());
+			if(lodDistance > 0.0f && distance > lodDistance)
+			{
+				levels[i] = std::min(maxLevel, 1+int(log2(distance/lodDistance)));
+			}
+			byDistance.insert(std::make_pair(distance, (int)i));
+		}
+		totalPoints += levels[i]==0?info->transformed_points_.size():info->lod_points_[levels[i]-1].size();
+	}
+
+	// reduce the resolution of the farthest clouds first
+	bool reduced = true;
+	while(budget > 0 && totalPoints > budget && reduced)
+	{
+		reduced = false;
+		for(std::multimap<float, int>::reverse_iterator iter=byDistance.rbegin(); iter!=byDistance.rend() && totalPoints > budget; ++iter)
+		{
+			const CloudInfoPtr & info = shown[iter->second];
+			int & level = levels[iter->second];
+			if(level < (int)info->lod_points_.size())
+			{
+				totalPoints -= level==0?info->transformed_points_.size():info->lod_points_[level-1].size();
+				++level;
+				totalPoints += info->lod_points_[level-1].size();
+				reduced = true;
+			}
+		}
 	}
+
+	for(size_t i=0; i<shown.size(); ++i)
+	{
+		const CloudInfoPtr & info = shown[i];
+		info->cloud_->setVisible(levels[i] == 0);
+		for(size_t j=0; j<info->lod_clouds_.size(); ++j)
+		{
+			info->lod_clouds_[j]->setVisible(levels[i] == int(j)+1);
+		}
+		info->lod_ = levels[i];
+	}
+	return totalPoints;
 }
 
 void MapCloudDisplay::setPropertiesHidden( const QList<Property*>& props, bool hide )
@@ -491,6 +751,10 @@ void MapCloudDisplay::updateAlpha()
 	for( std::map<int, CloudInfoPtr>::iterator it = cloud_infos_.begin(); it != cloud_infos_.end(); ++it )
 	{
 		it->second->cloud_->setAlpha( alpha_property_->getFloat() );
+		for(size_t i=0; i<it->second->lod_clouds_.size(); ++i)
+		{
+			it->second->lod_clouds_[i]->setAlpha( alpha_property_->getFloat() );
+		}
 	}
 }
 
@@ -510,6 +774,10 @@ void MapCloudDisplay::updateStyle()
 	for( std::map<int, CloudInfoPtr>::iterator it = cloud_infos_.begin(); it != cloud_infos_.end(); ++it )
 	{
 		it->second->cloud_->setRenderMode( mode );
+		for(size_t i=0; i<it->second->lod_clouds_.size(); ++i)
+		{
+			it->second->lod_clouds_[i]->setRenderMode( mode );
+		}
 	}
 	updateBillboardSize();
 }
@@ -529,6 +797,12 @@ void MapCloudDisplay::updateBillboardSize()
 	 for( std::map<int, CloudInfoPtr>::iterator it = cloud_infos_.begin(); it != cloud_infos_.end(); ++it )
 	{
 		it->second->cloud_->setDimensions( size, size, size );
+		for(size_t i=0; i<it->second->lod_clouds_.size(); ++i)
+		{
+			// bigger points for lower resolutions
+			float lodSize = mode == rviz::PointCloud::RM_POINTS?size:size*float(2<<i);
+			it->second->lod_clouds_[i]->setDimensions( lodSize, lodSize, lodSize );
+		}
 	}
 	context_->queueRender();
 }
@@ -545,6 +819,28 @@ void MapCloudDisplay::updateCloudParameters()
 	fromScan_ = cloud_from_scan_->getBool();
 }
 
+void MapCloudDisplay::updateLevelOfDetailParameters()
+{
+	// create the levels of the clouds already shown when enabled, release them when disabled
+	bool enabled = isLevelOfDetailEnabled();
+	for( std::map<int, CloudInfoPtr>::iterator it = cloud_infos_.begin(); it != cloud_infos_.end(); ++it )
+	{
+		const CloudInfoPtr& cloud_info = it->second;
+		if(enabled == cloud_info->lod_points_.empty())
+		{
+			if(enabled)
+			{
+				createLevelsOfDetail(cloud_info, cloud_voxel_size_->getFloat());
+			}
+			else
+			{
+				cloud_info->lod_points_.clear();
+			}
+			updateLevelOfDetailClouds(cloud_info);
+		}
+	}
+}
+
 void MapCloudDisplay::downloadMap(bool graphOnly)
 {
 	rtabmap_ros::GetMap getMapSrv;
@@ -552,6 +848,15 @@ void MapCloudDisplay::downloadMap(bool graphOnly)
 	getMapSrv.request.optimized = true;
 	getMapSrv.request.graphOnly = graphOnly;
 	std::string rtabmapNs = download_namespace->getStdString();
+	if(!graphOnly)
+	{
+		// download by pages if available
+		std::string chunkSrvName = update_nh_.resolveName(uFormat("%s/get_map_data_chunk", rtabmapNs.c_str()));
+		if(ros::service::exists(chunkSrvName, false) && downloadMapChunks(chunkSrvName))
+		{
+			return;
+		}
+	}
 	std::string srvName = update_nh_.resolveName(uFormat("%s/get_map_data", rtabmapNs.c_str()));
 	QMessageBox * messageBox = new QMessageBox(
 			QMessageBox::NoIcon,
@@ -579,25 +884,96 @@ void MapCloudDisplay::downloadMap(bool graphOnly)
 	{
 		messageBox->setText(tr("Updating the map (%1 nodes downloaded)...").arg(getMapSrv.response.data.graph.poses.size()));
 		QApplication::processEvents();
-		processMapData(getMapSrv.response.data);
-		messageBox->setText(tr("Updating the map (%1 nodes downloaded)... done!").arg(getMapSrv.response.data.graph.poses.size()));
+		rtabmap_ros::MapDataPtr data(new rtabmap_ros::MapData);
+		std::swap(*data, getMapSrv.response.data);
+		processMapData(data);
+		messageBox->setText(tr("Updating the map (%1 nodes downloaded)... done!").arg(data->graph.poses.size()));
 
 		QTimer::singleShot(1000, messageBox, SLOT(close()));
 	}
 	else
 	{
-		messageBox->setText(tr("Creating all clouds (%1 poses and %2 clouds downloaded)...")
-				.arg(getMapSrv.response.data.graph.poses.size()).arg(getMapSrv.response.data.nodes.size()));
-		QApplication::processEvents();
+		rtabmap_ros::MapDataPtr data(new rtabmap_ros::MapData);
+		std::swap(*data, getMapSrv.response.data);
 		this->reset();
-		processMapData(getMapSrv.response.data);
-		messageBox->setText(tr("Creating all clouds (%1 poses and %2 clouds downloaded)... done!")
-				.arg(getMapSrv.response.data.graph.poses.size()).arg(getMapSrv.response.data.nodes.size()));
+		processMapData(data);
+		// The clouds are created in background, see "Clouds" status for progress
+		messageBox->setText(tr("Creating all clouds (%1 poses and %2 clouds downloaded)... "
+				"they will appear as they are created.")
+				.arg(data->graph.poses.size()).arg(data->nodes.size()));
 
 		QTimer::singleShot(1000, messageBox, SLOT(close()));
 	}
 }
 
+bool MapCloudDisplay::downloadMapChunks(const std::string & srvName)
+{
+	rtabmap_ros::GetMapChunk getMapSrv;
+	getMapSrv.request.global = false;
+	getMapSrv.request.optimized = true;
+	getMapSrv.request.with_images = true;
+	getMapSrv.request.with_scans = true;
+	getMapSrv.request.with_user_data = true;
+	getMapSrv.request.with_grids = true;
+	getMapSrv.request.page_size = 20;
+	getMapSrv.request.cursor = 0;
+
+	QMessageBox * messageBox = new QMessageBox(
+			QMessageBox::NoIcon,
+			tr("Calling \"%1\" service...").arg(srvName.c_str()),
+			tr("Downloading the map..."),
+			QMessageBox::NoButton);
+	messageBox->setAttribute(Qt::WA_DeleteOnClose, true);
+	messageBox->show();
+	QApplication::processEvents();
+
+	int nodes = 0;
+	do
+	{
+		if(!ros::service::call(srvName, getMapSrv))
+		{
+			if(nodes == 0)
+			{
+				ROS_ERROR("MapCloudDisplay: Cannot call \"%s\" service.", srvName.c_str());
+				messageBox->close();
+			}
+			else
+			{
+				ROS_ERROR("MapCloudDisplay: Cannot call \"%s\" service (cursor=%d), the map "
+						"download is incomplete (%d/%d clouds downloaded).",
+						srvName.c_str(), getMapSrv.request.cursor, nodes, getMapSrv.response.total_nodes);
+				messageBox->setText(tr("MapCloudDisplay: Cannot call \"%1\" service, the map download "
+						"is incomplete (%2/%3 clouds downloaded). Trying to download the whole map at once...")
+						.arg(srvName.c_str()).arg(nodes).arg(getMapSrv.response.total_nodes));
+				QApplication::processEvents();
+			}
+			// fall back to the complete download
+			return false;
+		}
+		rtabmap_ros::MapDataPtr data(new rtabmap_ros::MapData);
+		std::swap(*data, getMapSrv.response.data);
+		if(getMapSrv.request.cursor == 0)
+		{
+			this->reset();
+		}
+		nodes += data->nodes.size();
+		// only the first page contains the graph
+		processMapData(data);
+
+		// The clouds are created in background, see "Clouds" status for progress
+		messageBox->setText(tr("Downloading the map (%1/%2 clouds downloaded)... "
+				"they will appear as they are created.")
+				.arg(nodes).arg(getMapSrv.response.total_nodes));
+		QApplication::processEvents();
+
+		getMapSrv.request.cursor = getMapSrv.response.next_cursor;
+	}
+	while(getMapSrv.request.cursor != 0);
+
+	QTimer::singleShot(1000, messageBox, SLOT(close()));
+	return true;
+}
+
 void MapCloudDisplay::downloadNamespaceChanged()
 {
 	std::string rtabmapNs = download_namespace->getStdString();
@@ -689,6 +1065,13 @@ void MapCloudDisplay::update( float wall_dt, float ros_dt )
 				cloud_info->scene_node_ = scene_node_->createChildSceneNode();
 
 				cloud_info->scene_node_->attachObject( cloud_info->cloud_.get() );
+
+				if(isLevelOfDetailEnabled() && cloud_info->lod_points_.empty())
+				{
+					// enabled after its job was queued
+					createLevelsOfDetail(cloud_info, cloud_voxel_size_->getFloat());
+				}
+				updateLevelOfDetailClouds(cloud_info);
 				cloud_info->scene_node_->setVisible(false);
 
 				cloud_infos_.erase(it->first);
@@ -726,6 +1109,7 @@ void MapCloudDisplay::update( float wall_dt, float ros_dt )
 
 	int totalPoints = 0;
 	int totalNodesShown = 0;
+	std::vector<CloudInfoPtr> shown;
 	{
 		// update poses
 		boost::mutex::scoped_lock lock(current_map_mutex_);
@@ -760,7 +1144,7 @@ void MapCloudDisplay::update( float wall_dt, float ros_dt )
 						cloudInfoIt->second->scene_node_->setPosition(posePosition);
 						cloudInfoIt->second->scene_node_->setOrientation(poseOrientation);
 						cloudInfoIt->second->scene_node_->setVisible(true);
-						++totalNodesShown;
+						shown.push_back(cloudInfoIt->second);
 					}
 					else if(context_->getFrameManager()->frameHasProblems(cloudInfoIt->second->message_->header.frame_id, cloudInfoIt->second->message_->header.stamp, error))
 					{
@@ -813,13 +1197,42 @@ void MapCloudDisplay::update( float wall_dt, float ros_dt )
 		lastCloudAdded_ = lastCloudAdded;
 	}
 
-	this->setStatusStd(rviz::StatusProperty::Ok, "Points", tr("%1").arg(totalPoints).toStdString());
+	int pointsShown = updateLevelsOfDetail(shown);
+	for(size_t i=0; i<shown.size(); ++i)
+	{
+		if(shown[i]->lod_ >= 0)
+		{
+			++totalNodesShown;
+		}
+	}
+
+	int cloudsRemaining = 0;
+	{
+		boost::mutex::scoped_lock lock(cloud_jobs_mutex_);
+		cloudsRemaining = (int)cloud_jobs_.size() + cloud_jobs_running_;
+	}
+	if(cloudsRemaining)
+	{
+		this->setStatusStd(rviz::StatusProperty::Ok, "Clouds", tr("%1 remaining to create").arg(cloudsRemaining).toStdString());
+	}
+	else
+	{
+		this->deleteStatusStd("Clouds");
+	}
+
+	this->setStatusStd(rviz::StatusProperty::Ok, "Points", tr("%1 shown of %2").arg(pointsShown).arg(totalPoints).toStdString());
 	this->setStatusStd(rviz::StatusProperty::Ok, "Nodes", tr("%1 shown of %2").arg(totalNodesShown).arg(cloud_infos_.size()).toStdString());
 }
 
 void MapCloudDisplay::reset()
 {
 	lastCloudAdded_ = -1;
+	{
+		boost::mutex::scoped_lock lock(cloud_jobs_mutex_);
+		cloud_jobs_.clear();
+		cloud_jobs_latest_.clear();
+		++cloud_jobs_generation_;
+	}
 	{
 		boost::mutex::scoped_lock lock(new_clouds_mutex_);
 		cloud_infos_.clear();
@@ -828,6 +1241,8 @@ void MapCloudDisplay::reset()
 	{
 		boost::mutex::scoped_lock lock(current_map_mutex_);
 		current_map_.clear();
+		graph_poses_.clear();
+		graph_links_.clear();
 		current_map_updated_ = false;
 		nodeDataReceived_.clear();
 	}
@@ -934,6 +1349,15 @@ void MapCloudDisplay::retransform()
 		transformCloud(cloud_info, false);
 		cloud_info->cloud_->clear();
 		cloud_info->cloud_->addPoints(&cloud_info->transformed_points_.front(), cloud_info->transformed_points_.size());
+		if(isLevelOfDetailEnabled())
+		{
+			createLevelsOfDetail(cloud_info, cloud_voxel_size_->getFloat());
+		}
+		else
+		{
+			cloud_info->lod_points_.clear();
+		}
+		updateLevelOfDetailClouds(cloud_info);
 	}
 }
 
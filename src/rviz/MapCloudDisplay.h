@@ -36,12 +36,16 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <rtabmap_ros/MapData.h>
 #include <rtabmap/core/Transform.h>
+#include <rtabmap/core/Link.h>
 
 #include <pluginlib/class_loader.h>
 #include <sensor_msgs/PointCloud2.h>
 
 #include <ros/callback_queue.h>
 
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+
 #include <rviz/ogre_helpers/point_cloud.h>
 #include <rviz/message_filter_display.h>
 #include <rviz/default_plugin/point_cloud_transformer.h>
@@ -95,6 +99,13 @@ public:
 		boost::shared_ptr<rviz::PointCloud> cloud_;
 
 		std::vector<rviz::PointCloud::Point> transformed_points_;
+
+		// Level of detail: transformed_points_ subsampled in voxels of twice
+		// the size at each level, shown instead of cloud_ (level 0) when far.
+		// Only created when "LOD distance" or "Point budget" is set.
+		std::vector<std::vector<rviz::PointCloud::Point> > lod_points_;
+		std::vector<boost::shared_ptr<rviz::PointCloud> > lod_clouds_;
+		int lod_; // level shown, -1 if hidden
 	};
 	typedef boost::shared_ptr<CloudInfo> CloudInfoPtr;
 
@@ -119,6 +130,9 @@ public:
 	rviz::FloatProperty* cloud_filter_ceiling_height_;
 	rviz::FloatProperty* node_filtering_radius_;
 	rviz::FloatProperty* node_filtering_angle_;
+	rviz::FloatProperty* lod_distance_;
+	rviz::IntProperty* point_budget_;
+	rviz::BoolProperty* frustum_culling_;
 	rviz::StringProperty * download_namespace;
 	rviz::BoolProperty* download_map_;
 	rviz::BoolProperty* download_graph_;
@@ -135,6 +149,7 @@ private Q_SLOTS:
 	void setXyzTransformerOptions( EnumProperty* prop );
 	void setColorTransformerOptions( EnumProperty* prop );
 	void updateCloudParameters();
+	void updateLevelOfDetailParameters();
 	void downloadNamespaceChanged();
 	void downloadMap();
 	void downloadGraph();
@@ -147,8 +162,33 @@ protected:
 	virtual void processMessage( const rtabmap_ros::MapDataConstPtr& cloud );
 
 private:
+	// Cloud to create from a node of a MapData, with a copy of the cloud properties
+	struct CloudJob
+	{
+		rtabmap_ros::MapDataConstPtr map_;
+		unsigned int index_;
+		unsigned int generation_;
+		unsigned int sequence_;
+		bool fromDepth_;
+		int decimation_;
+		float maxDepth_;
+		float minDepth_;
+		float voxelSize_;
+		float floorHeight_;
+		float ceilingHeight_;
+		bool lod_; // create the levels of detail
+	};
+
 	void downloadMap(bool graphOnly);
-	void processMapData(const rtabmap_ros::MapData& map);
+	bool downloadMapChunks(const std::string & srvName);
+	void processMapData(const rtabmap_ros::MapDataConstPtr& map);
+	CloudInfoPtr createCloud(const CloudJob & job);
+	bool isLatestCloudJob(const CloudJob & job) const;
+	bool isLevelOfDetailEnabled() const;
+	void createLevelsOfDetail(const CloudInfoPtr& cloud_info, float voxelSize);
+	void updateLevelOfDetailClouds(const CloudInfoPtr& cloud_info);
+	int updateLevelsOfDetail(const std::vector<CloudInfoPtr> & shown); // return rendered points
+	void cloudWorker();
 
 	/**
 	* \brief Transforms the cloud into the correct frame, and sets up our renderable cloud
@@ -175,10 +215,25 @@ private:
 	std::map<int, CloudInfoPtr> new_cloud_infos_;
 	boost::mutex new_clouds_mutex_;
 
+	// Nodes are decompressed and their clouds created by the workers,
+	// the results are added to new_cloud_infos_ as soon as they are ready.
+	boost::thread_group cloud_workers_;
+	std::deque<CloudJob> cloud_jobs_;
+	int cloud_jobs_running_;
+	unsigned int cloud_jobs_generation_; // incremented on reset() to drop the pending clouds
+	unsigned int cloud_jobs_sequence_; // incremented for each job
+	std::map<int, unsigned int> cloud_jobs_latest_; // sequence of the latest job of each node, older results are dropped
+	bool cloud_workers_stopped_;
+	boost::mutex cloud_jobs_mutex_;
+	boost::condition_variable cloud_jobs_condition_;
+
 	std::set<int> nodeDataReceived_;
 	bool fromScan_;
 
 	std::map<int, rtabmap::Transform> current_map_;
+	std::map<int, rtabmap::Transform> graph_poses_; // complete graph (delta mode)
+	std::multimap<int, rtabmap::Link> graph_links_;
+	unsigned int graph_id_;
 	boost::mutex current_map_mutex_;
 	bool current_map_updated_;
 
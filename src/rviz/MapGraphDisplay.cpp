@@ -47,7 +47,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace rtabmap_ros
 {
 
-MapGraphDisplay::MapGraphDisplay()
+MapGraphDisplay::MapGraphDisplay() :
+		graphId_(0)
 {
 	color_neighbor_property_ = new rviz::ColorProperty( "Neighbor", Qt::blue,
 	                                       "Color to draw neighbor links.", this );
@@ -83,6 +84,8 @@ void MapGraphDisplay::reset()
 {
   MFDClass::reset();
   destroyObjects();
+  poses_.clear();
+  links_.clear();
 }
 
 void MapGraphDisplay::destroyObjects()
@@ -104,10 +107,14 @@ void MapGraphDisplay::processMessage( const rtabmap_ros::MapGraph::ConstPtr& msg
 	}
 
 	// Get links
-	std::map<int, rtabmap::Transform> poses;
-	std::multimap<int, rtabmap::Link> links;
 	rtabmap::Transform mapToOdom;
-	rtabmap_ros::mapGraphFromROS(*msg, poses, links, mapToOdom);
+	if(!rtabmap_ros::mapGraphDeltaFromROS(*msg, poses_, links_, mapToOdom, graphId_))
+	{
+		// waiting for a complete graph
+		return;
+	}
+	const std::map<int, rtabmap::Transform> & poses = poses_;
+	const std::multimap<int, rtabmap::Link> & links = links_;
 
 	destroyObjects();
 
@@ -131,10 +138,10 @@ void MapGraphDisplay::processMessage( const rtabmap_ros::MapGraph::ConstPtr& msg
 
 		manual_object->estimateVertexCount(links.size() * 2);
 		manual_object->begin( "BaseWhiteNoLighting", Ogre::RenderOperation::OT_LINE_LIST );
-		for(std::multimap<int, rtabmap::Link>::iterator iter=links.begin(); iter!=links.end(); ++iter)
+		for(std::multimap<int, rtabmap::Link>::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
 		{
-			std::map<int, rtabmap::Transform>::iterator poseIterFrom = poses.find(iter->second.from());
-			std::map<int, rtabmap::Transform>::iterator poseIterTo = poses.find(iter->second.to());
+			std::map<int, rtabmap::Transform>::const_iterator poseIterFrom = poses.find(iter->second.from());
+			std::map<int, rtabmap::Transform>::const_iterator poseIterTo = poses.find(iter->second.to());
 			if(poseIterFrom != poses.end() && poseIterTo != poses.end())
 			{
 				if(iter->second.type() == rtabmap::Link::kNeighbor)
@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MAP_GRAPH_DISPLAY_H
 
 #include <rtabmap_ros/MapGraph.h>
+#include <rtabmap/core/Link.h>
 
 #include <rviz/message_filter_display.h>
 
@@ -75,6 +76,11 @@ private:
 
   std::vector<Ogre::ManualObject*> manual_objects_;
 
+  // complete graph (delta mode)
+  std::map<int, rtabmap::Transform> poses_;
+  std::multimap<int, rtabmap::Link> links_;
+  unsigned int graphId_;
+
   ColorProperty* color_neighbor_property_;
   ColorProperty* color_neighbor_merged_property_;
   ColorProperty* color_global_property_;